@@ -63,7 +63,7 @@ unsigned int SendArpRequest(unsigned char* targetIP){
     memcpy( arpPacket.senderIP, deviceIP, 4);
     
     /*Send the Packet*/
-    return(MACWrite((unsigned char*)&arpPacket,sizeof(ARP)));
+    return(MACWrite(&ethDevice, (unsigned char*)&arpPacket,sizeof(ARP)));
 }
 
 /*******************************************************************************
@@ -106,7 +106,7 @@ unsigned int ReplyArpRequest(ARP* arpPacket){
         arpPacket->opCode = (ARPREPLY); 
         
         /*Send the Packet!*/
-        return(MACWrite((unsigned char*) arpPacket, sizeof(ARP)));
+        return(MACWrite(&ethDevice, (unsigned char*) arpPacket, sizeof(ARP)));
     }else{
         /*The ARP Request is not for us,so we did nothing.*/
         return FALSE;
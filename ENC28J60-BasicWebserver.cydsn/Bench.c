@@ -0,0 +1,183 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Benchmarks of the stack's kernels
+ Description : Runs the functions the stack spends its CPU time in over
+               a range of packet sizes,and times them with ProfTimer.
+               The Linux build runs the same kernels against the host
+               clock,see "Host/benchmain.c".
+*/
+#include "IPStackMain.h"
+#include <string.h>
+#include <device.h>
+
+#if (STACK_BENCH_ENABLED)
+const unsigned int BenchSizes[BENCHSIZES] = {64, 128, 256, 512, 1024, MAXFRAMELEN};
+
+const char* const BenchNames[BENCHKERNELS] = {
+    "checksum", "add32", "AddWebServerData", "DNSEncodeName", "DNSFindAnswer", "SwapAddresses"
+};
+
+/*Where the kernels put their results,so none of the calls can be left out.*/
+static volatile unsigned int BenchSink;
+#endif
+
+void BenchSetup(unsigned char kernel, unsigned char* buf, unsigned int size){
+#if (STACK_BENCH_ENABLED)
+    unsigned char* src = buf + BENCHWORKLEN;
+    unsigned char* rr;
+    unsigned int i;
+    unsigned int left;
+
+    memset(buf, 0, BENCHBUFLEN);
+    switch (kernel){
+    case BENCH_CHECKSUM:
+        for (i = 0; i < size; i++){
+            buf[i] = (unsigned char)i;
+        }
+        break;
+
+    case BENCH_WEBDATA:
+    case BENCH_DNSNAME:
+        /*Letters,with a dot after every 15 for the DNS name,as long labels
+        are the most work for the encoder.*/
+        for (i = 0; i < size; i++){
+            src[i] = 'a' + (i % 26);
+            if ((kernel == BENCH_DNSNAME) && ((i % 16) == 15) && (i != (size - 1))){
+                src[i] = '.';
+            }
+        }
+        src[size] = '\0';
+        break;
+
+    case BENCH_DNSANSWER:
+        /*CNAME records,as a reply to a lookup of an alias has,then the 'A'
+        record.Every name is a pointer,as replies have them.The last CNAME
+        takes up what is left over,so the records come to size bytes.*/
+        rr = buf;
+        left = size - 16;
+        while (left >= 32){
+            i = 20;
+            if (left < 64){
+                i = left - 12;
+            }
+            rr[0] = 0xC0;
+            rr[1] = 0x0C;
+            rr[3] = 5;//CNAME
+            rr[5] = 1;//IN
+            rr[11] = i;
+            rr += i + 12;
+            left -= i + 12;
+        }
+        rr[0] = 0xC0;
+        rr[1] = 0x0C;
+        rr[3] = 1;//A
+        rr[5] = 1;//IN
+        rr[11] = 4;
+        rr[12] = 192;
+        rr[13] = 168;
+        rr[14] = 1;
+        rr[15] = 1;
+        break;
+
+    case BENCH_SWAP:
+        memset(((IPhdr*)buf)->eth.SrcAddrs, 0x02, 6);
+        memset(((IPhdr*)buf)->source, 10, 4);
+        break;
+
+    default:
+        break;
+    }
+#else
+    (void)kernel;
+    (void)buf;
+    (void)size;
+#endif
+}
+
+void BenchRun(unsigned char kernel, unsigned char* buf, unsigned int size, unsigned int count){
+#if (STACK_BENCH_ENABLED)
+    const char* src = (const char*)(buf + BENCHWORKLEN);
+
+    switch (kernel){
+    case BENCH_CHECKSUM:
+        while (count--){
+            BenchSink = checksum(buf, size, 2);
+        }
+        break;
+
+    case BENCH_ADD32:
+        while (count--){
+            add32(buf, size);
+        }
+        break;
+
+    case BENCH_WEBDATA:
+        while (count--){
+            BenchSink = AddWebServerData((TCPhdr*)buf, 0, src);
+        }
+        break;
+
+    case BENCH_DNSNAME:
+        while (count--){
+            BenchSink = DNSEncodeName(buf, src) - buf;
+        }
+        break;
+
+    case BENCH_DNSANSWER:
+        while (count--){
+            BenchSink = DNSFindAnswer(buf, buf) - buf;
+        }
+        break;
+
+    case BENCH_SWAP:
+        while (count--){
+            SwapAddresses((IPhdr*)buf);
+        }
+        break;
+
+    default:
+        break;
+    }
+#else
+    (void)kernel;
+    (void)buf;
+    (void)size;
+    (void)count;
+#endif
+}
+
+unsigned char StackBench(unsigned char* buf, BENCHRESULT* result){
+#if (STACK_BENCH_ENABLED)
+    unsigned char kernel;
+    unsigned char s;
+    unsigned int calls;
+    unsigned int mark;
+    unsigned int ticks;
+
+    ProfTimer_Start();
+    for (kernel = 0; kernel < BENCHKERNELS; kernel++){
+        for (s = 0; s < BENCHSIZES; s++){
+            BenchSetup(kernel, buf, BenchSizes[s]);
+            for (calls = 1; ; calls <<= 1){
+                /*ProfTimer counts down.*/
+                mark = ProfTimer_ReadCounter();
+                BenchRun(kernel, buf, BenchSizes[s], calls);
+                ticks = mark - ProfTimer_ReadCounter();
+                if ((ticks >= BENCHMINTICKS) || (calls >= BENCHMAXCALLS)){
+                    break;
+                }
+            }
+            /*In kHz,so it does not overflow.*/
+            result->Cycles[kernel][s] = ((unsigned long)ticks * (BENCHCPUHZ / 1000)) / (PROFTIMER_HZ / 1000) / calls;
+        }
+    }
+    return TRUE;
+#else
+    (void)buf;
+    (void)result;
+    return FALSE;
+#endif
+}
+
+/* [] END OF FILE */
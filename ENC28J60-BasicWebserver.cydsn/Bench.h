@@ -0,0 +1,118 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Benchmarks of the stack's kernels
+ Description : The functions the stack spends its CPU time in,run over
+               a range of packet sizes,see StackBench.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/*Set STACK_BENCH_ENABLED to 1 to build in the benchmarks.StackBench times
+with the same "ProfTimer" as SPI_PROF_ENABLED,at PROFTIMER_HZ,see
+"enc28j60.h".The Linux build sets it from its Makefile,so it is only set
+here if it is not already.*/
+#ifndef STACK_BENCH_ENABLED
+#define STACK_BENCH_ENABLED 0
+#endif
+
+/*Rate the 8051 runs at.On the PSoC3 that is the bus clock.*/
+#define BENCHCPUHZ      BCLK__BUS_CLK__HZ
+
+/*The kernels,and what size means to each.*/
+#define BENCH_CHECKSUM  0//checksum,as a TCP checksum over size bytes.
+#define BENCH_ADD32     1//add32,adding size,as ackTcp adds a segment length.
+#define BENCH_WEBDATA   2//AddWebServerData,appending a string of size bytes.
+#define BENCH_DNSNAME   3//DNSEncodeName,on a name of size bytes.
+#define BENCH_DNSANSWER 4//DNSFindAnswer,through size bytes of records.
+#define BENCH_SWAP      5//SwapAddresses,which does not depend on size.
+#define BENCHKERNELS    6
+
+/*Number of sizes each kernel is run over,see BenchSizes.*/
+#define BENCHSIZES      6
+
+/*Bytes of the buffer the benchmarks are run in.The first part holds what
+the kernel works on,the rest what it reads from.*/
+#define BENCHWORKLEN    (sizeof(TCPhdr) + MAXFRAMELEN)
+#define BENCHBUFLEN     (BENCHWORKLEN + MAXFRAMELEN + 1)
+
+/*StackBench keeps doubling the calls it times together until they take at
+least this many ProfTimer ticks,or it gets to BENCHMAXCALLS.*/
+#define BENCHMINTICKS   2000
+#define BENCHMAXCALLS   0x4000
+
+/*Sizes in bytes,from a minimum to a full sized Ethernet frame.*/
+extern const unsigned int BenchSizes[BENCHSIZES];
+
+/*Names of the kernels,for printing.*/
+extern const char* const BenchNames[BENCHKERNELS];
+
+/*Results of StackBench.*/
+typedef struct {
+    unsigned long Cycles[BENCHKERNELS][BENCHSIZES];//CPU cycles per call.
+} BENCHRESULT;
+
+/*******************************************************************************
+* Function Name: BenchSetup
+********************************************************************************
+* Summary:
+*   Fills the buffer in with what a kernel works on,for BenchRun.
+*   Needs STACK_BENCH_ENABLED.
+*
+* Parameters:
+*   kernel - which,BENCH_CHECKSUM etc.
+*   buf - buffer of BENCHBUFLEN bytes.
+*   size - size to run it over,up to MAXFRAMELEN.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void BenchSetup(unsigned char kernel, unsigned char* buf, unsigned int size);
+
+/*******************************************************************************
+* Function Name: BenchRun
+********************************************************************************
+* Summary:
+*   Calls a kernel over and over,on what BenchSetup filled the buffer in
+*   with.It can be called again without BenchSetup.
+*   Needs STACK_BENCH_ENABLED.
+*
+* Parameters:
+*   kernel - which,BENCH_CHECKSUM etc.
+*   buf - the buffer passed to BenchSetup.
+*   size - the size passed to BenchSetup.
+*   count - how many calls.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void BenchRun(unsigned char kernel, unsigned char* buf, unsigned int size, unsigned int count);
+
+/*******************************************************************************
+* Function Name: StackBench
+********************************************************************************
+* Summary:
+*   Times every kernel over every size in BenchSizes,and works out how
+*   many CPU cycles each call takes,from the ProfTimer ticks and BENCHCPUHZ.
+*   The loop in BenchRun is counted in with the kernel.Interrupts are left
+*   as they are,so turn them off for steady numbers.
+*   ProfTimer is 16 bits,so no single call may take 65536 ticks or more.
+*   Needs STACK_BENCH_ENABLED.
+*
+* Parameters:
+*   buf - buffer of BENCHBUFLEN bytes.
+*   result - where to put the results.
+*
+* Returns:
+*   TRUE(0)- if the benchmarks were run.
+*   FALSE(1) - if they are not built in.
+*
+*******************************************************************************/
+unsigned char StackBench(unsigned char* buf, BENCHRESULT* result);
+
+#endif
+
+/* [] END OF FILE */
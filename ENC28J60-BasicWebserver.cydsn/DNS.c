@@ -30,8 +30,7 @@
 unsigned int DNSLookup( const char* url ){
     /*Setup variables required*/
     unsigned char packet[MAXPACKETLEN];
-    unsigned int len,noChars = 0;
-    const char* c;
+    unsigned int len;
     unsigned char* dnsq;
     unsigned int timeout=9000;
     
@@ -61,19 +60,7 @@ unsigned int DNSLookup( const char* url ){
     
     /*----Setup the DNS Query----*/
     /* Format the URL into a proper DNS Query*/
-    dnsq = (char*)(packet + sizeof(DNShdr) + 1);//Note the +1.
- 
-    for( c = url; *c != '\0' && *c !='\\'; ++c, ++dnsq){
-        *dnsq = *c;
-        if ( *c == '.' ){
-            *(dnsq-(noChars+1)) = noChars;
-            noChars = 0;
-        }
-        else ++noChars;
-    }
-    
-    *(dnsq-(noChars+1)) = noChars;
-    *dnsq++ = 0;
+    dnsq = DNSEncodeName(packet + sizeof(DNShdr), url);
     
     /* Define the host type and class*/
     *dnsq++ = 0;
@@ -88,13 +75,8 @@ unsigned int DNSLookup( const char* url ){
     dns->udp.len = (len-sizeof(IPhdr));
     dns->udp.ip.len = (len-sizeof(EtherNetII));
     
-    /*Calculate the UDP and IP Checksums*/
-    dns->udp.ip.chksum=checksum((unsigned char*)dns + sizeof(EtherNetII),sizeof(IPhdr) - sizeof(EtherNetII),0);
-    dns->udp.chksum=checksum((unsigned char*)dns->udp.ip.source,(len+8)-sizeof(IPhdr),1);
-    //(len+8) because Source IP and DestIP,which are part of the pseduoheader,are 4 bytes each.
-    
-    /*Send the DNS Query packet*/
-    MACWrite(packet,len);
+    /*Checksum and send the DNS Query packet*/
+    SendIPPacket(packet,len,0);
     
     /*Now that we have sent the query,
       we wait for the reply,and then process it.*/
@@ -111,41 +93,16 @@ unsigned int DNSLookup( const char* url ){
         /*Yes,its a DNS Reply Packet.*/
             dns = (DNShdr*)packet;
             /*Check if its our ID,and there are no errors.*/
-            if ( (dns->id == (0xbaab)) && ((dns->flags && 0x008F)!=0x0080)){
+            if ( (dns->id == (0xbaab)) && ((dns->flags & 0x008F)==0x0080)){
             /*Yes,it is error free,and our DNS Reply.Lets extract the IP*/
-                dnsq=packet+len;
-                /*Lets go into a loop to browse through the returned resources.*/
-                for(;;){
-                    if(*dnsq==0xC0){//Is it a pointer?
-                        dnsq+=2;
-                    }else{
-                        /*we just search for the first, zero=root domain
-                        all other octets must be non zero*/
-                        while (++dnsq < packet+len ) {
-                            if(*dnsq == 0){
-                                ++dnsq;
-                                break;
-                            }       
-                        }       
-                    }
-                    /* There might be multipe records in the answer. 
-                       We are searching for an 'A' record (contains IP Address).*/
-                    if (dnsq[1] == 1 && dnsq[9] == 4) { /*Check if type "A" and IPv4*/
-                        /*Aha! We have our IP!.Lets save it to the global variable serverIP*/
-                        memcpy( serverIP, dnsq+10, sizeof(serverIP));
-                        if(serverIP[0]==0){
-							return FALSE;
-						} else {
-                        	return TRUE;
-						}
-                        break;
-                    }
-                    /*Advance pointer to browse the remaining records,since we
-                      havent got the right one with an IP*/
-                    dnsq += dnsq[9] + 10;
-                }//for loop to browse records       
-        
-                break;
+                dnsq=DNSFindAnswer(packet+len, packet+len);
+                /*Aha! We have our IP!.Lets save it to the global variable serverIP*/
+                memcpy( serverIP, dnsq, sizeof(serverIP));
+                if(serverIP[0]==0){
+                    return FALSE;
+                } else {
+                    return TRUE;
+                }
             }else{
                 return(FALSE);
             }
@@ -153,4 +110,82 @@ unsigned int DNSLookup( const char* url ){
     }//Outer Packet waiting while loop
     return(FALSE);
 }
+
+/*******************************************************************************
+* Function Name: DNSEncodeName
+********************************************************************************
+* Summary:
+*   Writes a domain name into a DNS Query,as a label per part,each
+*   preceded by its length,and ended by a zero length.
+*
+* Parameters:
+*   name - where the name goes in the packet.
+*   url - the domain name,eg: "google.com".It ends at a '\0' or a '\\'.
+*             
+* Returns:
+*   pointer to the byte after the name.
+*******************************************************************************/
+unsigned char* DNSEncodeName(unsigned char* name, const char* url){
+    unsigned char* dnsq = name + 1;//Note the +1.
+    unsigned int noChars = 0;
+    const char* c;
+ 
+    for( c = url; *c != '\0' && *c !='\\'; ++c, ++dnsq){
+        *dnsq = *c;
+        if ( *c == '.' ){
+            *(dnsq-(noChars+1)) = noChars;
+            noChars = 0;
+        }
+        else ++noChars;
+    }
+    
+    *(dnsq-(noChars+1)) = noChars;
+    *dnsq++ = 0;
+    return dnsq;
+}
+
+/*******************************************************************************
+* Function Name: DNSFindAnswer
+********************************************************************************
+* Summary:
+*   Browses through the resource records of a DNS Reply for the first 'A'
+*   record,that holds an IPv4 Address.The reply has to have one,this
+*   does not stop until it finds it.
+*
+* Parameters:
+*   records - first resource record,after the query the reply starts with.
+*   end - end of that query.A name that is not a pointer is looked through
+*         for its zero length only up to here.
+*             
+* Returns:
+*   pointer to the IP Address in the 'A' record.
+*******************************************************************************/
+unsigned char* DNSFindAnswer(unsigned char* records, unsigned char* end){
+    unsigned char* dnsq = records;
+    
+    /*Lets go into a loop to browse through the returned resources.*/
+    for(;;){
+        if(*dnsq==0xC0){//Is it a pointer?
+            dnsq+=2;
+        }else{
+            /*we just search for the first, zero=root domain
+            all other octets must be non zero*/
+            while (++dnsq < end ) {
+                if(*dnsq == 0){
+                    ++dnsq;
+                    break;
+                }       
+            }       
+        }
+        /* There might be multipe records in the answer. 
+           We are searching for an 'A' record (contains IP Address).*/
+        if (dnsq[1] == 1 && dnsq[9] == 4) { /*Check if type "A" and IPv4*/
+            return dnsq + 10;
+        }
+        /*Advance pointer to browse the remaining records,since we
+          havent got the right one with an IP*/
+        dnsq += dnsq[9] + 10;
+    }
+}
+
 /* [] END OF FILE */
\ No newline at end of file
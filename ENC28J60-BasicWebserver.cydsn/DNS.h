@@ -29,6 +29,40 @@
 *******************************************************************************/
 unsigned int DNSLookup( const char* url );
 
+/*******************************************************************************
+* Function Name: DNSEncodeName
+********************************************************************************
+* Summary:
+*   Writes a domain name into a DNS Query,as a label per part,each
+*   preceded by its length,and ended by a zero length.
+*
+* Parameters:
+*   name - where the name goes in the packet.
+*   url - the domain name,eg: "google.com".It ends at a '\0' or a '\\'.
+*             
+* Returns:
+*   pointer to the byte after the name.
+*******************************************************************************/
+unsigned char* DNSEncodeName(unsigned char* name, const char* url);
+
+/*******************************************************************************
+* Function Name: DNSFindAnswer
+********************************************************************************
+* Summary:
+*   Browses through the resource records of a DNS Reply for the first 'A'
+*   record,that holds an IPv4 Address.The reply has to have one,this
+*   does not stop until it finds it.
+*
+* Parameters:
+*   records - first resource record,after the query the reply starts with.
+*   end - end of that query.A name that is not a pointer is looked through
+*         for its zero length only up to here.
+*             
+* Returns:
+*   pointer to the IP Address in the 'A' record.
+*******************************************************************************/
+unsigned char* DNSFindAnswer(unsigned char* records, unsigned char* end);
+
 #endif
 
 /* [] END OF FILE */
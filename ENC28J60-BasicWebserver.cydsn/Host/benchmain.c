@@ -0,0 +1,138 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Kernel benchmarks
+ Description : Runs the kernels in "Bench.c" over each of BenchSizes,
+ timed against the host's clock,and prints the time per call and per byte.
+ StackBench does the same on the PSoC3,in CPU cycles,with ProfTimer.
+ The stack is built with the Keil C51 layout here,so the numbers are for
+ comparing one build of the stack with another,not for the 8051.
+
+ Usage: encbench [-t ms] [-r runs] [-k kernel]
+  -t     Time to run each kernel for,at each size.
+  -r     How many times it is run for that long.The fastest is kept.
+  -k     Only the kernel of that name.
+*/
+#include <device.h>
+#include "IPStackMain.h"
+
+/*Calls per BenchRun,which takes an unsigned int count.*/
+#define BENCHCHUNK      1000
+
+static void TimeKernel(unsigned char kernel, uint16 size, uint64_t runNs, unsigned long runs);
+static uint64_t HostNs(void);
+
+static unsigned char benchBuf[BENCHBUFLEN];
+
+/*main has to return a real int,whatever the stack thinks an int is.*/
+#undef int
+int main(int argc, char** argv){
+    unsigned long ms = 20;
+    unsigned long runs = 5;
+    const char* only = 0;
+    unsigned char kernel;
+    unsigned char s;
+    unsigned char found = 0;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++){
+        if (!strcmp(argv[arg], "-t") && (arg + 1 < argc)){
+            ms = strtoul(argv[++arg], 0, 0);
+        }else if (!strcmp(argv[arg], "-r") && (arg + 1 < argc)){
+            runs = strtoul(argv[++arg], 0, 0);
+        }else if (!strcmp(argv[arg], "-k") && (arg + 1 < argc)){
+            only = argv[++arg];
+        }else{
+            printf("Usage: encbench [-t ms] [-r runs] [-k kernel]\n");
+            return 2;
+        }
+    }
+    if (!ms || !runs){
+        printf("-t and -r have to be at least 1.\n");
+        return 2;
+    }
+
+    printf("%-18s %6s %12s %10s\n", "Kernel", "Size", "ns/call", "ns/byte");
+    for (kernel = 0; kernel < BENCHKERNELS; kernel++){
+        if (only && strcmp(only, BenchNames[kernel])){
+            continue;
+        }
+        found = 1;
+        for (s = 0; s < BENCHSIZES; s++){
+            TimeKernel(kernel, BenchSizes[s], (uint64_t)ms * 1000000, runs);
+        }
+    }
+    if (!found){
+        printf("No kernel called %s.\n", only);
+        return 2;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: TimeKernel
+********************************************************************************
+* Summary:
+*   Times one kernel at one size,and prints a line for it.The calls are
+*   made in chunks of BENCHCHUNK until runNs has gone by,runs times over,
+*   and the fastest run is the one printed.
+*
+* Parameters:
+*   kernel - which,BENCH_CHECKSUM etc.
+*   size - size to run it over.
+*   runNs - how long each run goes on for.
+*   runs - how many runs.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void TimeKernel(unsigned char kernel, uint16 size, uint64_t runNs, unsigned long runs){
+    uint64_t started;
+    uint64_t ns;
+    unsigned long calls;
+    double perCall;
+    double best = 0;
+
+    BenchSetup(kernel, benchBuf, size);
+    while (runs--){
+        calls = 0;
+        started = HostNs();
+        do{
+            BenchRun(kernel, benchBuf, size, BENCHCHUNK);
+            calls += BENCHCHUNK;
+            ns = HostNs() - started;
+        }while (ns < runNs);
+        perCall = (double)ns / calls;
+        if (!best || (perCall < best)){
+            best = perCall;
+        }
+    }
+
+    /*add32 and SwapAddresses do the same work at any size.*/
+    if ((kernel == BENCH_ADD32) || (kernel == BENCH_SWAP)){
+        printf("%-18s %6u %12.1f %10s\n", BenchNames[kernel], size, best, "-");
+    }else{
+        printf("%-18s %6u %12.1f %10.3f\n", BenchNames[kernel], size, best, best / size);
+    }
+}
+
+/*******************************************************************************
+* Function Name: HostNs
+********************************************************************************
+* Summary:
+*   Reads the host's monotonic clock.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nanoseconds,from some point in the past.
+*******************************************************************************/
+static uint64_t HostNs(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,138 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Host stand-in for the PSoC Creator generated API
+ Description : Takes the place of the generated <device.h> when the project
+ is built for Linux,see "readme.txt" in this folder.
+ The components the stack uses(SPIM,SS,ProfTimer,PACKET,LCD,DieTemp) are
+ declared here,and implemented in "psoc.c" on top of the ENC28J60 model in
+ "encsim.c".
+
+ The stack was written for Keil C51,so its structures are laid over the
+ bytes of a packet and assume a 16 bit int,big endian byte order,no padding
+ and bit fields allocated from the least significant bit.The bottom of this
+ file sets gcc up to match,for every file that includes it after the
+ system headers below.The Makefile forces it in first with -include.
+*/
+#ifndef HOST_DEVICE_H
+#define HOST_DEVICE_H
+
+/*Everything from the C library the stack or the host files use.These have
+to come in before int is redefined below,or their prototypes would be wrong.*/
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef uint8_t     uint8;
+typedef uint16_t    uint16;
+typedef uint32_t    uint32;
+typedef int8_t      int8;
+typedef int16_t     int16;
+typedef int32_t     int32;
+typedef volatile uint8 reg8;
+typedef unsigned char cystatus;
+
+#define CY_ISR(f)           void f(void)
+#define CY_ISR_PROTO(f)     void f(void)
+
+/*The stack runs big endian,as on the PSoC3.*/
+#define CYSWAP_ENDIAN16(x)  ((uint16)(((uint16)(x) << 8) | ((uint16)(x) >> 8)))
+#define LO8(x)              ((uint8)(x))
+#define HI8(x)              ((uint8)((x) >> 8))
+#define LO16(x)             ((uint16)(x))
+#define HI16(x)             ((uint16)((uint32)(x) >> 16))
+
+/*Clocks,as cyfitter.h has them for the project.*/
+#define BCLK__BUS_CLK__HZ   66857142U
+
+/*------------------------SPIM------------------------------------------*/
+/*The data registers are lvalues,so spi.h can use them as it does on the
+PSoC3.A write is clocked through the model on the next register access.*/
+#define SPIM_TXDATA_REG             (*SimSpimTxData())
+#define SPIM_RXDATA_REG             (*SimSpimRxData())
+#define SPIM_TX_STATUS_REG          (SimSpimTxStatus())
+#define SPIM_RX_STATUS_REG          (SimSpimRxStatus())
+
+#define SPIM_STS_SPI_DONE           (0x01u)
+#define SPIM_STS_TX_FIFO_EMPTY      (0x02u)
+#define SPIM_STS_TX_FIFO_NOT_FULL   (0x04u)
+#define SPIM_STS_RX_FIFO_NOT_EMPTY  (0x20u)
+#define SPIM_RXBUFFERSIZE           (4u)
+
+uint8* SimSpimTxData(void);
+uint8* SimSpimRxData(void);
+uint8 SimSpimTxStatus(void);
+uint8 SimSpimRxStatus(void);
+
+void SPIM_Start(void);
+uint8 SPIM_ReadTxStatus(void);
+uint8 SPIM_ReadRxStatus(void);
+void SPIM_ClearRxBuffer(void);
+
+void SPIM_SetTxInterruptMode(uint8 intSource);
+void SPIM_SetRxInterruptMode(uint8 intSource);
+
+/*------------------------DMA-------------------------------------------*/
+/*There are no DMA channels.The API is here so that SPI_DMA_ENABLED builds,
+but spiInit gets no channels or TDs,and falls back to the CPU paths.*/
+#define SPIM_TXDATA_PTR             ((reg8*)0)
+#define SPIM_RXDATA_PTR             ((reg8*)0)
+#define CYDEV_SRAM_BASE             (0x0000u)
+#define CYDEV_PERIPH_BASE           (0x4000u)
+#define DMA_INVALID_CHANNEL         (0xFFu)
+#define DMA_INVALID_TD              (0xFFu)
+#define CY_DMA_DISABLE_TD           (0xFEu)
+#define CY_DMA_TD_INC_SRC_ADR       (0x01u)
+#define CY_DMA_TD_INC_DST_ADR       (0x02u)
+#define SPI_RxDMA__TD_TERMOUT_EN    (0x04u)
+#define CY_DMA_CPU_REQ              (0x01u)
+
+uint8 SPI_TxDMA_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress);
+uint8 SPI_RxDMA_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress);
+void SPI_RxDone_StartEx(void (*isr)(void));
+uint8 CyDmaTdAllocate(void);
+cystatus CyDmaTdSetConfiguration(uint8 tdHandle, uint16 transferCount, uint8 nextTd, uint8 configuration);
+cystatus CyDmaTdSetAddress(uint8 tdHandle, uint16 source, uint16 destination);
+cystatus CyDmaChSetInitialTd(uint8 chHandle, uint8 startTd);
+cystatus CyDmaChEnable(uint8 chHandle, uint8 preserveTds);
+cystatus CyDmaChSetRequest(uint8 chHandle, uint8 request);
+
+/*------------------------Pins and the rest-----------------------------*/
+void SS_Write(uint8 value);//Chip select of the ENC28J60 on the board,see SimSelect.
+uint8 PACKET_Read(void);//Its INT pin.
+uint8 PACKET_ClearInterrupt(void);
+void PACKET_ISR_StartEx(void (*isr)(void));
+
+void ProfTimer_Start(void);
+uint16 ProfTimer_ReadCounter(void);
+
+void CyDelay(uint32 milliseconds);
+void CyDelayUs(uint16 microseconds);
+
+void LCD_Start(void);
+void LCD_Position(uint8 row, uint8 column);
+void LCD_PrintString(const char* string);
+void DieTemp_GetTemp(int16* temperature);
+
+/*------------------------Host only-------------------------------------*/
+/*Which board the components above belong to,from 0,and so which ENC28J60
+the pins go to.There is only board 0 unless "netsim.c" is running more.*/
+void HostSetBoard(uint8 board);
+
+/*------------------------Keil C51 layout--------------------------------*/
+/*The host files that implement the above define HOST_NATIVE first,since
+they work with native types.*/
+#ifndef HOST_NATIVE
+/*Bit fields come out most significant bit first under scalar_storage_order,
+so the headers with bit fields in packets swap their order on this.*/
+#define BITFIELDS_MSB_FIRST
+#pragma pack(1)
+#pragma scalar_storage_order big-endian
+#define int short
+#endif
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,1527 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : ENC28J60 behavioural model
+ Description : See "encsim.h".Page and section numbers are from the
+ ENC28J60 datasheet(DS39662C),as in "enc28j60.c".
+*/
+#include <string.h>
+#include "encsim.h"
+
+/*SPI opcodes,the top 3 bits of the first byte.*/
+#define OP_RCR          0
+#define OP_RBM          1
+#define OP_WCR          2
+#define OP_WBM          3
+#define OP_BFS          4
+#define OP_BFC          5
+#define OP_SRC          7
+
+/*Bank 0*/
+#define ERDPTL          0x00
+#define EWRPTL          0x02
+#define ETXSTL          0x04
+#define ETXNDL          0x06
+#define ERXSTL          0x08
+#define ERXNDL          0x0A
+#define ERXRDPTL        0x0C
+#define ERXWRPTL        0x0E
+#define EDMASTL         0x10
+#define EDMANDL         0x12
+#define EDMADSTL        0x14
+#define EDMACSL         0x16
+/*Common to all banks*/
+#define EIE             0x1B
+#define EIR             0x1C
+#define ESTAT           0x1D
+#define ECON2           0x1E
+#define ECON1           0x1F
+/*Bank 1*/
+#define EHT0            0x00
+#define EPMM0           0x08
+#define EPMCSL          0x10
+#define EPMOL           0x14
+#define ERXFCON         0x18
+#define EPKTCNT         0x19
+/*Bank 2*/
+#define MACON1          0x00
+#define MACON3          0x02
+#define MAMXFLL         0x0A
+#define MICMD           0x12
+#define MIREGADR        0x14
+#define MIWRL           0x16
+#define MIWRH           0x17
+#define MIRDL           0x18
+#define MIRDH           0x19
+/*Bank 3*/
+#define MAADR5          0x00
+#define MAADR6          0x01
+#define MAADR3          0x02
+#define MAADR4          0x03
+#define MAADR1          0x04
+#define MAADR2          0x05
+#define MISTAT          0x0A
+#define EREVID          0x12
+
+#define EIE_INTIE       0x80
+#define EIR_PKTIF       0x40
+#define EIR_DMAIF       0x20
+#define EIR_LINKIF      0x10
+#define EIR_TXIF        0x08
+#define EIR_TXERIF      0x02
+#define EIR_RXERIF      0x01
+#define ESTAT_INT       0x80
+#define ESTAT_LATECOL   0x10
+#define ESTAT_TXABRT    0x02
+#define ESTAT_CLKRDY    0x01
+#define ECON2_AUTOINC   0x80
+#define ECON2_PKTDEC    0x40
+#define ECON1_TXRST     0x80
+#define ECON1_RXRST     0x40
+#define ECON1_DMAST     0x20
+#define ECON1_CSUMEN    0x10
+#define ECON1_TXRTS     0x08
+#define ECON1_RXEN      0x04
+#define ECON1_BSEL      0x03
+#define ERXFCON_UCEN    0x80
+#define ERXFCON_ANDOR   0x40
+#define ERXFCON_CRCEN   0x20
+#define ERXFCON_PMEN    0x10
+#define ERXFCON_MPEN    0x08
+#define ERXFCON_HTEN    0x04
+#define ERXFCON_MCEN    0x02
+#define ERXFCON_BCEN    0x01
+#define ERXFCON_FILTERS (ERXFCON_UCEN | ERXFCON_PMEN | ERXFCON_MPEN | ERXFCON_HTEN | ERXFCON_MCEN | ERXFCON_BCEN)
+#define MACON1_MARXEN   0x01
+#define MACON3_PADCFG   0xE0
+#define MACON3_TXCRCEN  0x10
+#define MACON3_HFRMEN   0x04
+#define MACON3_FRMLNEN  0x02
+#define MACON3_FULDPX   0x01
+#define MICMD_MIISCAN   0x02
+#define MICMD_MIIRD     0x01
+#define MISTAT_NVALID   0x04
+#define MISTAT_SCAN     0x02
+#define MISTAT_BUSY     0x01
+
+/*Per packet control byte,in front of each packet to transmit.
+See FIGURE 7-1 on Page 40.*/
+#define TXCTRL_PHUGEEN  0x08
+#define TXCTRL_PPADEN   0x04
+#define TXCTRL_PCRCEN   0x02
+#define TXCTRL_POVERRIDE 0x01
+
+/*PHY registers*/
+#define PHCON1          0x00
+#define PHSTAT1         0x01
+#define PHID1           0x02
+#define PHID2           0x03
+#define PHCON2          0x10
+#define PHSTAT2         0x11
+#define PHIE            0x12
+#define PHIR            0x13
+#define PHLCON          0x14
+#define PHYREGS         0x15
+
+#define PHCON1_PRST     0x8000
+#define PHCON1_PLOOPBK  0x4000
+#define PHCON1_PDPXMD   0x0100
+#define PHSTAT1_PFDPX   0x1000
+#define PHSTAT1_PHDPX   0x0800
+#define PHSTAT1_LLSTAT  0x0004
+#define PHCON2_HDLDIS   0x0100
+#define PHSTAT2_LSTAT   0x0400
+#define PHSTAT2_DPXSTAT 0x0200
+#define PHIE_PGEIE      0x0002
+#define PHIR_PLNKIF     0x0010
+#define PHIR_PGIF       0x0004
+
+/*Rev. B7 silicon.*/
+#define SIMREVID        0x06
+
+#define SRAMSIZE        0x2000
+#define SRAMMASK        0x1fff
+
+/*An MII operation takes 10.24us.See Section 3.3 on Page 21.*/
+#define MIINS           10240
+/*10Mbps,so 800ns a byte.*/
+#define WIREBYTENS      800
+/*Preamble and start of frame delimiter,and the interpacket gap.*/
+#define PREAMBLELEN     8
+#define IPGLEN          12
+
+#define MINFRAMELEN     64
+#define ETHHDRLEN       14
+#define FCSLEN          4
+
+/*One ENC28J60.*/
+typedef struct {
+    uint8_t Reg[4][32];//Control registers.Those common to all banks are kept in bank 0.
+    uint8_t Sram[SRAMSIZE];
+    uint16_t Phy[PHYREGS];
+
+    /*SPI transaction under way.*/
+    uint8_t Selected;
+    uint8_t Op;
+    uint8_t Arg;
+    uint16_t Count;//Bytes so far,the opcode included.
+
+    /*MII operation under way.*/
+    uint8_t MiiBusy;
+    uint64_t MiiDoneAt;
+
+    /*Frame going out.*/
+    uint8_t TxBusy;
+    uint8_t TxAbort;
+    uint64_t TxDoneAt;
+    uint16_t TxLen;
+    uint8_t TxFrame[SRAMSIZE];
+
+    uint8_t LinkUp;
+    uint8_t IntPin;
+    SIMISR Isr;
+    SIMWIRE Wire;
+    uint32_t Counters[SIMCNT_COUNT];
+} ENCSIM;
+
+static ENCSIM Chips[SIMMAXCHIPS];
+static uint64_t Now;
+static uint64_t NextEvent;//Earliest MiiDoneAt or TxDoneAt of any chip.
+static SIMTIMER Timer;//See SimSetTimer.
+static uint64_t TimerAt;
+static uint32_t SpiByteNs = (uint32_t)(8000000000ULL / SIMSPIHZ);
+static uint32_t CrcTable[256];
+
+static uint8_t* RegAt(ENCSIM* c, uint8_t addr);
+static uint16_t Get16(ENCSIM* c, uint8_t bank, uint8_t addr);
+static void Put16(ENCSIM* c, uint8_t bank, uint8_t addr, uint16_t value);
+static uint8_t IsMacMii(ENCSIM* c, uint8_t addr);
+static uint8_t ReadReg(ENCSIM* c, uint8_t addr);
+static void WriteReg(ENCSIM* c, uint8_t addr, uint8_t value);
+static uint16_t ReadPhy(ENCSIM* c, uint8_t addr);
+static void WritePhy(ENCSIM* c, uint8_t addr, uint16_t value);
+static void Reset(ENCSIM* c);
+static void ResetPhy(ENCSIM* c);
+static void Update(ENCSIM* c);
+static void UpdateInt(ENCSIM* c);
+static void StartTx(ENCSIM* c);
+static void FinishTx(ENCSIM* c);
+static void RunDma(ENCSIM* c);
+static uint8_t Receive(ENCSIM* c, const uint8_t* frame, uint16_t len);
+static uint8_t Filter(ENCSIM* c, const uint8_t* frame, uint16_t len, uint8_t crcOk);
+static uint16_t RxFree(ENCSIM* c);
+static uint16_t RxNext(ENCSIM* c, uint16_t addr);
+static uint8_t FullDuplex(ENCSIM* c);
+static void Schedule(uint64_t at);
+static uint8_t AnySelected(void);
+static uint32_t Crc32(const uint8_t* data, uint16_t len);
+static uint32_t InetAdd(uint32_t sum, const uint8_t* data, uint16_t len);
+
+void SimInit(void){
+    uint8_t i;
+    uint32_t crc;
+    uint16_t n;
+    uint8_t bit;
+
+    /*Table for the reflected Ethernet CRC.*/
+    for (n = 0; n < 256; n++){
+        crc = n;
+        for (bit = 0; bit < 8; bit++){
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320UL) : (crc >> 1);
+        }
+        CrcTable[n] = crc;
+    }
+
+    Now = 0;
+    NextEvent = UINT64_MAX;
+    Timer = 0;
+    memset(Chips, 0, sizeof(Chips));
+    for (i = 0; i < SIMMAXCHIPS; i++){
+        Chips[i].Selected = 0;
+        Chips[i].LinkUp = 1;
+        Chips[i].IntPin = 1;
+        ResetPhy(&Chips[i]);
+        Reset(&Chips[i]);
+    }
+}
+
+uint64_t SimNow(void){
+    return Now;
+}
+
+void SimAdvance(uint32_t ns){
+    uint64_t target = Now + ns;
+    uint64_t at;
+    uint8_t i;
+    SIMTIMER timer;
+
+    /*What falls due is done in order,at the time it falls due,so frames
+    reach the wire with the right time on them.*/
+    for (;;){
+        at = NextEvent;
+        if (Timer && (TimerAt < at) && !AnySelected()){
+            at = TimerAt;
+        }
+        if (at > target){
+            break;//Nothing due yet,which is most of the time.
+        }
+        if (at > Now){
+            Now = at;
+        }
+        if (at == NextEvent){
+            NextEvent = UINT64_MAX;
+            for (i = 0; i < SIMMAXCHIPS; i++){
+                Update(&Chips[i]);
+            }
+        }else{
+            timer = Timer;
+            Timer = 0;
+            timer();
+        }
+    }
+    Now = target;
+}
+
+void SimSetTime(uint64_t ns){
+    Now = ns;
+}
+
+void SimSetTimer(uint64_t at, SIMTIMER timer){
+    TimerAt = at;
+    Timer = timer;
+}
+
+void SimSettle(void){
+    uint8_t i;
+    uint64_t at;
+
+    for (;;){
+        at = UINT64_MAX;
+        for (i = 0; i < SIMMAXCHIPS; i++){
+            if (Chips[i].TxBusy && (Chips[i].TxDoneAt < at)){
+                at = Chips[i].TxDoneAt;
+            }
+        }
+        if (at == UINT64_MAX){
+            return;
+        }
+        SimAdvance((at > Now) ? (uint32_t)(at - Now) : 0);
+    }
+}
+
+void SimSetSpiRate(uint32_t hz){
+    SpiByteNs = (uint32_t)(8000000000ULL / hz);
+}
+
+void SimSelect(uint8_t chip, uint8_t level){
+    ENCSIM* c;
+
+    if (chip >= SIMMAXCHIPS){
+        return;
+    }
+    c = &Chips[chip];
+    if (level && c->Selected){
+        /*Rising edge,the transaction is over.*/
+        c->Selected = 0;
+        if (c->Count){
+            c->Counters[SIMCNT_SPIOPS]++;
+        }
+        /*A soft reset takes effect once CS goes high.*/
+        if ((c->Count == 1) && (c->Op == OP_SRC)){
+            Reset(c);
+        }
+        UpdateInt(c);
+        /*A timer held up by the transaction can go off now.*/
+        if (Timer && (TimerAt <= Now)){
+            SimAdvance(0);
+        }
+    }else if (!level && !c->Selected){
+        c->Selected = 1;
+        c->Count = 0;
+    }
+}
+
+uint8_t SimSpiByte(uint8_t mosi){
+    ENCSIM* c = 0;
+    uint8_t miso = 0;
+    uint8_t i;
+    uint16_t ptr;
+
+    for (i = 0; i < SIMMAXCHIPS; i++){
+        if (Chips[i].Selected){
+            c = &Chips[i];
+            break;
+        }
+    }
+    SimAdvance(SpiByteNs);
+    if (c == 0){
+        return 0xff;
+    }
+    c->Counters[SIMCNT_SPIBYTES]++;
+
+    if (c->Count == 0){
+        c->Op = mosi >> 5;
+        c->Arg = mosi & 0x1f;
+        c->Count = 1;
+        return 0;
+    }
+
+    switch (c->Op){
+    case OP_RCR:
+        /*MAC and MII registers shift out a dummy byte first.
+        See FIGURE 4-4 on Page 29.*/
+        if ((c->Count > 1) || !IsMacMii(c, c->Arg)){
+            miso = ReadReg(c, c->Arg);
+        }
+        break;
+    case OP_RBM:
+        ptr = Get16(c, 0, ERDPTL);
+        miso = c->Sram[ptr & SRAMMASK];
+        if (ReadReg(c, ECON2) & ECON2_AUTOINC){
+            /*ERDPT wraps from ERXND to ERXST.See Section 7.2.4 on Page 47.*/
+            if (ptr == Get16(c, 0, ERXNDL)){
+                ptr = Get16(c, 0, ERXSTL);
+            }else{
+                ptr = (ptr + 1) & SRAMMASK;
+            }
+            Put16(c, 0, ERDPTL, ptr);
+        }
+        break;
+    case OP_WCR:
+        if (c->Count == 1){
+            WriteReg(c, c->Arg, mosi);
+        }
+        break;
+    case OP_WBM:
+        ptr = Get16(c, 0, EWRPTL);
+        c->Sram[ptr & SRAMMASK] = mosi;
+        if (ReadReg(c, ECON2) & ECON2_AUTOINC){
+            Put16(c, 0, EWRPTL, (ptr + 1) & SRAMMASK);
+        }
+        break;
+    case OP_BFS:
+    case OP_BFC:
+        /*Only the ETH registers take Bit Field Set/Clear.*/
+        if ((c->Count == 1) && !IsMacMii(c, c->Arg)){
+            if (c->Op == OP_BFS){
+                WriteReg(c, c->Arg, ReadReg(c, c->Arg) | mosi);
+            }else{
+                WriteReg(c, c->Arg, ReadReg(c, c->Arg) & ~mosi);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    if (c->Count < 0xffff){
+        c->Count++;
+    }
+    return miso;
+}
+
+uint8_t SimIntPin(uint8_t chip){
+    return (chip < SIMMAXCHIPS) ? Chips[chip].IntPin : 1;
+}
+
+void SimSetIsr(uint8_t chip, SIMISR isr){
+    if (chip < SIMMAXCHIPS){
+        Chips[chip].Isr = isr;
+    }
+}
+
+void SimSetLink(uint8_t chip, uint8_t up){
+    ENCSIM* c;
+
+    if ((chip >= SIMMAXCHIPS) || (Chips[chip].LinkUp == !!up)){
+        return;
+    }
+    c = &Chips[chip];
+    c->LinkUp = !!up;
+    if (up){
+        c->Phy[PHSTAT2] |= PHSTAT2_LSTAT;
+    }else{
+        /*LLSTAT latches low.*/
+        c->Phy[PHSTAT2] &= ~PHSTAT2_LSTAT;
+        c->Phy[PHSTAT1] &= ~PHSTAT1_LLSTAT;
+    }
+    /*See Section 12.1.5 on Page 71.*/
+    c->Phy[PHIR] |= PHIR_PLNKIF;
+    if (c->Phy[PHIE] & PHIE_PGEIE){
+        c->Phy[PHIR] |= PHIR_PGIF;
+        c->Reg[0][EIR] |= EIR_LINKIF;
+    }
+    UpdateInt(c);
+}
+
+void SimSetWire(uint8_t chip, SIMWIRE wire){
+    if (chip < SIMMAXCHIPS){
+        Chips[chip].Wire = wire;
+    }
+}
+
+uint8_t SimDeliver(uint8_t chip, const uint8_t* frame, uint16_t len){
+    if (chip >= SIMMAXCHIPS){
+        return SIMRX_OFF;
+    }
+    return Receive(&Chips[chip], frame, len);
+}
+
+uint16_t SimAddFcs(uint8_t* frame, uint16_t len){
+    uint32_t crc;
+
+    /*Least significant byte first on the wire.*/
+    crc = Crc32(frame, len);
+    frame[len]     = (uint8_t)crc;
+    frame[len + 1] = (uint8_t)(crc >> 8);
+    frame[len + 2] = (uint8_t)(crc >> 16);
+    frame[len + 3] = (uint8_t)(crc >> 24);
+    return len + FCSLEN;
+}
+
+uint8_t SimSumsOk(const uint8_t* frame, uint16_t len){
+    const uint8_t* ip = frame + ETHHDRLEN;
+    uint8_t pseudo[4];
+    uint16_t hdrLen;
+    uint16_t ipLen;
+    uint32_t sum;
+
+    if ((len < ETHHDRLEN + 20) || (frame[12] != 0x08) || (frame[13] != 0x00) || ((ip[0] >> 4) != 4)){
+        return 1;
+    }
+    hdrLen = (uint16_t)((ip[0] & 0x0f) * 4);
+    ipLen = (uint16_t)((ip[2] << 8) | ip[3]);
+    if ((hdrLen < 20) || (ipLen < hdrLen) || (ETHHDRLEN + ipLen > len)){
+        return 0;
+    }
+    if (InetAdd(0, ip, hdrLen) != 0xffff){
+        return 0;
+    }
+
+    switch (ip[9]){
+    case 1://ICMP
+        sum = 0;
+        break;
+    case 17://UDP
+        if ((ipLen - hdrLen >= 8) && !ip[hdrLen + 6] && !ip[hdrLen + 7]){
+            return 1;
+        }
+        /*Fall through,UDP has the same pseudoheader as TCP.*/
+    case 6://TCP
+        /*Source and destination IP,then zero,the protocol,and the length.
+        See RFC 793 Section 3.1.*/
+        pseudo[0] = 0;
+        pseudo[1] = ip[9];
+        pseudo[2] = (uint8_t)((ipLen - hdrLen) >> 8);
+        pseudo[3] = (uint8_t)(ipLen - hdrLen);
+        sum = InetAdd(InetAdd(0, &ip[12], 8), pseudo, 4);
+        break;
+    default:
+        return 1;
+    }
+    return InetAdd(sum, ip + hdrLen, ipLen - hdrLen) == 0xffff;
+}
+
+uint32_t SimCounter(uint8_t chip, uint8_t which){
+    if ((chip >= SIMMAXCHIPS) || (which >= SIMCNT_COUNT)){
+        return 0;
+    }
+    return Chips[chip].Counters[which];
+}
+
+/*------------------------Private Functions-----------------------------*/
+
+/*******************************************************************************
+* Function Name: RegAt
+********************************************************************************
+* Summary:
+*   Finds a control register in the bank selected by ECON1.
+*
+* Parameters:
+*   c - the chip.
+*   addr - its 5 bit address.
+*
+* Returns:
+*   Where it is kept.
+*******************************************************************************/
+static uint8_t* RegAt(ENCSIM* c, uint8_t addr){
+    addr &= 0x1f;
+    if (addr >= EIE){
+        return &c->Reg[0][addr];
+    }
+    return &c->Reg[c->Reg[0][ECON1] & ECON1_BSEL][addr];
+}
+
+/*******************************************************************************
+* Function Name: Get16
+********************************************************************************
+* Summary:
+*   Reads a register pair,low byte first.
+*
+* Parameters:
+*   c - the chip.
+*   bank - the bank it is in.
+*   addr - address of the low byte.
+*
+* Returns:
+*   Its value.
+*******************************************************************************/
+static uint16_t Get16(ENCSIM* c, uint8_t bank, uint8_t addr){
+    return (uint16_t)(c->Reg[bank][addr] | (c->Reg[bank][addr + 1] << 8));
+}
+
+/*******************************************************************************
+* Function Name: Put16
+********************************************************************************
+* Summary:
+*   Writes a register pair,low byte first.
+*
+* Parameters:
+*   c - the chip.
+*   bank - the bank it is in.
+*   addr - address of the low byte.
+*   value - what to write.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Put16(ENCSIM* c, uint8_t bank, uint8_t addr, uint16_t value){
+    c->Reg[bank][addr] = (uint8_t)value;
+    c->Reg[bank][addr + 1] = (uint8_t)(value >> 8);
+}
+
+/*******************************************************************************
+* Function Name: IsMacMii
+********************************************************************************
+* Summary:
+*   Tells the MAC and MII registers apart from the ETH registers,in the bank
+*   selected.See TABLE 3-1 on Page 13.
+*
+* Parameters:
+*   c - the chip.
+*   addr - the register address.
+*
+* Returns:
+*   1 for a MAC or MII register,else 0.
+*******************************************************************************/
+static uint8_t IsMacMii(ENCSIM* c, uint8_t addr){
+    uint8_t bank = c->Reg[0][ECON1] & ECON1_BSEL;
+
+    if (addr >= EIE){
+        return 0;
+    }
+    if (bank == 2){
+        return addr <= MIRDH;
+    }
+    if (bank == 3){
+        return (addr <= MAADR2) || (addr == MISTAT);
+    }
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: ReadReg
+********************************************************************************
+* Summary:
+*   Reads a control register in the bank selected.
+*
+* Parameters:
+*   c - the chip.
+*   addr - the register address.
+*
+* Returns:
+*   Its value.
+*******************************************************************************/
+static uint8_t ReadReg(ENCSIM* c, uint8_t addr){
+    return *RegAt(c, addr);
+}
+
+/*******************************************************************************
+* Function Name: WriteReg
+********************************************************************************
+* Summary:
+*   Writes a control register in the bank selected,with whatever the chip
+*   does when it is written.Read only registers and bits are left alone.
+*
+* Parameters:
+*   c - the chip.
+*   addr - the register address.
+*   value - the new value.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void WriteReg(ENCSIM* c, uint8_t addr, uint8_t value){
+    uint8_t bank = c->Reg[0][ECON1] & ECON1_BSEL;
+    uint8_t* reg = RegAt(c, addr);
+    uint8_t old = *reg;
+
+    addr &= 0x1f;
+    switch (addr){
+    case EIR:
+        /*PKTIF follows EPKTCNT,and LINKIF follows PHIR.*/
+        *reg = (value & ~(EIR_PKTIF | EIR_LINKIF)) | (old & (EIR_PKTIF | EIR_LINKIF));
+        UpdateInt(c);
+        return;
+    case ESTAT:
+        /*Only TXABRT and LATECOL can be cleared.*/
+        *reg = old & (value | ~(ESTAT_TXABRT | ESTAT_LATECOL));
+        return;
+    case ECON2:
+        if (value & ECON2_PKTDEC){
+            if (c->Reg[1][EPKTCNT]){
+                c->Reg[1][EPKTCNT]--;
+            }
+            if (c->Reg[1][EPKTCNT] == 0){
+                c->Reg[0][EIR] &= ~EIR_PKTIF;
+            }
+        }
+        *reg = value & ~ECON2_PKTDEC;
+        UpdateInt(c);
+        return;
+    case ECON1:
+        *reg = value;
+        /*RXRST only holds the receive logic in reset,so nothing is taken
+        in while it is set(see Receive).ERXWRPT,EPKTCNT and PKTIF are
+        left as they are;it takes a write to ERXST to move ERXWRPT.*/
+        if (value & ECON1_TXRST){
+            c->TxBusy = 0;
+            *reg &= ~ECON1_TXRTS;
+        }else if ((value & ECON1_TXRTS) && !(old & ECON1_TXRTS)){
+            StartTx(c);
+        }else if (!(value & ECON1_TXRTS) && c->TxBusy){
+            /*Cleared while the frame is going out,so it is aborted.*/
+            c->TxBusy = 0;
+        }
+        if ((value & ECON1_DMAST) && !(old & ECON1_DMAST)){
+            RunDma(c);
+        }
+        UpdateInt(c);
+        return;
+    case EIE:
+        *reg = value;
+        UpdateInt(c);
+        return;
+    default:
+        break;
+    }
+
+    switch (bank){
+    case 0:
+        if ((addr == ERXWRPTL) || (addr == ERXWRPTL + 1)){
+            return;//Read only.
+        }
+        *reg = value;
+        if ((addr == ERXSTL) || (addr == ERXSTL + 1)){
+            /*ERXWRPT follows ERXST.See Section 6.1 on Page 33.*/
+            Put16(c, 0, ERXWRPTL, Get16(c, 0, ERXSTL));
+        }
+        return;
+    case 1:
+        if (addr == EPKTCNT){
+            return;//Only PKTDEC moves it.
+        }
+        break;
+    case 2:
+        if ((addr == MIRDL) || (addr == MIRDH)){
+            return;
+        }
+        *reg = value;
+        if (addr == MICMD){
+            if (value & MICMD_MIISCAN){
+                if (!(old & MICMD_MIISCAN)){
+                    c->Reg[3][MISTAT] |= MISTAT_SCAN | MISTAT_NVALID | MISTAT_BUSY;
+                    c->MiiBusy = 1;
+                    c->MiiDoneAt = Now + MIINS;
+                    Schedule(c->MiiDoneAt);
+                }
+            }else if (old & MICMD_MIISCAN){
+                /*The read under way finishes,then scanning stops.*/
+                c->Reg[3][MISTAT] &= ~MISTAT_SCAN;
+            }
+            if ((value & MICMD_MIIRD) && !(old & MICMD_MIIRD)){
+                c->Reg[3][MISTAT] |= MISTAT_BUSY;
+                c->MiiBusy = 1;
+                c->MiiDoneAt = Now + MIINS;
+                Schedule(c->MiiDoneAt);
+            }
+        }else if (addr == MIWRH){
+            /*Writing MIWRH starts the write.See Section 3.3.2 on Page 21.*/
+            WritePhy(c, c->Reg[2][MIREGADR], Get16(c, 2, MIWRL));
+            c->Reg[3][MISTAT] |= MISTAT_BUSY;
+            c->MiiBusy = 1;
+            c->MiiDoneAt = Now + MIINS;
+            Schedule(c->MiiDoneAt);
+        }
+        return;
+    case 3:
+        if ((addr == MISTAT) || (addr == EREVID)){
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+    *reg = value;
+}
+
+/*******************************************************************************
+* Function Name: ReadPhy
+********************************************************************************
+* Summary:
+*   Reads a PHY register,as the MII interface does.
+*
+* Parameters:
+*   c - the chip.
+*   addr - the PHY register address.
+*
+* Returns:
+*   Its value,0 for one that is not there.
+*******************************************************************************/
+static uint16_t ReadPhy(ENCSIM* c, uint8_t addr){
+    uint16_t value;
+
+    if (addr >= PHYREGS){
+        return 0;
+    }
+    value = c->Phy[addr];
+    if (addr == PHIR){
+        /*Reading PHIR clears the flags,and so LINKIF.*/
+        c->Phy[PHIR] &= ~(PHIR_PGIF | PHIR_PLNKIF);
+        c->Reg[0][EIR] &= ~EIR_LINKIF;
+        UpdateInt(c);
+    }else if ((addr == PHSTAT1) && c->LinkUp){
+        c->Phy[PHSTAT1] |= PHSTAT1_LLSTAT;
+    }
+    return value;
+}
+
+/*******************************************************************************
+* Function Name: WritePhy
+********************************************************************************
+* Summary:
+*   Writes a PHY register,as the MII interface does.
+*
+* Parameters:
+*   c - the chip.
+*   addr - the PHY register address.
+*   value - the new value.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void WritePhy(ENCSIM* c, uint8_t addr, uint16_t value){
+    switch (addr){
+    case PHCON1:
+        if (value & PHCON1_PRST){
+            ResetPhy(c);
+            return;
+        }
+        c->Phy[PHCON1] = value;
+        if (value & PHCON1_PDPXMD){
+            c->Phy[PHSTAT2] |= PHSTAT2_DPXSTAT;
+        }else{
+            c->Phy[PHSTAT2] &= ~PHSTAT2_DPXSTAT;
+        }
+        return;
+    case PHCON2:
+    case PHIE:
+    case PHLCON:
+        c->Phy[addr] = value;
+        return;
+    default:
+        return;//The rest are read only.
+    }
+}
+
+/*******************************************************************************
+* Function Name: Reset
+********************************************************************************
+* Summary:
+*   Puts the control registers back to their reset values,as the System
+*   Reset Command does.The buffer and the PHY are left alone.
+*   See TABLE 3-2 on Page 14.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Reset(ENCSIM* c){
+    memset(c->Reg, 0, sizeof(c->Reg));
+    Put16(c, 0, ERDPTL, 0x05FA);
+    Put16(c, 0, ERXSTL, 0x05FA);
+    Put16(c, 0, ERXNDL, 0x1FFF);
+    Put16(c, 0, ERXRDPTL, 0x05FA);
+    c->Reg[0][ESTAT] = ESTAT_CLKRDY;//Not cleared by the reset,see No.2 in the errata.
+    c->Reg[0][ECON2] = ECON2_AUTOINC;
+    c->Reg[1][ERXFCON] = ERXFCON_UCEN | ERXFCON_CRCEN | ERXFCON_BCEN;
+    c->Reg[2][0x08] = 0x0F;//MACLCON1
+    c->Reg[2][0x09] = 0x37;//MACLCON2
+    Put16(c, 2, MAMXFLL, 0x0600);
+    c->Reg[3][EREVID] = SIMREVID;
+    c->Reg[3][0x15] = 0x04;//ECOCON
+    Put16(c, 3, 0x18, 0x1000);//EPAUS
+    c->MiiBusy = 0;
+    c->TxBusy = 0;
+    UpdateInt(c);
+}
+
+/*******************************************************************************
+* Function Name: ResetPhy
+********************************************************************************
+* Summary:
+*   Puts the PHY registers back to their reset values.See TABLE 3-3 on Page 22.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void ResetPhy(ENCSIM* c){
+    memset(c->Phy, 0, sizeof(c->Phy));
+    c->Phy[PHSTAT1] = PHSTAT1_PFDPX | PHSTAT1_PHDPX;
+    c->Phy[PHID1] = 0x0083;
+    c->Phy[PHID2] = 0x1400;
+    c->Phy[PHSTAT2] = c->LinkUp ? PHSTAT2_LSTAT : 0;
+    c->Phy[PHLCON] = 0x3422;
+    c->Reg[0][EIR] &= ~EIR_LINKIF;
+}
+
+/*******************************************************************************
+* Function Name: Update
+********************************************************************************
+* Summary:
+*   Finishes whatever was due by now,the MII operation and the frame
+*   going out.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Update(ENCSIM* c){
+    uint16_t value;
+
+    while (c->MiiBusy && (Now >= c->MiiDoneAt)){
+        if (c->Reg[3][MISTAT] & MISTAT_SCAN){
+            /*MIRD is kept up to date,every 10.24us.*/
+            value = ReadPhy(c, c->Reg[2][MIREGADR]);
+            Put16(c, 2, MIRDL, value);
+            c->Reg[3][MISTAT] &= ~MISTAT_NVALID;
+            c->MiiDoneAt += MIINS;
+            if (Now >= c->MiiDoneAt){
+                c->MiiDoneAt = Now + MIINS;//Skip the ones nobody saw.
+            }
+        }else{
+            if (c->Reg[2][MICMD] & MICMD_MIIRD){
+                Put16(c, 2, MIRDL, ReadPhy(c, c->Reg[2][MIREGADR]));
+            }
+            c->Reg[3][MISTAT] &= ~(MISTAT_BUSY | MISTAT_NVALID);
+            c->MiiBusy = 0;
+        }
+    }
+    if (c->TxBusy && (Now >= c->TxDoneAt)){
+        FinishTx(c);
+    }
+    if (c->MiiBusy){
+        Schedule(c->MiiDoneAt);
+    }
+    if (c->TxBusy){
+        Schedule(c->TxDoneAt);
+    }
+}
+
+/*******************************************************************************
+* Function Name: UpdateInt
+********************************************************************************
+* Summary:
+*   Works out the INT pin,and calls the ISR hooked to it on a falling edge.
+*   See Section 12.0 on Page 71.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void UpdateInt(ENCSIM* c){
+    uint8_t pin;
+    uint8_t eie = c->Reg[0][EIE];
+
+    pin = !((eie & EIE_INTIE) && (eie & c->Reg[0][EIR] & 0x7b));
+    if (pin){
+        c->Reg[0][ESTAT] &= ~ESTAT_INT;
+    }else{
+        c->Reg[0][ESTAT] |= ESTAT_INT;
+    }
+    if (c->IntPin && !pin){
+        c->IntPin = pin;
+        if (c->Isr){
+            c->Isr();
+        }
+    }
+    c->IntPin = pin;
+}
+
+/*******************************************************************************
+* Function Name: StartTx
+********************************************************************************
+* Summary:
+*   Takes the packet between ETXST and ETXND,as ECON1.TXRTS is set,and works
+*   out the frame that goes on the wire.It is done once the frame has had
+*   time to go out.See Section 7.1 on Page 39.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void StartTx(ENCSIM* c){
+    uint16_t start = Get16(c, 0, ETXSTL) & SRAMMASK;
+    uint16_t end = Get16(c, 0, ETXNDL) & SRAMMASK;
+    uint8_t ctrl;
+    uint8_t macon3 = c->Reg[2][MACON3];
+    uint8_t pad = 0;
+    uint8_t crc;
+    uint8_t huge;
+    uint16_t len;
+    uint16_t i;
+    uint16_t maxLen = Get16(c, 2, MAMXFLL);
+    uint8_t status[7];
+
+    ctrl = c->Sram[start];
+    len = (uint16_t)((end - start) & SRAMMASK);
+    if (len > SRAMSIZE - MINFRAMELEN){
+        len = SRAMSIZE - MINFRAMELEN;//Leaves room for the padding and CRC.
+    }
+    c->TxAbort = 0;
+    for (i = 0; i < len; i++){
+        c->TxFrame[i] = c->Sram[(start + 1 + i) & SRAMMASK];
+    }
+
+    if (ctrl & TXCTRL_POVERRIDE){
+        crc = (ctrl & (TXCTRL_PCRCEN | TXCTRL_PPADEN)) != 0;
+        pad = (ctrl & TXCTRL_PPADEN) ? 60 : 0;
+        huge = (ctrl & TXCTRL_PHUGEEN) != 0;
+    }else{
+        /*See REGISTER 6-2 on Page 36.*/
+        switch (macon3 & MACON3_PADCFG){
+        case 0x00:
+        case 0x40:
+            pad = 0;
+            break;
+        case 0x60:
+            pad = 64 - FCSLEN;
+            break;
+        default:
+            pad = 60;
+            break;
+        }
+        crc = (pad != 0) || (macon3 & MACON3_TXCRCEN);
+        huge = (macon3 & MACON3_HFRMEN) != 0;
+    }
+    while (len < pad){
+        c->TxFrame[len++] = 0;
+    }
+    if (crc){
+        len = SimAddFcs(c->TxFrame, len);
+    }
+    c->TxLen = len;
+
+    /*The status vector goes right after the packet.
+    See TABLE 7-1 on Page 43.*/
+    memset(status, 0, sizeof(status));
+    status[0] = (uint8_t)len;
+    status[1] = (uint8_t)(len >> 8);
+    if ((len > maxLen) && !huge){
+        status[3] |= 0x40;//Giant
+        c->TxAbort = 1;
+    }else{
+        status[2] |= 0x80;//Done
+    }
+    if (len >= ETHHDRLEN){
+        if (memcmp(c->TxFrame, "\xff\xff\xff\xff\xff\xff", 6) == 0){
+            status[3] |= 0x02;
+        }else if (c->TxFrame[0] & 1){
+            status[3] |= 0x01;
+        }
+        if ((c->TxFrame[12] == 0x88) && (c->TxFrame[13] == 0x08)){
+            status[6] |= 0x01;
+        }else if ((c->TxFrame[12] == 0x81) && (c->TxFrame[13] == 0x00)){
+            status[6] |= 0x08;
+        }
+    }
+    status[4] = status[0];
+    status[5] = status[1];
+    for (i = 0; i < sizeof(status); i++){
+        c->Sram[(end + 1 + i) & SRAMMASK] = status[i];
+    }
+
+    c->TxBusy = 1;
+    c->TxDoneAt = Now + (uint64_t)(PREAMBLELEN + len + IPGLEN) * WIREBYTENS;
+    Schedule(c->TxDoneAt);
+}
+
+/*******************************************************************************
+* Function Name: FinishTx
+********************************************************************************
+* Summary:
+*   Ends the transmission started by StartTx.TXRTS clears,TXIF(or TXERIF
+*   for an abort) is set,and the frame goes on the wire,or back in through
+*   the PHY loopback.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void FinishTx(ENCSIM* c){
+    uint8_t chip = (uint8_t)(c - Chips);
+    uint8_t loop;
+
+    c->TxBusy = 0;
+    c->Reg[0][ECON1] &= ~ECON1_TXRTS;
+    if (c->TxAbort){
+        c->Reg[0][ESTAT] |= ESTAT_TXABRT;
+        c->Reg[0][EIR] |= EIR_TXERIF;
+        UpdateInt(c);
+        return;
+    }
+    c->Reg[0][EIR] |= EIR_TXIF;
+    c->Counters[SIMCNT_TXFRAMES]++;
+    UpdateInt(c);
+
+    /*In half duplex the PHY loops frames back,unless HDLDIS is set.
+    See Section 6.6 on Page 40.*/
+    loop = (c->Phy[PHCON1] & PHCON1_PLOOPBK) != 0;
+    if (loop || (!FullDuplex(c) && !(c->Phy[PHCON2] & PHCON2_HDLDIS))){
+        Receive(c, c->TxFrame, c->TxLen);
+    }
+    if (!loop && c->LinkUp && c->Wire){
+        c->Wire(chip, c->TxFrame, c->TxLen);
+    }
+}
+
+/*******************************************************************************
+* Function Name: RunDma
+********************************************************************************
+* Summary:
+*   Runs the DMA engine as ECON1.DMAST is set,copying EDMAST-EDMAND to EDMADST,
+*   or with CSUMEN,working out the IP checksum of it into EDMACS.
+*   Reads wrap from ERXND to ERXST.It is done straight away.
+*   See Section 13.0 on Page 75 and Section 14.0 on Page 77.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void RunDma(ENCSIM* c){
+    uint16_t src = Get16(c, 0, EDMASTL) & SRAMMASK;
+    uint16_t last = Get16(c, 0, EDMANDL) & SRAMMASK;
+    uint16_t dst = Get16(c, 0, EDMADSTL) & SRAMMASK;
+    uint8_t csum = (c->Reg[0][ECON1] & ECON1_CSUMEN) != 0;
+    uint32_t sum = 0;
+    uint8_t hiByte = 1;
+    uint8_t data;
+    uint16_t count;
+
+    for (count = 0; count < SRAMSIZE; count++){
+        data = c->Sram[src];
+        if (csum){
+            sum += hiByte ? ((uint32_t)data << 8) : data;
+            hiByte = !hiByte;
+        }else{
+            c->Sram[dst] = data;
+            dst = (dst + 1) & SRAMMASK;
+        }
+        if (src == last){
+            break;
+        }
+        src = RxNext(c, src);
+    }
+    if (csum){
+        while (sum >> 16){
+            sum = (sum & 0xffff) + (sum >> 16);
+        }
+        sum ^= 0xffff;
+        Put16(c, 0, EDMACSL, (uint16_t)sum);
+    }
+    c->Counters[SIMCNT_DMAOPS]++;
+    c->Reg[0][ECON1] &= ~ECON1_DMAST;
+    c->Reg[0][EIR] |= EIR_DMAIF;
+}
+
+/*******************************************************************************
+* Function Name: Receive
+********************************************************************************
+* Summary:
+*   Takes a frame off the wire,and if the filters let it through and there
+*   is room,writes it into the RX ring behind its next packet pointer and
+*   status vector.See Section 7.2 on Page 43.
+*
+* Parameters:
+*   c - the chip.
+*   frame - the frame,FCS included.
+*   len - its length.
+*
+* Returns:
+*   SIMRX_OK if it was taken,else why not.
+*******************************************************************************/
+static uint8_t Receive(ENCSIM* c, const uint8_t* frame, uint16_t len){
+    uint8_t crcOk;
+    uint16_t typeLen;
+    uint16_t ptr;
+    uint16_t next;
+    uint16_t i;
+    uint8_t status[6];
+    uint8_t macon3 = c->Reg[2][MACON3];
+
+    if (!(c->Reg[0][ECON1] & ECON1_RXEN) || (c->Reg[0][ECON1] & ECON1_RXRST) ||
+        !(c->Reg[2][MACON1] & MACON1_MARXEN)){
+        return SIMRX_OFF;
+    }
+    if (len < ETHHDRLEN + FCSLEN){
+        return SIMRX_RUNT;
+    }
+    crcOk = (Crc32(frame, len - FCSLEN) == (uint32_t)(frame[len - 4] | (frame[len - 3] << 8) |
+             (frame[len - 2] << 16) | ((uint32_t)frame[len - 1] << 24)));
+    if (!Filter(c, frame, len, crcOk) ||
+        ((len > Get16(c, 2, MAMXFLL)) && !(macon3 & MACON3_HFRMEN))){
+        c->Counters[SIMCNT_RXFILTERED]++;
+        return SIMRX_FILTERED;
+    }
+    if ((c->Reg[1][EPKTCNT] == 0xff) || (RxFree(c) < (uint16_t)(6 + len + 1))){
+        c->Reg[0][EIR] |= EIR_RXERIF;
+        c->Counters[SIMCNT_RXDROPPED]++;
+        UpdateInt(c);
+        return SIMRX_NOROOM;
+    }
+
+    /*Status vector,see TABLE 7-3 on Page 46.*/
+    memset(status, 0, sizeof(status));
+    status[2] = (uint8_t)len;
+    status[3] = (uint8_t)(len >> 8);
+    typeLen = (uint16_t)((frame[12] << 8) | frame[13]);
+    if (!crcOk){
+        status[4] |= 0x10;
+    }
+    if (typeLen > 1500){
+        status[4] |= 0x40;//Length out of range,as for any type field.
+    }else if ((macon3 & MACON3_FRMLNEN) && (typeLen != len - ETHHDRLEN - FCSLEN) &&
+              !((typeLen < 46) && (len == MINFRAMELEN))){
+        status[4] |= 0x20;
+    }
+    if (crcOk && !(status[4] & 0x20)){
+        status[4] |= 0x80;//Received Ok
+    }
+    if (memcmp(frame, "\xff\xff\xff\xff\xff\xff", 6) == 0){
+        status[5] |= 0x02;
+    }else if (frame[0] & 1){
+        status[5] |= 0x01;
+    }
+    if (typeLen == 0x8808){
+        status[5] |= 0x08;
+        status[5] |= ((frame[14] == 0x00) && (frame[15] == 0x01)) ? 0x10 : 0x20;
+    }else if (typeLen == 0x8100){
+        status[5] |= 0x40;
+    }
+
+    /*Write it in,then the next packet pointer,padded to an even address.*/
+    ptr = Get16(c, 0, ERXWRPTL);
+    next = ptr;
+    for (i = 0; i < 6 + len; i++){
+        next = RxNext(c, next);
+    }
+    if (next & 1){
+        next = RxNext(c, next);
+    }
+    status[0] = (uint8_t)next;
+    status[1] = (uint8_t)(next >> 8);
+    for (i = 0; i < 6; i++){
+        c->Sram[ptr] = status[i];
+        ptr = RxNext(c, ptr);
+    }
+    for (i = 0; i < len; i++){
+        c->Sram[ptr] = frame[i];
+        ptr = RxNext(c, ptr);
+    }
+    Put16(c, 0, ERXWRPTL, next);
+    c->Reg[1][EPKTCNT]++;
+    c->Reg[0][EIR] |= EIR_PKTIF;
+    c->Counters[SIMCNT_RXFRAMES]++;
+    UpdateInt(c);
+    return SIMRX_OK;
+}
+
+/*******************************************************************************
+* Function Name: Filter
+********************************************************************************
+* Summary:
+*   Runs a frame past the receive filters set in ERXFCON.With ANDOR clear,
+*   any filter that is on can let it in,with it set all of them have to.
+*   With none on,everything gets in.See Section 8.0 on Page 49.
+*
+* Parameters:
+*   c - the chip.
+*   frame - the frame,FCS included.
+*   len - its length.
+*   crcOk - 1 if the FCS is right.
+*
+* Returns:
+*   1 if it gets in,else 0.
+*******************************************************************************/
+static uint8_t Filter(ENCSIM* c, const uint8_t* frame, uint16_t len, uint8_t crcOk){
+    uint8_t fcon = c->Reg[1][ERXFCON];
+    uint8_t pass = 0;
+    uint8_t fail = 0;
+    uint8_t match;
+    uint8_t mac[6];
+    uint8_t i;
+    uint8_t bit;
+    uint8_t data;
+    uint8_t hiByte = 1;
+    uint16_t offset;
+    uint32_t sum = 0;
+    uint32_t crc;
+
+    if ((fcon & ERXFCON_CRCEN) && !crcOk){
+        return 0;
+    }
+    if (!(fcon & ERXFCON_FILTERS)){
+        return 1;
+    }
+
+    if (fcon & ERXFCON_UCEN){
+        mac[0] = c->Reg[3][MAADR1];
+        mac[1] = c->Reg[3][MAADR2];
+        mac[2] = c->Reg[3][MAADR3];
+        mac[3] = c->Reg[3][MAADR4];
+        mac[4] = c->Reg[3][MAADR5];
+        mac[5] = c->Reg[3][MAADR6];
+        match = (memcmp(frame, mac, 6) == 0);
+        pass |= match;
+        fail |= !match;
+    }
+    if (fcon & ERXFCON_BCEN){
+        match = (memcmp(frame, "\xff\xff\xff\xff\xff\xff", 6) == 0);
+        pass |= match;
+        fail |= !match;
+    }
+    if (fcon & ERXFCON_MCEN){
+        match = frame[0] & 1;
+        pass |= match;
+        fail |= !match;
+    }
+    if (fcon & ERXFCON_HTEN){
+        /*Bits 28:23 of the CRC of the destination address pick a bit of EHT.
+        See Section 8.4 on Page 51.*/
+        crc = 0xFFFFFFFFUL;
+        for (i = 0; i < 6; i++){
+            data = frame[i];
+            for (bit = 0; bit < 8; bit++){
+                if (((crc >> 31) ^ data) & 1){
+                    crc = (crc << 1) ^ 0x04C11DB7UL;
+                }else{
+                    crc <<= 1;
+                }
+                data >>= 1;
+            }
+        }
+        i = (uint8_t)((crc >> 23) & 0x3f);
+        match = (c->Reg[1][EHT0 + (i >> 3)] >> (i & 7)) & 1;
+        pass |= match;
+        fail |= !match;
+    }
+    if (fcon & ERXFCON_PMEN){
+        /*The masked bytes of the 64 byte window at EPMO,summed like an IP
+        checksum,have to give EPMCS.*/
+        offset = Get16(c, 1, EPMOL);
+        match = 0;
+        if ((uint32_t)offset + 64 <= len){
+            for (i = 0; i < 64; i++){
+                if (c->Reg[1][EPMM0 + (i >> 3)] & (1 << (i & 7))){
+                    sum += hiByte ? ((uint32_t)frame[offset + i] << 8) : frame[offset + i];
+                    hiByte = !hiByte;
+                }
+            }
+            while (sum >> 16){
+                sum = (sum & 0xffff) + (sum >> 16);
+            }
+            match = ((sum ^ 0xffff) == Get16(c, 1, EPMCSL));
+        }
+        pass |= match;
+        fail |= !match;
+    }
+    if (fcon & ERXFCON_MPEN){
+        fail = 1;//Magic packets are not modelled.
+    }
+
+    return (fcon & ERXFCON_ANDOR) ? !fail : pass;
+}
+
+/*******************************************************************************
+* Function Name: RxFree
+********************************************************************************
+* Summary:
+*   Works out the room left in the RX ring,between ERXWRPT and ERXRDPT.
+*   See EQUATION 7-2 on Page 47.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   Free bytes.
+*******************************************************************************/
+static uint16_t RxFree(ENCSIM* c){
+    uint16_t start = Get16(c, 0, ERXSTL);
+    uint16_t end = Get16(c, 0, ERXNDL);
+    uint16_t wr = Get16(c, 0, ERXWRPTL);
+    uint16_t rd = Get16(c, 0, ERXRDPTL);
+
+    if (wr > rd){
+        return (uint16_t)((end - start) - (wr - rd));
+    }
+    if (wr == rd){
+        return (uint16_t)(end - start);
+    }
+    return (uint16_t)(rd - wr - 1);
+}
+
+/*******************************************************************************
+* Function Name: RxNext
+********************************************************************************
+* Summary:
+*   Steps an address along the buffer,wrapping from ERXND to ERXST.
+*
+* Parameters:
+*   c - the chip.
+*   addr - the address.
+*
+* Returns:
+*   The one after it.
+*******************************************************************************/
+static uint16_t RxNext(ENCSIM* c, uint16_t addr){
+    if (addr == Get16(c, 0, ERXNDL)){
+        return Get16(c, 0, ERXSTL);
+    }
+    return (addr + 1) & SRAMMASK;
+}
+
+/*******************************************************************************
+* Function Name: FullDuplex
+********************************************************************************
+* Summary:
+*   Tells if the PHY is in full duplex.MACON3.FULDPX has to match it.
+*
+* Parameters:
+*   c - the chip.
+*
+* Returns:
+*   1 for full duplex,0 for half.
+*******************************************************************************/
+static uint8_t FullDuplex(ENCSIM* c){
+    return (c->Phy[PHCON1] & PHCON1_PDPXMD) != 0;
+}
+
+/*******************************************************************************
+* Function Name: Schedule
+********************************************************************************
+* Summary:
+*   Makes sure SimAdvance looks at the chips again by a given time.
+*
+* Parameters:
+*   at - when something is due.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Schedule(uint64_t at){
+    if (at < NextEvent){
+        NextEvent = at;
+    }
+}
+
+/*******************************************************************************
+* Function Name: AnySelected
+********************************************************************************
+* Summary:
+*   Finds out if an SPI transaction is under way,with any chip.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   1 if a chip is selected,0 if none is.
+*******************************************************************************/
+static uint8_t AnySelected(void){
+    uint8_t i;
+
+    for (i = 0; i < SIMMAXCHIPS; i++){
+        if (Chips[i].Selected){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*******************************************************************************
+* Function Name: Crc32
+********************************************************************************
+* Summary:
+*   Works out the Ethernet CRC of some bytes.
+*
+* Parameters:
+*   data - the bytes.
+*   len - how many.
+*
+* Returns:
+*   The CRC,least significant byte first on the wire.
+*******************************************************************************/
+static uint32_t Crc32(const uint8_t* data, uint16_t len){
+    uint32_t crc = 0xFFFFFFFFUL;
+
+    while (len--){
+        crc = CrcTable[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/*******************************************************************************
+* Function Name: InetAdd
+********************************************************************************
+* Summary:
+*   Adds some bytes into an Internet checksum,as 16 bit big endian words,
+*   the last one padded with a zero if the count is odd.
+*
+* Parameters:
+*   sum - the sum so far,as returned by the last call,or 0.
+*   data - the bytes.
+*   len - how many.
+*
+* Returns:
+*   The ones complement sum,folded to 16 bits.0xffff if the bytes held a
+*   right checksum.
+*******************************************************************************/
+static uint32_t InetAdd(uint32_t sum, const uint8_t* data, uint16_t len){
+    uint16_t i;
+
+    for (i = 0; i + 1 < len; i += 2){
+        sum += (uint32_t)((data[i] << 8) | data[i + 1]);
+    }
+    if (len & 1){
+        sum += (uint32_t)data[len - 1] << 8;
+    }
+    while (sum >> 16){
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return sum;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,328 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : ENC28J60 behavioural model
+ Description : A model of the ENC28J60 as seen over SPI,for running the
+ unchanged driver and stack on a workstation.See "readme.txt" in this folder.
+
+ Modelled:
+ -The four control register banks,with BFS/BFC on the ETH registers,and the
+  dummy byte on reads of the MAC and MII registers.
+ -The 8kb buffer,with ERDPT and EWRPT auto incrementing,ERDPT wrapping at
+  ERXND,and RBM/WBM.
+ -The RX ring:ERXST/ERXND/ERXRDPT/ERXWRPT,the status vector and next packet
+  pointer in front of each packet,EPKTCNT,ECON2.PKTDEC,overflow into
+  EIR.RXERIF,and the ERXFCON filters(unicast,broadcast,multicast,hash table
+  and pattern match).
+ -Transmission from ETXST/ETXND with the per packet control byte,padding,the
+  CRC,the 7 byte status vector after the packet,TXIF/TXERIF,and the time the
+  frame takes on a 10Mbps wire.
+ -The DMA engine,copying and working out checksums,wrapping in the RX ring.
+ -The MII interface(MIIRD,MIIWR,MIISCAN with MISTAT.BUSY/NVALID taking
+  10.24us) and the PHY registers,with link changes through PHIR and LINKIF,
+  and PHCON1.PLOOPBK.
+ -EIE/EIR and the INT pin.
+ Not modelled:collisions,PAUSE frames and EFLOCON,magic packets,power save,
+ the BIST,and anything that needs a real cable.
+
+ Time is virtual.It moves on with every byte clocked over SPI,and with the
+ CyDelay calls,so runs are the same every time,and as fast as the host.
+*/
+#ifndef ENCSIM_H
+#define ENCSIM_H
+#include <stdint.h>
+
+/*Chips on the bus,each with its own chip select.*/
+#define SIMMAXCHIPS     4
+
+/*Default SPI clock,as the SPIM is set up on the TopDesign.*/
+#define SIMSPIHZ        8000000UL
+
+/*Returned by SimDeliver.*/
+#define SIMRX_OK        0//Written into the RX ring.
+#define SIMRX_OFF       1//Reception is off(ECON1.RXEN,MACON1.MARXEN or RXRST).
+#define SIMRX_FILTERED  2//Turned away by ERXFCON.
+#define SIMRX_NOROOM    3//No room in the ring,or EPKTCNT at 255.
+#define SIMRX_RUNT      4//Too short to be a frame.
+
+/*Counters kept for each chip,see SimCounter.*/
+#define SIMCNT_SPIBYTES     0//Bytes clocked over SPI,opcodes included.
+#define SIMCNT_SPIOPS       1//SPI transactions,chip select low to high.
+#define SIMCNT_TXFRAMES     2//Frames put on the wire.
+#define SIMCNT_RXFRAMES     3//Frames written into the RX ring.
+#define SIMCNT_RXFILTERED   4//Frames turned away by the filters.
+#define SIMCNT_RXDROPPED    5//Frames lost for want of room.
+#define SIMCNT_DMAOPS       6//DMA copies and checksums.
+#define SIMCNT_COUNT        7
+
+/*Called with each frame a chip puts on the wire,FCS included.*/
+typedef void (*SIMWIRE)(uint8_t chip, const uint8_t* frame, uint16_t len);
+
+/*Called on the falling edge of the INT pin of a chip.*/
+typedef void (*SIMISR)(void);
+
+/*Called when a timer set with SimSetTimer goes off.*/
+typedef void (*SIMTIMER)(void);
+
+/*******************************************************************************
+* Function Name: SimInit
+********************************************************************************
+* Summary:
+*   Powers up all the chips,with their link up,and sets the time back to 0.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimInit(void);
+
+/*******************************************************************************
+* Function Name: SimNow
+********************************************************************************
+* Summary:
+*   Gets the virtual time.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nanoseconds since SimInit.
+*******************************************************************************/
+uint64_t SimNow(void);
+
+/*******************************************************************************
+* Function Name: SimAdvance
+********************************************************************************
+* Summary:
+*   Moves the virtual time on,and lets the chips finish whatever was due by
+*   then:frames going out,MII operations,and so on.
+*
+* Parameters:
+*   ns - how far to move it,in nanoseconds.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimAdvance(uint32_t ns);
+
+/*******************************************************************************
+* Function Name: SimSetTime
+********************************************************************************
+* Summary:
+*   Sets the virtual time,backwards as well as forwards.For running more than
+*   one board,each with its own idea of the time,see "netsim.c".What the chips
+*   have due is still done in order of time.
+*
+* Parameters:
+*   ns - nanoseconds since SimInit.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSetTime(uint64_t ns);
+
+/*******************************************************************************
+* Function Name: SimSetTimer
+********************************************************************************
+* Summary:
+*   Sets a one shot timer.It goes off from SimAdvance once the virtual time
+*   gets to it,but never during an SPI transaction,so it can use the bus.
+*   One held up by a transaction goes off when CS goes high.
+*
+* Parameters:
+*   at - when,in nanoseconds since SimInit.
+*   timer - called when it goes off,or 0 to stop it.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSetTimer(uint64_t at, SIMTIMER timer);
+
+/*******************************************************************************
+* Function Name: SimSettle
+********************************************************************************
+* Summary:
+*   Moves the virtual time on until no chip has a frame going out,so that
+*   everything the chips were sending has reached the wire.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSettle(void);
+
+/*******************************************************************************
+* Function Name: SimSetSpiRate
+********************************************************************************
+* Summary:
+*   Sets the SPI clock,which sets how much virtual time each byte takes.
+*
+* Parameters:
+*   hz - the SPI clock,SIMSPIHZ to start with.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSetSpiRate(uint32_t hz);
+
+/*******************************************************************************
+* Function Name: SimSelect
+********************************************************************************
+* Summary:
+*   Drives the chip select line of a chip.A transaction ends when it goes high.
+*
+* Parameters:
+*   chip - which chip,from 0.
+*   level - 0 to select it,1 to let it go.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSelect(uint8_t chip, uint8_t level);
+
+/*******************************************************************************
+* Function Name: SimSpiByte
+********************************************************************************
+* Summary:
+*   Clocks a byte over SPI,to and from the chip that is selected.
+*
+* Parameters:
+*   mosi - the byte sent.
+*
+* Returns:
+*   The byte clocked back,0xff if no chip is selected.
+*******************************************************************************/
+uint8_t SimSpiByte(uint8_t mosi);
+
+/*******************************************************************************
+* Function Name: SimIntPin
+********************************************************************************
+* Summary:
+*   Gets the level of the INT pin of a chip.
+*
+* Parameters:
+*   chip - which chip.
+*
+* Returns:
+*   0 while an enabled interrupt is flagged,1 otherwise.
+*******************************************************************************/
+uint8_t SimIntPin(uint8_t chip);
+
+/*******************************************************************************
+* Function Name: SimSetIsr
+********************************************************************************
+* Summary:
+*   Hooks a function to the falling edge of the INT pin of a chip.
+*
+* Parameters:
+*   chip - which chip.
+*   isr - the function,or 0 for none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSetIsr(uint8_t chip, SIMISR isr);
+
+/*******************************************************************************
+* Function Name: SimSetLink
+********************************************************************************
+* Summary:
+*   Plugs or unplugs the cable of a chip.The PHY flags the change in PHIR,
+*   and so in EIR.LINKIF.
+*
+* Parameters:
+*   chip - which chip.
+*   up - 1 for a link,0 for none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSetLink(uint8_t chip, uint8_t up);
+
+/*******************************************************************************
+* Function Name: SimSetWire
+********************************************************************************
+* Summary:
+*   Sets what a chip transmits into.Frames looped back by the PHY do not go
+*   on the wire.
+*
+* Parameters:
+*   chip - which chip.
+*   wire - called with each frame once it has gone out,or 0 to drop them.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void SimSetWire(uint8_t chip, SIMWIRE wire);
+
+/*******************************************************************************
+* Function Name: SimDeliver
+********************************************************************************
+* Summary:
+*   Hands a chip a frame off the wire.It goes through the filters and into
+*   the RX ring straight away.
+*
+* Parameters:
+*   chip - which chip.
+*   frame - the frame,FCS included,see SimAddFcs.
+*   len - its length.
+*
+* Returns:
+*   SIMRX_OK if it was taken,else why not.
+*******************************************************************************/
+uint8_t SimDeliver(uint8_t chip, const uint8_t* frame, uint16_t len);
+
+/*******************************************************************************
+* Function Name: SimAddFcs
+********************************************************************************
+* Summary:
+*   Appends the Ethernet CRC to a frame.
+*
+* Parameters:
+*   frame - the frame,with room for 4 more bytes.
+*   len - its length without them.
+*
+* Returns:
+*   The new length.
+*******************************************************************************/
+uint16_t SimAddFcs(uint8_t* frame, uint16_t len);
+
+/*******************************************************************************
+* Function Name: SimSumsOk
+********************************************************************************
+* Summary:
+*   Checks the IP header checksum of an IPv4 frame,and the ICMP,UDP or TCP
+*   checksum of what it carries,the way the other end of the wire would.
+*   A UDP checksum of 0 means there is none.Other frames pass as they are.
+*
+* Parameters:
+*   frame - the frame,FCS or not.
+*   len - its length.
+*
+* Returns:
+*   1 if the checksums are right,0 if one is wrong or the IP length does
+*   not fit in the frame.
+*******************************************************************************/
+uint8_t SimSumsOk(const uint8_t* frame, uint16_t len);
+
+/*******************************************************************************
+* Function Name: SimCounter
+********************************************************************************
+* Summary:
+*   Reads one of the counters kept for a chip.
+*
+* Parameters:
+*   chip - which chip.
+*   which - one of SIMCNT_.
+*
+* Returns:
+*   The count since SimInit.
+*******************************************************************************/
+uint32_t SimCounter(uint8_t chip, uint8_t which);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,265 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Host demo
+ Description : Runs the unchanged stack against the ENC28J60 model.
+ The wire is played by a router,which answers the ARP request that
+ IPstack_Start sends,and then pings the stack as fast as it answers.
+ At the end it prints how long that took,in virtual and in host time.
+
+ Usage: enchost [pings]
+*/
+#include <device.h>
+#include "IPStackMain.h"
+#include "encsim.h"
+
+/*MAC and IP address of the stack,as in "main.c".*/
+static const unsigned char myMAC[6] = {0x00,0xa0,0xc9,0x14,0xc8,0x00};
+static const unsigned char myIP[4] = {192,168,1,153};
+
+/*MAC address of the router.Its IP is routerIP,from "globals.c".*/
+static const unsigned char hostRouterMAC[6] = {0x02,0x00,0x00,0x00,0x00,0x01};
+
+/*Bytes of data in each ping.*/
+#define PINGDATALEN     32
+
+/*Calls to IPstackIdle to wait for each reply.*/
+#define PINGTRIES       100
+
+/*Echo replies seen by the router,and whether they were right.*/
+static uint32 hostReplies;
+static uint32 hostBadReplies;
+/*Frames the stack sent with a wrong IP,ICMP,UDP or TCP checksum.*/
+static uint32 hostBadSums;
+static uint16 hostPingSeq;
+
+static void RouterWire(uint8 chip, const uint8* frame, uint16 len);
+static void SendPingRequest(uint16 seq);
+static uint16 InetSum(const uint8* data, uint16 len);
+static double HostSeconds(void);
+
+/*main has to return a real int,whatever the stack thinks an int is.*/
+#undef int
+int main(int argc, char** argv){
+    unsigned long pings = 1000;
+    unsigned long i;
+    unsigned long before;
+    unsigned char tries;
+    double started;
+    double hostTime;
+    double simTime;
+    MACSTATS stats;
+#if (ENC_BENCH_ENABLED)
+    static unsigned char benchFrame[MAXFRAMELEN - 4];
+    LOOPBENCH bench;
+#endif
+
+    if (argc > 1){
+        pings = strtoul(argv[1], 0, 0);
+    }
+
+    SimInit();
+    SimSetWire(0, RouterWire);
+
+    started = HostSeconds();
+    if (IPstack_Start((unsigned char*)myMAC, (unsigned char*)myIP) != TRUE){
+        printf("IPstack_Start failed,no chip,no link or no ARP reply from the router.\n");
+        return 1;
+    }
+    printf("Up after %.3f ms,router MAC %02x:%02x:%02x:%02x:%02x:%02x\n",
+           SimNow() / 1e6, routerMAC[0], routerMAC[1], routerMAC[2],
+           routerMAC[3], routerMAC[4], routerMAC[5]);
+
+    for (i = 0; i < pings; i++){
+        before = hostReplies;
+        SendPingRequest(hostPingSeq++);
+        for (tries = 0; (tries < PINGTRIES) && (hostReplies == before); tries++){
+            IPstackIdle();
+        }
+    }
+    /*Let the last reply finish going out.*/
+    for (tries = 0; tries < PINGTRIES; tries++){
+        IPstackIdle();
+    }
+
+    hostTime = HostSeconds() - started;
+    simTime = SimNow() / 1e9;
+    MACGetStats(&ethDevice, &stats);
+    printf("Pings %lu,replies %lu,bad %lu\n", pings, (unsigned long)hostReplies,
+           (unsigned long)hostBadReplies);
+    printf("Frames sent with bad checksums %lu\n", (unsigned long)hostBadSums);
+    printf("Driver:RX %lu frames,TX %lu frames,%lu aborts\n",
+           (unsigned long)stats.RxFrames, (unsigned long)stats.TxFrames,
+           (unsigned long)stats.TxAborts);
+    printf("SPI:%lu transactions,%lu bytes\n",
+           (unsigned long)SimCounter(0, SIMCNT_SPIOPS),
+           (unsigned long)SimCounter(0, SIMCNT_SPIBYTES));
+    printf("Virtual time %.3f s,host time %.3f s,%.0fx the modelled time\n",
+           simTime, hostTime, (hostTime > 0) ? (simTime / hostTime) : 0.0);
+#if (ENC_BENCH_ENABLED)
+    if (MACLoopbackBench(&ethDevice, benchFrame, sizeof(benchFrame), 1000, &bench) == TRUE){
+        printf("Loopback:%lu frames,%lu errors,%lu frames/s,%lu bytes/s\n",
+               (unsigned long)bench.Frames, (unsigned long)bench.Errors,
+               (unsigned long)bench.FramesPerSec, (unsigned long)bench.BytesPerSec);
+    }
+#endif
+    return (hostReplies == pings) && (hostBadReplies == 0) && (hostBadSums == 0) ? 0 : 1;
+}
+
+/*******************************************************************************
+* Function Name: RouterWire
+********************************************************************************
+* Summary:
+*   Takes the frames the stack sends.ARP requests for routerIP get a reply,
+*   and echo replies are counted and checked.The checksums of every frame
+*   are checked,see SimSumsOk.
+*
+* Parameters:
+*   chip - the chip that sent it.
+*   frame - the frame,FCS included.
+*   len - its length.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void RouterWire(uint8 chip, const uint8* frame, uint16 len){
+    uint8 reply[64];
+    uint16 ipLen;
+    uint16 i;
+
+    (void)chip;
+    if (!SimSumsOk(frame, len)){
+        hostBadSums++;
+    }
+    if (len < 42 + 4){
+        return;
+    }
+    if ((frame[12] == 0x08) && (frame[13] == 0x06) && (frame[21] == 0x01) &&
+        (memcmp(&frame[38], routerIP, 4) == 0)){
+        /*ARP request for us,so answer it.*/
+        memset(reply, 0, sizeof(reply));
+        memcpy(&reply[0], &frame[6], 6);
+        memcpy(&reply[6], hostRouterMAC, 6);
+        memcpy(&reply[12], &frame[12], 8);//Type,and the ARP header.
+        reply[21] = 0x02;
+        memcpy(&reply[22], hostRouterMAC, 6);
+        memcpy(&reply[28], routerIP, 4);
+        memcpy(&reply[32], &frame[22], 10);//Sender of the request.
+        SimDeliver(0, reply, SimAddFcs(reply, 60));
+    }else if ((frame[12] == 0x08) && (frame[13] == 0x00) && (frame[23] == ICMPPROTOCOL) &&
+              (frame[34] == 0x00)){
+        /*Echo reply.Both checksums have to come out right,and the data
+        has to be what was sent.*/
+        ipLen = (uint16)((frame[16] << 8) | frame[17]);
+        hostReplies++;
+        if ((ipLen + 14 + 4 > len) || !SimSumsOk(frame, len)){
+            hostBadReplies++;
+            return;
+        }
+        for (i = 0; i < PINGDATALEN; i++){
+            if (frame[42 + i] != (uint8)('a' + i)){
+                hostBadReplies++;
+                return;
+            }
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: SendPingRequest
+********************************************************************************
+* Summary:
+*   Puts an echo request from the router to the stack on the wire.
+*
+* Parameters:
+*   seq - its sequence number.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void SendPingRequest(uint16 seq){
+    uint8 frame[14 + 20 + 8 + PINGDATALEN + 4];
+    uint16 sum;
+    uint16 i;
+
+    memset(frame, 0, sizeof(frame));
+    memcpy(&frame[0], myMAC, 6);
+    memcpy(&frame[6], hostRouterMAC, 6);
+    frame[12] = 0x08;
+    frame[13] = 0x00;
+    /*IP header.*/
+    frame[14] = 0x45;
+    frame[17] = 20 + 8 + PINGDATALEN;
+    frame[18] = (uint8)(seq >> 8);
+    frame[19] = (uint8)seq;
+    frame[22] = 64;
+    frame[23] = ICMPPROTOCOL;
+    memcpy(&frame[26], routerIP, 4);
+    memcpy(&frame[30], myIP, 4);
+    sum = InetSum(&frame[14], 20);
+    frame[24] = (uint8)(sum >> 8);
+    frame[25] = (uint8)sum;
+    /*ICMP echo request.*/
+    frame[34] = ICMPREQUEST;
+    frame[38] = 0x12;
+    frame[39] = 0x34;
+    frame[40] = (uint8)(seq >> 8);
+    frame[41] = (uint8)seq;
+    for (i = 0; i < PINGDATALEN; i++){
+        frame[42 + i] = (uint8)('a' + i);
+    }
+    sum = InetSum(&frame[34], 8 + PINGDATALEN);
+    frame[36] = (uint8)(sum >> 8);
+    frame[37] = (uint8)sum;
+    SimDeliver(0, frame, SimAddFcs(frame, sizeof(frame) - 4));
+}
+
+/*******************************************************************************
+* Function Name: InetSum
+********************************************************************************
+* Summary:
+*   Works out the Internet checksum of some bytes.
+*
+* Parameters:
+*   data - the bytes.
+*   len - how many.
+*
+* Returns:
+*   The checksum,0 if the bytes already hold a right one.
+*******************************************************************************/
+static uint16 InetSum(const uint8* data, uint16 len){
+    uint32 sum = 0;
+    uint16 i;
+
+    for (i = 0; i + 1 < len; i += 2){
+        sum += (uint32)((data[i] << 8) | data[i + 1]);
+    }
+    if (len & 1){
+        sum += (uint32)data[len - 1] << 8;
+    }
+    while (sum >> 16){
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16)(sum ^ 0xffff);
+}
+
+/*******************************************************************************
+* Function Name: HostSeconds
+********************************************************************************
+* Summary:
+*   Reads the host's monotonic clock.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Seconds,from some point in the past.
+*******************************************************************************/
+static double HostSeconds(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* [] END OF FILE */
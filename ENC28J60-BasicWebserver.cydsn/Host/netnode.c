@@ -0,0 +1,73 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Network simulator board
+ Description : The main of each board "netsim.c" runs,see NodeMain in
+ "netsim.h".It is linked with its own copy of the stack,so every board has
+ its own globals.
+ The LCD of each board is the one in this file,so that the "200 OK"
+ WebClient_ProcessReply puts on it tells the client it got the page.
+*/
+#include <device.h>
+#include "IPStackMain.h"
+#include "encsim.h"
+#include "netsim.h"
+
+/*What the clients ask for.The webserver only builds its page for "/".*/
+static const char nodeQuery[] = "GET / HTTP/1.1\r\nHost: psoc3\r\nUser-Agent: PSoC3\r\nConnection: close\r\n\r\n";
+
+/*Time the 8051 takes to go round the main loop once,in us.The model only
+counts the time spent on the bus and in CyDelay,so this stands in for the
+rest.*/
+#define NODELOOPUS      10
+
+/*Set when the reply to the query is a "200 OK".*/
+static unsigned char nodeGotPage;
+
+void NodeMain(uint8_t node, const uint8_t* mac, const uint8_t* ip, const uint8_t* server,
+              uint32_t transactions, uint32_t timeoutUs){
+    uint32_t i;
+    uint64_t started;
+    uint64_t timeout = (uint64_t)timeoutUs * 1000;
+
+#if (ENC_INT_ENABLED)
+    /*IPstack_Start waits for the router's ARP reply for so many MACRead
+    calls.With the INT pin those do not touch the bus,so they take no
+    virtual time,and it gives up before the reply can get there.*/
+    printf("encnet needs ENC_INT_ENABLED 0 in \"enc28j60.h\".\n");
+    exit(2);
+#endif
+    IPstack_Start((unsigned char*)mac, (unsigned char*)ip);
+    if (!transactions){
+        /*The webserver.*/
+        for (;;){
+            IPstackIdle();
+            CyDelayUs(NODELOOPUS);
+        }
+    }
+
+    memcpy(serverIP, server, 4);
+    strcpy((char*)WebClientQuery, nodeQuery);
+    for (i = 0; i < transactions; i++){
+        nodeGotPage = 0;
+        started = SimNow();
+        WebClient_Send();
+        /*The connection is over once the FIN from the server is answered.
+        There are no retries in the stack,so a lost segment means waiting
+        out the timeout.*/
+        while ((WebClientStatus != 0) && (SimNow() - started < timeout)){
+            IPstackIdle();
+            CyDelayUs(NODELOOPUS);
+        }
+        NetTransactionDone(node, (WebClientStatus == 0) && nodeGotPage, started, SimNow());
+        WebClientStatus = 0;
+    }
+}
+
+void LCD_PrintString(const char* string){
+    if (strcmp(string, "200 OK") == 0){
+        nodeGotPage = 1;
+    }
+}
+
+/* [] END OF FILE */
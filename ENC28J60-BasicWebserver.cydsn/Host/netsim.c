@@ -0,0 +1,595 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Network simulator
+ Description : Runs a webserver board and up to three client boards,each a
+ copy of the stack on its own ENC28J60 model,over a virtual wire with a set
+ bandwidth,delay,loss,duplication and reordering.The clients fetch the
+ home page of the webserver over and over,and the time each fetch takes is
+ summed up.
+
+ Each board runs as a coroutine,with its own virtual time.The board that is
+ furthest behind runs,until it gets more than a quantum ahead of the next
+ one,and only ever between SPI transactions.Frames reach a board when its
+ time gets to them.A run depends only on the seed and the options,so the
+ same command gives the same numbers on every build,and every host.
+
+ Each board has its own port on a switch.A frame takes its time on the wire
+ to get into the port(store and forward),is held up by the delay,and then
+ goes out to the board it is for.There is a router on the switch at
+ routerIP,which answers ARP and passes IP frames addressed to it on to
+ the board with the IP they are for,so each board's IPstack_Start finds a
+ router as on a real network.
+
+ Usage: encnet [options]
+  -c clients    Client boards,1 to 3(1).
+  -n count      Pages each client fetches(100).
+  -s seed       Seed for the impairments(1).
+  -b bps        Bandwidth of each port(10000000).
+  -d us         Delay through the switch(0).
+  -l percent    Frames lost(0).
+  -u percent    Frames duplicated(0).
+  -r percent    Frames held back,so that later ones overtake them(0).
+  -R us         How long they are held back(1000).
+  -T ms         How long a client waits for a page(500).
+  -q us         Quantum(20).
+  -v            Prints a line for each fetch.
+*/
+#define HOST_NATIVE
+#include <device.h>
+#include <ucontext.h>
+#include "encsim.h"
+#include "netsim.h"
+
+#define NETMAXNODES     SIMMAXCHIPS
+#define NETSTACKSIZE    (256 * 1024)
+#define NETMAXQUEUED    256//Frames on their way through the switch.
+#define NETMAXFRAME     1518
+#define NETWIREEXTRA    (8 + 12)//Preamble and SFD,and the interpacket gap.
+
+/*A board.*/
+typedef struct {
+    ucontext_t Context;
+    uint8_t* Stack;
+    uint64_t Now;//Its virtual time,when it is not running.
+    uint8_t Done;
+    uint8_t Mac[6];
+    uint8_t Ip[4];
+    uint64_t PortFree;//When its port on the switch is free for the next frame.
+    /*Fetches,for the clients.*/
+    uint32_t Fetches;
+    uint32_t Failed;
+} NETNODE;
+
+/*A frame on its way to a board.*/
+typedef struct {
+    uint64_t At;//When it gets there.
+    uint32_t Seq;//Frames due at the same time go in the order they were sent.
+    uint8_t To;
+    uint16_t Len;
+    uint8_t Frame[NETMAXFRAME];
+} NETFRAME;
+
+/*Built for NETMAXNODES boards,see the Makefile.*/
+void NodeMain0(uint8_t node, const uint8_t* mac, const uint8_t* ip, const uint8_t* server, uint32_t transactions, uint32_t timeoutUs);
+void NodeMain1(uint8_t node, const uint8_t* mac, const uint8_t* ip, const uint8_t* server, uint32_t transactions, uint32_t timeoutUs);
+void NodeMain2(uint8_t node, const uint8_t* mac, const uint8_t* ip, const uint8_t* server, uint32_t transactions, uint32_t timeoutUs);
+void NodeMain3(uint8_t node, const uint8_t* mac, const uint8_t* ip, const uint8_t* server, uint32_t transactions, uint32_t timeoutUs);
+
+typedef void (*NODEMAIN)(uint8_t node, const uint8_t* mac, const uint8_t* ip, const uint8_t* server, uint32_t transactions, uint32_t timeoutUs);
+static const NODEMAIN NodeMains[NETMAXNODES] = { NodeMain0, NodeMain1, NodeMain2, NodeMain3 };
+
+/*The router,at routerIP in "globals.c".*/
+static const uint8_t RouterMac[6] = {0x02,0x00,0x00,0x00,0x00,0x01};
+static const uint8_t RouterIp[4] = {192,168,1,1};
+
+/*Options.*/
+static uint8_t Clients = 1;
+static uint32_t Fetches = 100;
+static uint64_t Seed = 1;
+static uint32_t Bandwidth = 10000000UL;
+static uint32_t DelayUs = 0;
+static double LossPct = 0;
+static double DupPct = 0;
+static double ReorderPct = 0;
+static uint32_t ReorderUs = 1000;
+static uint32_t TimeoutMs = 500;
+static uint32_t QuantumUs = 20;
+static uint8_t Verbose = 0;
+
+static NETNODE Nodes[NETMAXNODES];
+static uint8_t NodeCount;
+static uint8_t Running;
+static ucontext_t Scheduler;
+static uint64_t SwitchAt;//When the board running has to give way.
+
+static NETFRAME Queued[NETMAXQUEUED];
+static uint16_t QueuedCount;
+static uint32_t QueuedSeq;
+static uint64_t Random;
+
+/*Wire counters.*/
+static uint32_t WireSent;
+static uint32_t WireLost;
+static uint32_t WireDuplicated;
+static uint32_t WireReordered;
+static uint32_t WireDropped;//No room in the switch,or nowhere to go.
+
+/*Every fetch,for the percentiles.*/
+static uint64_t* Latencies;
+static uint32_t LatencyCount;
+
+static void NodeEntry(void);
+static void NetTimer(void);
+static void ArmTimer(void);
+static void NetWire(uint8_t chip, const uint8_t* frame, uint16_t len);
+static void Route(uint8_t from, uint8_t* frame, uint16_t len, uint64_t at);
+static void Enqueue(uint8_t to, const uint8_t* frame, uint16_t len, uint64_t at);
+static void Deliver(uint8_t node);
+static double Chance(void);
+static int CompareNs(const void* a, const void* b);
+static double HostSeconds(void);
+
+int main(int argc, char** argv){
+    int arg;
+    uint8_t i;
+    uint8_t next;
+    uint8_t clientsLeft;
+    uint32_t ok = 0;
+    uint32_t k;
+    double started;
+    double hostTime;
+    double sum = 0;
+
+    for (arg = 1; arg < argc; arg++){
+        const char* value = (arg + 1 < argc) ? argv[arg + 1] : 0;
+
+        if (!strcmp(argv[arg], "-v")){
+            Verbose = 1;
+            continue;
+        }
+        if ((argv[arg][0] != '-') || !argv[arg][1] || argv[arg][2] || !value){
+            printf("Usage: encnet [-c clients] [-n count] [-s seed] [-b bps] [-d us] [-l %%] [-u %%] [-r %%] [-R us] [-T ms] [-q us] [-v]\n");
+            return 2;
+        }
+        arg++;
+        switch (argv[arg - 1][1]){
+            case 'c': Clients = (uint8_t)strtoul(value, 0, 0); break;
+            case 'n': Fetches = strtoul(value, 0, 0); break;
+            case 's': Seed = strtoull(value, 0, 0); break;
+            case 'b': Bandwidth = strtoul(value, 0, 0); break;
+            case 'd': DelayUs = strtoul(value, 0, 0); break;
+            case 'l': LossPct = strtod(value, 0); break;
+            case 'u': DupPct = strtod(value, 0); break;
+            case 'r': ReorderPct = strtod(value, 0); break;
+            case 'R': ReorderUs = strtoul(value, 0, 0); break;
+            case 'T': TimeoutMs = strtoul(value, 0, 0); break;
+            case 'q': QuantumUs = strtoul(value, 0, 0); break;
+            default:
+                printf("Unknown option %s\n", argv[arg - 1]);
+                return 2;
+        }
+    }
+    if ((Clients < 1) || (Clients >= NETMAXNODES) || !Bandwidth || !QuantumUs){
+        printf("From 1 to %u clients,and a bandwidth and quantum above 0.\n", NETMAXNODES - 1);
+        return 2;
+    }
+
+    SimInit();
+    /*Never 0,or xorshift gets stuck there.*/
+    Random = Seed ? Seed : 0x9e3779b97f4a7c15ULL;
+    NodeCount = Clients + 1;
+    Latencies = malloc(sizeof(uint64_t) * (size_t)Clients * (Fetches ? Fetches : 1));
+    for (i = 0; i < NodeCount; i++){
+        NETNODE* n = &Nodes[i];
+
+        /*Board 0 has the addresses in "main.c",the rest follow on.*/
+        n->Mac[0] = 0x00; n->Mac[1] = 0xa0; n->Mac[2] = 0xc9;
+        n->Mac[3] = 0x14; n->Mac[4] = 0xc8; n->Mac[5] = i;
+        n->Ip[0] = 192; n->Ip[1] = 168; n->Ip[2] = 1; n->Ip[3] = 153 + i;
+        n->Stack = malloc(NETSTACKSIZE);
+        if (!n->Stack || !Latencies){
+            printf("Out of memory\n");
+            return 2;
+        }
+        getcontext(&n->Context);
+        n->Context.uc_stack.ss_sp = n->Stack;
+        n->Context.uc_stack.ss_size = NETSTACKSIZE;
+        n->Context.uc_link = &Scheduler;
+        makecontext(&n->Context, NodeEntry, 0);
+        SimSetWire(i, NetWire);
+    }
+
+    printf("Webserver and %u clients,%lu fetches each,seed %llu\n", Clients,
+           (unsigned long)Fetches, (unsigned long long)Seed);
+    printf("Wire:%lu bps,delay %lu us,loss %.2f%%,duplication %.2f%%,reordering %.2f%% by %lu us\n",
+           (unsigned long)Bandwidth, (unsigned long)DelayUs, LossPct, DupPct, ReorderPct,
+           (unsigned long)ReorderUs);
+
+    started = HostSeconds();
+    for (;;){
+        /*The board furthest behind runs,the first one on a tie.*/
+        next = NETMAXNODES;
+        clientsLeft = 0;
+        for (i = 0; i < NodeCount; i++){
+            if (Nodes[i].Done){
+                continue;
+            }
+            if (i){
+                clientsLeft++;
+            }
+            if ((next == NETMAXNODES) || (Nodes[i].Now < Nodes[next].Now)){
+                next = i;
+            }
+        }
+        if (!clientsLeft){
+            break;
+        }
+        Running = next;
+        HostSetBoard(next);
+        SimSetTime(Nodes[next].Now);
+        ArmTimer();
+        swapcontext(&Scheduler, &Nodes[next].Context);
+        Nodes[next].Now = SimNow();
+    }
+    hostTime = HostSeconds() - started;
+
+    for (i = 1; i < NodeCount; i++){
+        printf("Client %u:%lu fetches,%lu failed\n", i, (unsigned long)Nodes[i].Fetches,
+               (unsigned long)Nodes[i].Failed);
+        ok += Nodes[i].Fetches - Nodes[i].Failed;
+    }
+    if (LatencyCount){
+        qsort(Latencies, LatencyCount, sizeof(uint64_t), CompareNs);
+        for (k = 0; k < LatencyCount; k++){
+            sum += Latencies[k];
+        }
+        printf("Pages fetched %lu,time in ms:min %.3f,mean %.3f,median %.3f,99%% %.3f,max %.3f\n",
+               (unsigned long)LatencyCount, Latencies[0] / 1e6, sum / LatencyCount / 1e6,
+               Latencies[LatencyCount / 2] / 1e6, Latencies[(LatencyCount * 99) / 100] / 1e6,
+               Latencies[LatencyCount - 1] / 1e6);
+    }
+    printf("Wire:%lu frames sent,%lu lost,%lu duplicated,%lu reordered,%lu dropped\n",
+           (unsigned long)WireSent, (unsigned long)WireLost, (unsigned long)WireDuplicated,
+           (unsigned long)WireReordered, (unsigned long)WireDropped);
+    printf("Virtual time %.3f s,host time %.3f s\n", SimNow() / 1e9, hostTime);
+    return (ok == (uint32_t)Clients * Fetches) ? 0 : 1;
+}
+
+void NetTransactionDone(uint8_t node, uint8_t ok, uint64_t startNs, uint64_t endNs){
+    Nodes[node].Fetches++;
+    if (ok){
+        Latencies[LatencyCount++] = endNs - startNs;
+    }else{
+        Nodes[node].Failed++;
+    }
+    if (Verbose){
+        printf("%10.3f ms client %u fetch %lu %s in %.3f ms\n", startNs / 1e6, node,
+               (unsigned long)Nodes[node].Fetches, ok ? "done" : "failed", (endNs - startNs) / 1e6);
+    }
+}
+
+/*------------------------Private Functions-----------------------------*/
+
+/*******************************************************************************
+* Function Name: NodeEntry
+********************************************************************************
+* Summary:
+*   Where each board's coroutine starts.Board 0 is the webserver.
+*
+* Parameters:
+*   none.Running says which board it is.
+*
+* Returns:
+*   Nothing.It returns to the scheduler in main once the board is done.
+*******************************************************************************/
+static void NodeEntry(void){
+    uint8_t node = Running;
+
+    NodeMains[node](node, Nodes[node].Mac, Nodes[node].Ip, Nodes[0].Ip,
+                    node ? Fetches : 0, TimeoutMs * 1000UL);
+    Nodes[node].Done = 1;
+    Nodes[node].Now = SimNow();
+}
+
+/*******************************************************************************
+* Function Name: NetTimer
+********************************************************************************
+* Summary:
+*   Goes off when a frame reaches the board running,or when it is time for
+*   it to give way to the board furthest behind.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void NetTimer(void){
+    Deliver(Running);
+    if (SimNow() >= SwitchAt){
+        Nodes[Running].Now = SimNow();
+        swapcontext(&Nodes[Running].Context, &Scheduler);
+        /*Back again,with the time and board set up by main.*/
+    }
+    ArmTimer();
+}
+
+/*******************************************************************************
+* Function Name: ArmTimer
+********************************************************************************
+* Summary:
+*   Sets the timer for the board running,for the next frame it has coming,
+*   or for a quantum past the board furthest behind of the others,whichever
+*   is sooner.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void ArmTimer(void){
+    uint64_t at = UINT64_MAX;
+    uint16_t i;
+
+    SwitchAt = UINT64_MAX;
+    for (i = 0; i < NodeCount; i++){
+        if ((i != Running) && !Nodes[i].Done && (Nodes[i].Now + QuantumUs * 1000ULL < SwitchAt)){
+            SwitchAt = Nodes[i].Now + QuantumUs * 1000ULL;
+        }
+    }
+    at = SwitchAt;
+    for (i = 0; i < QueuedCount; i++){
+        if ((Queued[i].To == Running) && (Queued[i].At < at)){
+            at = Queued[i].At;
+        }
+    }
+    SimSetTimer(at, NetTimer);
+}
+
+/*******************************************************************************
+* Function Name: NetWire
+********************************************************************************
+* Summary:
+*   Takes each frame a board sends,at the time it is done sending it,and
+*   puts it through the port on the switch:lost,duplicated,held back,and
+*   then on its way.
+*
+* Parameters:
+*   chip - the board that sent it.
+*   frame - the frame,FCS included.
+*   len - its length.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void NetWire(uint8_t chip, const uint8_t* frame, uint16_t len){
+    static uint8_t copy[NETMAXFRAME];
+    uint64_t wireNs;
+    uint64_t at;
+    double lost;
+    double duplicated;
+    double reordered;
+
+    WireSent++;
+    if (len > NETMAXFRAME){
+        WireDropped++;
+        return;
+    }
+    /*The same number of draws for every frame,so that changing one
+    impairment leaves the others where they were.*/
+    lost = Chance();
+    duplicated = Chance();
+    reordered = Chance();
+    if (lost * 100 < LossPct){
+        WireLost++;
+        return;
+    }
+
+    wireNs = (uint64_t)(len + NETWIREEXTRA) * 8 * 1000000000ULL / Bandwidth;
+    at = (SimNow() > Nodes[chip].PortFree) ? SimNow() : Nodes[chip].PortFree;
+    Nodes[chip].PortFree = at + wireNs;
+    at += wireNs + DelayUs * 1000ULL;
+    if (reordered * 100 < ReorderPct){
+        WireReordered++;
+        at += ReorderUs * 1000ULL;
+    }
+    memcpy(copy, frame, len);
+    Route(chip, copy, len, at);
+    if (duplicated * 100 < DupPct){
+        WireDuplicated++;
+        memcpy(copy, frame, len);
+        Route(chip, copy, len, at + wireNs);
+    }
+    ArmTimer();
+}
+
+/*******************************************************************************
+* Function Name: Route
+********************************************************************************
+* Summary:
+*   Works out where a frame goes:every other board if it is broadcast,the
+*   router if it is for the router,or the board with its MAC address.
+*
+* Parameters:
+*   from - the board that sent it.
+*   frame - the frame,FCS included.It may be changed.
+*   len - its length.
+*   at - when it gets where it is going.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Route(uint8_t from, uint8_t* frame, uint16_t len, uint64_t at){
+    static const uint8_t broadcast[6] = {0xff,0xff,0xff,0xff,0xff,0xff};
+    uint8_t reply[64];
+    uint8_t i;
+
+    if (!memcmp(frame, broadcast, 6)){
+        for (i = 0; i < NodeCount; i++){
+            if (i != from){
+                Enqueue(i, frame, len, at);
+            }
+        }
+        /*ARP request for the router,so it answers.*/
+        if ((len >= 42 + 4) && (frame[12] == 0x08) && (frame[13] == 0x06) && (frame[21] == 0x01) &&
+            !memcmp(&frame[38], RouterIp, 4)){
+            memset(reply, 0, sizeof(reply));
+            memcpy(&reply[0], &frame[6], 6);
+            memcpy(&reply[6], RouterMac, 6);
+            memcpy(&reply[12], &frame[12], 8);//Type,and the ARP header.
+            reply[21] = 0x02;
+            memcpy(&reply[22], RouterMac, 6);
+            memcpy(&reply[28], RouterIp, 4);
+            memcpy(&reply[32], &frame[22], 10);//Sender of the request.
+            Enqueue(from, reply, SimAddFcs(reply, 60), at);
+        }
+        return;
+    }
+    if (!memcmp(frame, RouterMac, 6)){
+        /*Passed on by IP address,to the board's MAC address.*/
+        if ((len >= 34 + 4) && (frame[12] == 0x08) && (frame[13] == 0x00)){
+            for (i = 0; i < NodeCount; i++){
+                if (!memcmp(&frame[30], Nodes[i].Ip, 4)){
+                    memcpy(frame, Nodes[i].Mac, 6);
+                    Enqueue(i, frame, SimAddFcs(frame, len - 4), at);
+                    return;
+                }
+            }
+        }
+        WireDropped++;
+        return;
+    }
+    for (i = 0; i < NodeCount; i++){
+        if (!memcmp(frame, Nodes[i].Mac, 6)){
+            Enqueue(i, frame, len, at);
+            return;
+        }
+    }
+    WireDropped++;
+}
+
+/*******************************************************************************
+* Function Name: Enqueue
+********************************************************************************
+* Summary:
+*   Holds a frame in the switch till it is due at a board.
+*
+* Parameters:
+*   to - the board.
+*   frame - the frame,FCS included.
+*   len - its length.
+*   at - when it is due.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Enqueue(uint8_t to, const uint8_t* frame, uint16_t len, uint64_t at){
+    NETFRAME* q;
+
+    if (QueuedCount >= NETMAXQUEUED){
+        WireDropped++;
+        return;
+    }
+    q = &Queued[QueuedCount++];
+    q->At = at;
+    q->Seq = QueuedSeq++;
+    q->To = to;
+    q->Len = len;
+    memcpy(q->Frame, frame, len);
+}
+
+/*******************************************************************************
+* Function Name: Deliver
+********************************************************************************
+* Summary:
+*   Hands a board the frames that have reached it,in order.
+*
+* Parameters:
+*   node - the board.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Deliver(uint8_t node){
+    uint16_t i;
+    uint16_t first;
+
+    for (;;){
+        first = QueuedCount;
+        for (i = 0; i < QueuedCount; i++){
+            if ((Queued[i].To == node) && (Queued[i].At <= SimNow()) &&
+                ((first == QueuedCount) || (Queued[i].At < Queued[first].At) ||
+                 ((Queued[i].At == Queued[first].At) && (Queued[i].Seq < Queued[first].Seq)))){
+                first = i;
+            }
+        }
+        if (first == QueuedCount){
+            return;
+        }
+        SimDeliver(node, Queued[first].Frame, Queued[first].Len);
+        if (first != --QueuedCount){
+            Queued[first] = Queued[QueuedCount];
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: Chance
+********************************************************************************
+* Summary:
+*   Draws the next random number,from xorshift64*.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   A number from 0 up to,but not including,1.
+*******************************************************************************/
+static double Chance(void){
+    Random ^= Random >> 12;
+    Random ^= Random << 25;
+    Random ^= Random >> 27;
+    return ((Random * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+/*******************************************************************************
+* Function Name: CompareNs
+********************************************************************************
+* Summary:
+*   Orders two times,for qsort.
+*
+* Parameters:
+*   a,b - the times.
+*
+* Returns:
+*   Less than,equal to or more than 0,as a is before,at or after b.
+*******************************************************************************/
+static int CompareNs(const void* a, const void* b){
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/*******************************************************************************
+* Function Name: HostSeconds
+********************************************************************************
+* Summary:
+*   Reads the host's monotonic clock.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Seconds,from some point in the past.
+*******************************************************************************/
+static double HostSeconds(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,55 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Network simulator
+ Description : What "netsim.c" and each board built from "netnode.c" call
+ in each other.Only native types cross,since the boards are built with the
+ Keil C51 layout and netsim.c is not.
+*/
+#ifndef NETSIM_H
+#define NETSIM_H
+#include <stdint.h>
+
+/*******************************************************************************
+* Function Name: NodeMain
+********************************************************************************
+* Summary:
+*   Runs one board,as main does on the PSoC3.Each board is a copy of the
+*   stack and "netnode.c",linked on its own,so NodeMain comes as NodeMain0,
+*   NodeMain1 and so on,see the Makefile.
+*   Board 0 is a webserver and never returns.The others are clients,which
+*   fetch its home page over and over,and return once they are done.
+*
+* Parameters:
+*   node - which board.Its ENC28J60 is the chip of the same number.
+*   mac - its MAC address.
+*   ip - its IP address.
+*   server - IP address of the webserver.
+*   transactions - pages to fetch,0 to be the webserver.
+*   timeoutUs - virtual time to wait for each,before giving up on it.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void NodeMain(uint8_t node, const uint8_t* mac, const uint8_t* ip, const uint8_t* server,
+              uint32_t transactions, uint32_t timeoutUs);
+
+/*******************************************************************************
+* Function Name: NetTransactionDone
+********************************************************************************
+* Summary:
+*   Called by a client for each page it fetched,or gave up on.
+*
+* Parameters:
+*   node - the client.
+*   ok - 1 if it got the page,0 if it gave up.
+*   startNs - virtual time it asked for it.
+*   endNs - virtual time it was done.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void NetTransactionDone(uint8_t node, uint8_t ok, uint64_t startNs, uint64_t endNs);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,185 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : pcap files
+ Description : See "pcapfile.h".
+ The file header is 24 bytes:magic,version 2.4,time zone,accuracy,snap
+ length and link type.Each frame follows a 16 byte header:seconds,micro or
+ nanoseconds,bytes captured and bytes on the wire.All of it is in the byte
+ order of whoever wrote the file,which the magic gives away.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "pcapfile.h"
+
+#define PCAPMAGICUS     0xa1b2c3d4UL
+#define PCAPMAGICNS     0xa1b23c4dUL
+#define PCAPLINKETHER   1
+#define PCAPSNAPLEN     65535
+#define PCAPHDRLEN      24
+#define PCAPRECLEN      16
+
+struct PcapFile {
+    FILE* File;
+    uint8_t Swapped;//Written in the other byte order.
+    uint8_t Nano;//Time stamps in nanoseconds rather than microseconds.
+};
+
+static uint32_t Get32(const PCAPFILE* pcap, const uint8_t* bytes);
+static void Put32(uint8_t* bytes, uint32_t value);
+
+PCAPFILE* PcapOpenRead(const char* path){
+    PCAPFILE* pcap;
+    uint8_t header[PCAPHDRLEN];
+    uint32_t magic;
+
+    pcap = calloc(1, sizeof(PCAPFILE));
+    if (!pcap){
+        return 0;
+    }
+    pcap->File = fopen(path, "rb");
+    if (!pcap->File || (fread(header, 1, sizeof(header), pcap->File) != sizeof(header))){
+        PcapClose(pcap);
+        return 0;
+    }
+    /*Read as little endian first,and swap if that does not make sense.*/
+    magic = Get32(pcap, header);
+    if ((magic != PCAPMAGICUS) && (magic != PCAPMAGICNS)){
+        pcap->Swapped = 1;
+        magic = Get32(pcap, header);
+    }
+    if ((magic != PCAPMAGICUS) && (magic != PCAPMAGICNS)){
+        PcapClose(pcap);
+        return 0;
+    }
+    pcap->Nano = (magic == PCAPMAGICNS);
+    if (Get32(pcap, &header[20]) != PCAPLINKETHER){
+        PcapClose(pcap);
+        return 0;
+    }
+    return pcap;
+}
+
+uint8_t PcapRead(PCAPFILE* pcap, uint8_t* frame, uint16_t maxLen, uint16_t* len, uint64_t* ns){
+    uint8_t header[PCAPRECLEN];
+    uint32_t captured;
+    uint32_t original;
+    size_t got;
+
+    got = fread(header, 1, sizeof(header), pcap->File);
+    if (got == 0){
+        return PCAP_END;
+    }
+    if (got != sizeof(header)){
+        return PCAP_ERROR;
+    }
+    captured = Get32(pcap, &header[8]);
+    original = Get32(pcap, &header[12]);
+    *ns = (uint64_t)Get32(pcap, header) * 1000000000ULL +
+          (uint64_t)Get32(pcap, &header[4]) * (pcap->Nano ? 1 : 1000);
+    if ((captured != original) || (captured > maxLen)){
+        /*Passed over,rather than handed on cut short.*/
+        return fseek(pcap->File, captured, SEEK_CUR) ? PCAP_ERROR : PCAP_SKIPPED;
+    }
+    if (fread(frame, 1, captured, pcap->File) != captured){
+        return PCAP_ERROR;
+    }
+    *len = (uint16_t)captured;
+    return PCAP_OK;
+}
+
+PCAPFILE* PcapOpenWrite(const char* path){
+    PCAPFILE* pcap;
+    uint8_t header[PCAPHDRLEN] = {0};
+
+    pcap = calloc(1, sizeof(PCAPFILE));
+    if (!pcap){
+        return 0;
+    }
+    pcap->File = fopen(path, "wb");
+    if (!pcap->File){
+        PcapClose(pcap);
+        return 0;
+    }
+    /*Written little endian.*/
+    Put32(header, PCAPMAGICUS);
+    header[4] = 2;//Version 2.4.
+    header[6] = 4;
+    Put32(&header[16], PCAPSNAPLEN);
+    Put32(&header[20], PCAPLINKETHER);
+    if (fwrite(header, 1, sizeof(header), pcap->File) != sizeof(header)){
+        PcapClose(pcap);
+        return 0;
+    }
+    return pcap;
+}
+
+uint8_t PcapWrite(PCAPFILE* pcap, const uint8_t* frame, uint16_t len, uint64_t ns){
+    uint8_t header[PCAPRECLEN];
+
+    Put32(header, (uint32_t)(ns / 1000000000ULL));
+    Put32(&header[4], (uint32_t)((ns % 1000000000ULL) / 1000));
+    Put32(&header[8], len);
+    Put32(&header[12], len);
+    if ((fwrite(header, 1, sizeof(header), pcap->File) != sizeof(header)) ||
+        (fwrite(frame, 1, len, pcap->File) != len)){
+        return 1;
+    }
+    return 0;
+}
+
+void PcapClose(PCAPFILE* pcap){
+    if (!pcap){
+        return;
+    }
+    if (pcap->File){
+        fclose(pcap->File);
+    }
+    free(pcap);
+}
+
+/*------------------------Private Functions-----------------------------*/
+
+/*******************************************************************************
+* Function Name: Get32
+********************************************************************************
+* Summary:
+*   Reads a 32 bit field in the byte order of a capture.
+*
+* Parameters:
+*   pcap - the capture.
+*   bytes - the field.
+*
+* Returns:
+*   Its value.
+*******************************************************************************/
+static uint32_t Get32(const PCAPFILE* pcap, const uint8_t* bytes){
+    if (pcap->Swapped){
+        return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) |
+               ((uint32_t)bytes[2] << 8) | bytes[3];
+    }
+    return ((uint32_t)bytes[3] << 24) | ((uint32_t)bytes[2] << 16) |
+           ((uint32_t)bytes[1] << 8) | bytes[0];
+}
+
+/*******************************************************************************
+* Function Name: Put32
+********************************************************************************
+* Summary:
+*   Writes a 32 bit field,least significant byte first.
+*
+* Parameters:
+*   bytes - the field.
+*   value - its value.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void Put32(uint8_t* bytes, uint32_t value){
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,102 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : pcap files
+ Description : Reads and writes Ethernet captures in the classic libpcap
+ format,as Wireshark and tcpdump save them.Microsecond and nanosecond
+ captures,in either byte order,are read.pcapng is not.
+ Frames are kept as on the wire,without the FCS,and time stamps are in
+ nanoseconds.
+*/
+#ifndef PCAPFILE_H
+#define PCAPFILE_H
+#include <stdint.h>
+
+/*Returned by PcapRead.*/
+#define PCAP_OK         0//A frame was read.
+#define PCAP_END        1//No more frames.
+#define PCAP_SKIPPED    2//A frame was cut short when it was captured,or too long for the buffer,and was passed over.
+#define PCAP_ERROR      3//The file is damaged.
+
+/*An open capture.*/
+typedef struct PcapFile PCAPFILE;
+
+/*******************************************************************************
+* Function Name: PcapOpenRead
+********************************************************************************
+* Summary:
+*   Opens a capture,and checks that it holds Ethernet frames.
+*
+* Parameters:
+*   path - the file.
+*
+* Returns:
+*   The capture,or 0 if the file cannot be opened or is not an Ethernet pcap.
+*******************************************************************************/
+PCAPFILE* PcapOpenRead(const char* path);
+
+/*******************************************************************************
+* Function Name: PcapRead
+********************************************************************************
+* Summary:
+*   Reads the next frame from a capture.
+*
+* Parameters:
+*   pcap - the capture,from PcapOpenRead.
+*   frame - where to put the frame.
+*   maxLen - room there.
+*   len - set to the length of the frame.
+*   ns - set to its time stamp,in nanoseconds.
+*
+* Returns:
+*   One of PCAP_.
+*******************************************************************************/
+uint8_t PcapRead(PCAPFILE* pcap, uint8_t* frame, uint16_t maxLen, uint16_t* len, uint64_t* ns);
+
+/*******************************************************************************
+* Function Name: PcapOpenWrite
+********************************************************************************
+* Summary:
+*   Creates an Ethernet capture,with microsecond time stamps.
+*
+* Parameters:
+*   path - the file.It is overwritten.
+*
+* Returns:
+*   The capture,or 0 if the file cannot be created.
+*******************************************************************************/
+PCAPFILE* PcapOpenWrite(const char* path);
+
+/*******************************************************************************
+* Function Name: PcapWrite
+********************************************************************************
+* Summary:
+*   Adds a frame to a capture.
+*
+* Parameters:
+*   pcap - the capture,from PcapOpenWrite.
+*   frame - the frame,without the FCS.
+*   len - its length.
+*   ns - its time stamp,in nanoseconds.
+*
+* Returns:
+*   0 if it was written,1 if the write failed.
+*******************************************************************************/
+uint8_t PcapWrite(PCAPFILE* pcap, const uint8_t* frame, uint16_t len, uint64_t ns);
+
+/*******************************************************************************
+* Function Name: PcapClose
+********************************************************************************
+* Summary:
+*   Closes a capture,read or written.
+*
+* Parameters:
+*   pcap - the capture,or 0.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+void PcapClose(PCAPFILE* pcap);
+
+#endif
+/* [] END OF FILE */
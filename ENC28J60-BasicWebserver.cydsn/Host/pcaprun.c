@@ -0,0 +1,487 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : pcap replay
+ Description : Replays the frames in a capture into the stack,through the
+ ENC28J60 model,and saves what the stack sends back into another capture.
+ Each frame goes through the filters of the chip,and is then handled by
+ one call to IPstackIdle,as in the main loop of "main.c".The time that
+ takes is measured per frame,in virtual time(SPI and wire,see
+ "readme.txt") and in host time,and summed up by protocol.
+
+ Usage: encpcap [-m mac] [-i ip] [-n passes] [-t] [-v] in.pcap [out.pcap]
+  -m,-i  MAC and IP address of the stack,as in "main.c" by default.Frames
+         the chip filters out are counted,but not handled.
+  -n     Replays the capture that many times.
+  -t     Keeps the gaps between frames in the capture,in virtual time.
+         Otherwise each frame follows as soon as the last one is handled.
+  -v     Prints a line for each frame.
+*/
+#include <device.h>
+#include "IPStackMain.h"
+#include "encsim.h"
+#include "pcapfile.h"
+
+/*What frames are summed up by.*/
+#define CLASS_ARP       0
+#define CLASS_ICMP      1
+#define CLASS_TCP       2
+#define CLASS_UDP       3
+#define CLASS_IP        4//Other IP protocols.
+#define CLASS_OTHER     5
+#define CLASS_COUNT     6
+
+static const char* const ClassNames[CLASS_COUNT] = { "ARP", "ICMP", "TCP", "UDP", "IP", "Other" };
+
+#if (HANDLER_PROF_ENABLED)
+static const char* const HandlerNames[HPROF_HANDLERS] = { "ARP", "Ping", "Web server", "Web client", "UDP" };
+static void PrintHandlerProfile(void);
+#endif
+
+/*Totals for one class of frames.*/
+typedef struct {
+    unsigned long Frames;//In the capture.
+    unsigned long Taken;//Let through by the filters of the chip,and handled.
+    unsigned long Sent;//Frames the stack sent while handling them.
+    uint64_t VirtualNs;//Time handling them.
+    uint64_t VirtualMaxNs;
+    uint64_t HostNs;
+    uint64_t HostMaxNs;
+} CLASSSTATS;
+
+/*MAC address of the router,which answers the ARP request from IPstack_Start.*/
+static const unsigned char pcapRouterMAC[6] = {0x02,0x00,0x00,0x00,0x00,0x01};
+
+static CLASSSTATS pcapClasses[CLASS_COUNT];
+static PCAPFILE* pcapOut;
+static unsigned long pcapSent;//Frames the stack has put on the wire.
+static unsigned long pcapBadSums;//Of those,ones with a wrong IP,ICMP,UDP or TCP checksum.
+static unsigned char pcapWriteFailed;
+static uint64_t pcapFirstNs;//Time stamp of the first frame replayed.
+static uint64_t pcapStartNs;//Virtual time it was replayed at.What is saved is time stamped from these.
+static unsigned char pcapVerbose;
+
+static void StartWire(uint8 chip, const uint8* frame, uint16 len);
+static void CaptureWire(uint8 chip, const uint8* frame, uint16 len);
+static void ReplayFrame(unsigned long index, uint8* frame, uint16 len);
+static unsigned char Classify(const uint8* frame, uint16 len);
+static unsigned char ParseAddress(const char* text, unsigned char* bytes, unsigned char count, char separator, unsigned char base);
+static uint64_t HostNs(void);
+
+/*main has to return a real int,whatever the stack thinks an int is.*/
+#undef int
+int main(int argc, char** argv){
+    unsigned char mac[6] = {0x00,0xa0,0xc9,0x14,0xc8,0x00};
+    unsigned char ip[4] = {192,168,1,153};
+    unsigned long passes = 1;
+    unsigned char timed = 0;
+    const char* inPath = 0;
+    const char* outPath = 0;
+    static uint8 frame[MAXFRAMELEN];
+    PCAPFILE* in;
+    uint16 len;
+    uint64_t ns;
+    uint64_t at;
+    uint64_t passFirstNs = 0;
+    uint64_t passStartNs = 0;
+    uint64_t hostStarted;
+    unsigned long pass;
+    unsigned long index = 0;
+    unsigned long skipped = 0;
+    unsigned char result = PCAP_END;
+    unsigned char haveFirst = 0;
+    unsigned char i;
+    CLASSSTATS total;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++){
+        if (!strcmp(argv[arg], "-m") && (arg + 1 < argc)){
+            if (ParseAddress(argv[++arg], mac, 6, ':', 16) != TRUE){
+                printf("Bad MAC address %s\n", argv[arg]);
+                return 2;
+            }
+        }else if (!strcmp(argv[arg], "-i") && (arg + 1 < argc)){
+            if (ParseAddress(argv[++arg], ip, 4, '.', 10) != TRUE){
+                printf("Bad IP address %s\n", argv[arg]);
+                return 2;
+            }
+        }else if (!strcmp(argv[arg], "-n") && (arg + 1 < argc)){
+            passes = strtoul(argv[++arg], 0, 0);
+        }else if (!strcmp(argv[arg], "-t")){
+            timed = 1;
+        }else if (!strcmp(argv[arg], "-v")){
+            pcapVerbose = 1;
+        }else if (!inPath){
+            inPath = argv[arg];
+        }else if (!outPath){
+            outPath = argv[arg];
+        }else{
+            inPath = 0;
+            break;
+        }
+    }
+    if (!inPath){
+        printf("Usage: encpcap [-m mac] [-i ip] [-n passes] [-t] [-v] in.pcap [out.pcap]\n");
+        return 2;
+    }
+    if (outPath){
+        pcapOut = PcapOpenWrite(outPath);
+        if (!pcapOut){
+            printf("Cannot create %s\n", outPath);
+            return 2;
+        }
+    }
+
+    SimInit();
+    SimSetWire(0, StartWire);
+    if (IPstack_Start(mac, ip) != TRUE){
+        printf("IPstack_Start failed,no chip,no link or no ARP reply from the router.\n");
+        return 1;
+    }
+    SimSettle();
+    SimSetWire(0, CaptureWire);
+    ResetHandlerProfile();
+
+    hostStarted = HostNs();
+    for (pass = 0; pass < passes; pass++){
+        in = PcapOpenRead(inPath);
+        if (!in){
+            printf("Cannot read %s as an Ethernet pcap file\n", inPath);
+            return 2;
+        }
+        /*Each pass starts where the last one ended.*/
+        haveFirst = 0;
+        while ((result = PcapRead(in, frame, sizeof(frame) - 4, &len, &ns)) != PCAP_END){
+            if (result == PCAP_ERROR){
+                printf("%s is damaged after frame %lu\n", inPath, index);
+                break;
+            }
+            if (result == PCAP_SKIPPED){
+                skipped++;
+                continue;
+            }
+            if (!haveFirst){
+                haveFirst = 1;
+                passFirstNs = ns;
+                passStartNs = SimNow();
+                if (!index){
+                    pcapFirstNs = ns;
+                    pcapStartNs = passStartNs;
+                }
+            }else if (timed && (ns > passFirstNs)){
+                /*Wait till the frame is due.SimAdvance takes 32 bits at a time.*/
+                at = passStartNs + (ns - passFirstNs);
+                while (SimNow() < at){
+                    SimAdvance((at - SimNow() > 0x40000000UL) ? 0x40000000UL : (uint32_t)(at - SimNow()));
+                }
+            }
+            ReplayFrame(index++, frame, len);
+        }
+        PcapClose(in);
+        if (result == PCAP_ERROR){
+            break;
+        }
+    }
+    PcapClose(pcapOut);
+
+    memset(&total, 0, sizeof(total));
+    printf("%-6s %8s %8s %8s %12s %12s %12s %12s\n", "Class", "Frames", "Handled", "Sent",
+           "Virt us avg", "Virt us max", "Host us avg", "Host us max");
+    for (i = 0; i < CLASS_COUNT; i++){
+        CLASSSTATS* c = &pcapClasses[i];
+
+        total.Frames += c->Frames;
+        total.Taken += c->Taken;
+        total.Sent += c->Sent;
+        total.VirtualNs += c->VirtualNs;
+        total.HostNs += c->HostNs;
+        if (c->VirtualMaxNs > total.VirtualMaxNs){
+            total.VirtualMaxNs = c->VirtualMaxNs;
+        }
+        if (c->HostMaxNs > total.HostMaxNs){
+            total.HostMaxNs = c->HostMaxNs;
+        }
+        if (c->Frames){
+            printf("%-6s %8lu %8lu %8lu %12.1f %12.1f %12.2f %12.2f\n", ClassNames[i],
+                   c->Frames, c->Taken, c->Sent,
+                   c->Taken ? c->VirtualNs / 1e3 / c->Taken : 0.0, c->VirtualMaxNs / 1e3,
+                   c->Taken ? c->HostNs / 1e3 / c->Taken : 0.0, c->HostMaxNs / 1e3);
+        }
+    }
+    printf("%-6s %8lu %8lu %8lu %12.1f %12.1f %12.2f %12.2f\n", "All",
+           total.Frames, total.Taken, total.Sent,
+           total.Taken ? total.VirtualNs / 1e3 / total.Taken : 0.0, total.VirtualMaxNs / 1e3,
+           total.Taken ? total.HostNs / 1e3 / total.Taken : 0.0, total.HostMaxNs / 1e3);
+    if (skipped){
+        printf("%lu frames skipped,cut short in the capture or too long.\n", skipped);
+    }
+    if (total.VirtualNs && total.HostNs){
+        printf("Handled %.0f frames/s in virtual time,%.0f frames/s on this host.\n",
+               total.Taken / (total.VirtualNs / 1e9), total.Taken / (total.HostNs / 1e9));
+    }
+    printf("Replay took %.3f s of host time.\n", (HostNs() - hostStarted) / 1e9);
+#if (HANDLER_PROF_ENABLED)
+    PrintHandlerProfile();
+#endif
+    if (pcapBadSums){
+        printf("%lu of the frames sent had bad checksums.\n", pcapBadSums);
+    }
+    if (pcapWriteFailed){
+        printf("Writing %s failed.\n", outPath);
+        return 1;
+    }
+    return ((result == PCAP_ERROR) || pcapBadSums) ? 1 : 0;
+}
+
+/*******************************************************************************
+* Function Name: ReplayFrame
+********************************************************************************
+* Summary:
+*   Hands a frame to the chip,lets the stack handle it,and adds up the time
+*   that took.
+*
+* Parameters:
+*   index - where it is in the replay,from 0.
+*   frame - the frame,with room for the FCS.
+*   len - its length without it.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void ReplayFrame(unsigned long index, uint8* frame, uint16 len){
+    CLASSSTATS* c;
+    unsigned char cls;
+    unsigned char taken;
+    unsigned long sent;
+    uint64_t virtualNs;
+    uint64_t hostNs;
+
+    cls = Classify(frame, len);
+    c = &pcapClasses[cls];
+    c->Frames++;
+
+    taken = SimDeliver(0, frame, SimAddFcs(frame, len));
+    if (taken != SIMRX_OK){
+        if (pcapVerbose){
+            printf("%6lu %-5s %4u filtered out\n", index, ClassNames[cls], (unsigned)len);
+        }
+        return;
+    }
+
+    sent = pcapSent;
+    virtualNs = SimNow();
+    hostNs = HostNs();
+    IPstackIdle();
+    hostNs = HostNs() - hostNs;
+    virtualNs = SimNow() - virtualNs;
+    /*Let what it sent reach the wire,so it is counted against this frame.*/
+    SimSettle();
+    sent = pcapSent - sent;
+
+    c->Taken++;
+    c->Sent += sent;
+    c->VirtualNs += virtualNs;
+    c->HostNs += hostNs;
+    if (virtualNs > c->VirtualMaxNs){
+        c->VirtualMaxNs = virtualNs;
+    }
+    if (hostNs > c->HostMaxNs){
+        c->HostMaxNs = hostNs;
+    }
+    if (pcapVerbose){
+        printf("%6lu %-5s %4u handled in %8.1f us virtual,%8.2f us host,%lu sent\n",
+               index, ClassNames[cls], (unsigned)len, virtualNs / 1e3, hostNs / 1e3, sent);
+    }
+}
+
+/*******************************************************************************
+* Function Name: StartWire
+********************************************************************************
+* Summary:
+*   The wire while IPstack_Start runs.The router answers its ARP request.
+*
+* Parameters:
+*   chip - the chip that sent the frame.
+*   frame - the frame,FCS included.
+*   len - its length.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void StartWire(uint8 chip, const uint8* frame, uint16 len){
+    uint8 reply[64];
+
+    (void)chip;
+    if ((len >= 42 + 4) && (frame[12] == 0x08) && (frame[13] == 0x06) && (frame[21] == 0x01) &&
+        (memcmp(&frame[38], routerIP, 4) == 0)){
+        memset(reply, 0, sizeof(reply));
+        memcpy(&reply[0], &frame[6], 6);
+        memcpy(&reply[6], pcapRouterMAC, 6);
+        memcpy(&reply[12], &frame[12], 8);//Type,and the ARP header.
+        reply[21] = 0x02;
+        memcpy(&reply[22], pcapRouterMAC, 6);
+        memcpy(&reply[28], routerIP, 4);
+        memcpy(&reply[32], &frame[22], 10);//Sender of the request.
+        SimDeliver(0, reply, SimAddFcs(reply, 60));
+    }
+}
+
+/*******************************************************************************
+* Function Name: CaptureWire
+********************************************************************************
+* Summary:
+*   The wire during the replay.Everything the stack sends is counted,its
+*   checksums checked(see SimSumsOk),and saved without its FCS,time
+*   stamped to line up with the capture replayed.
+*
+* Parameters:
+*   chip - the chip that sent the frame.
+*   frame - the frame,FCS included.
+*   len - its length.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void CaptureWire(uint8 chip, const uint8* frame, uint16 len){
+    (void)chip;
+    pcapSent++;
+    if (!SimSumsOk(frame, len)){
+        pcapBadSums++;
+    }
+    if (pcapOut && (len > 4)){
+        if (PcapWrite(pcapOut, frame, len - 4, pcapFirstNs + (SimNow() - pcapStartNs))){
+            pcapWriteFailed = 1;
+        }
+    }
+}
+
+/*******************************************************************************
+* Function Name: Classify
+********************************************************************************
+* Summary:
+*   Works out which class of CLASS_ a frame is summed up in.
+*
+* Parameters:
+*   frame - the frame.
+*   len - its length.
+*
+* Returns:
+*   One of CLASS_.
+*******************************************************************************/
+static unsigned char Classify(const uint8* frame, uint16 len){
+    if (len < 14){
+        return CLASS_OTHER;
+    }
+    if ((frame[12] == 0x08) && (frame[13] == 0x06)){
+        return CLASS_ARP;
+    }
+    if ((frame[12] != 0x08) || (frame[13] != 0x00) || (len < 34)){
+        return CLASS_OTHER;
+    }
+    switch (frame[23]){
+        case ICMPPROTOCOL:
+            return CLASS_ICMP;
+        case TCPPROTOCOL:
+            return CLASS_TCP;
+        case UDPPROTOCOL:
+            return CLASS_UDP;
+        default:
+            return CLASS_IP;
+    }
+}
+
+/*******************************************************************************
+* Function Name: ParseAddress
+********************************************************************************
+* Summary:
+*   Reads a MAC or IP address off the command line.
+*
+* Parameters:
+*   text - the address,as "00:a0:c9:14:c8:00" or "192.168.1.153".
+*   bytes - where to put it.
+*   count - bytes in it.
+*   separator - what comes between them.
+*   base - 16 or 10.
+*
+* Returns:
+*   TRUE(0) if it was read,FALSE(1) if it is not an address.
+*******************************************************************************/
+static unsigned char ParseAddress(const char* text, unsigned char* bytes, unsigned char count, char separator, unsigned char base){
+    unsigned char i;
+    unsigned long value;
+    char* end;
+
+    for (i = 0; i < count; i++){
+        value = strtoul(text, &end, base);
+        if ((end == text) || (value > 0xff) || (*end != ((i + 1 < count) ? separator : '\0'))){
+            return FALSE;
+        }
+        bytes[i] = (unsigned char)value;
+        text = end + 1;
+    }
+    return TRUE;
+}
+
+#if (HANDLER_PROF_ENABLED)
+/*******************************************************************************
+* Function Name: PrintHandlerProfile
+********************************************************************************
+* Summary:
+*   Prints the time GetPacket took in each protocol handler,see
+*   GetHandlerProfile,in virtual time.ProfTimer ticks are us here.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void PrintHandlerProfile(void){
+    HANDLERPROFILE profile;
+    HANDLERPROFENTRY* entry;
+    unsigned char h;
+    unsigned char b;
+    char label[16];
+
+    GetHandlerProfile(&profile);
+    printf("%-10s %8s %10s %10s", "Handler", "Packets", "us avg", "us max");
+    for (b = 0; b < HPROF_BUCKETS - 1; b++){
+        sprintf(label, "<%u", HPROF_BUCKET0 << b);
+        printf(" %9s", label);
+    }
+    printf(" %9s\n", "more");
+    for (h = 0; h < HPROF_HANDLERS; h++){
+        entry = &profile.Handler[h];
+        if (!entry->Count){
+            continue;
+        }
+        printf("%-10s %8lu %10.1f %10u", HandlerNames[h], (unsigned long)entry->Count,
+               (double)entry->Ticks / entry->Count, (unsigned)entry->MaxTicks);
+        for (b = 0; b < HPROF_BUCKETS; b++){
+            printf(" %9lu", (unsigned long)entry->Buckets[b]);
+        }
+        printf("\n");
+    }
+}
+#endif
+
+/*******************************************************************************
+* Function Name: HostNs
+********************************************************************************
+* Summary:
+*   Reads the host's monotonic clock.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nanoseconds,from some point in the past.
+*******************************************************************************/
+static uint64_t HostNs(void){
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/* [] END OF FILE */
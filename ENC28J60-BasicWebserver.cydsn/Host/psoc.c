@@ -0,0 +1,221 @@
+/*
+ Network Stack for PSoC3-ENC28J60 hardware
+ -----------------------------------------
+ Title  : Host stand-ins for the PSoC components
+ Description : The components declared in the host "device.h",on top of
+ the ENC28J60 model in "encsim.c".
+ The SPIM has a one byte TX latch and a 4 byte RX FIFO.A byte written to
+ the TX data register is clocked through the model on the next access to
+ the SPIM,so spi.h sees the same register behaviour as on the PSoC3.
+ SPI_DONE is sticky,as on the PSoC3:it is set when the shifter goes idle
+ after a byte,and cleared when the TX status is read.
+*/
+#define HOST_NATIVE
+#include <device.h>
+#include "encsim.h"
+
+/*Rate ProfTimer counts at.Has to match PROFTIMER_HZ in "enc28j60.h".*/
+#define SIMPROFTIMERHZ  1000000UL
+
+static uint8 HostBoard;
+static uint8 SpimTxLatch;
+static uint8 SpimTxPending;
+static uint8 SpimRxLatch;
+static uint8 SpimRxFifo[SPIM_RXBUFFERSIZE];
+static uint8 SpimRxHead;
+static uint8 SpimRxCount;
+static uint8 SpimDone;//SPI_DONE,latched till the TX status is read.
+
+static void SpimFlush(void);
+
+/*------------------------SPIM------------------------------------------*/
+uint8* SimSpimTxData(void){
+    SpimFlush();
+    SpimTxPending = 1;
+    return &SpimTxLatch;
+}
+
+uint8* SimSpimRxData(void){
+    SpimFlush();
+    if (SpimRxCount){
+        SpimRxLatch = SpimRxFifo[SpimRxHead];
+        SpimRxHead = (SpimRxHead + 1) % SPIM_RXBUFFERSIZE;
+        SpimRxCount--;
+    }
+    return &SpimRxLatch;
+}
+
+uint8 SimSpimTxStatus(void){
+    uint8 status = SPIM_STS_TX_FIFO_EMPTY | SPIM_STS_TX_FIFO_NOT_FULL;
+
+    SpimFlush();
+    if (SpimDone){
+        status |= SPIM_STS_SPI_DONE;
+        SpimDone = 0;
+    }
+    return status;
+}
+
+uint8 SimSpimRxStatus(void){
+    SpimFlush();
+    return SpimRxCount ? SPIM_STS_RX_FIFO_NOT_EMPTY : 0;
+}
+
+void SPIM_Start(void){
+    SpimTxPending = 0;
+    SpimRxCount = 0;
+    SpimDone = 0;
+}
+
+uint8 SPIM_ReadTxStatus(void){
+    return SimSpimTxStatus();
+}
+
+uint8 SPIM_ReadRxStatus(void){
+    return SimSpimRxStatus();
+}
+
+void SPIM_ClearRxBuffer(void){
+    SpimFlush();
+    SpimRxCount = 0;
+}
+
+void SPIM_SetTxInterruptMode(uint8 intSource){
+    (void)intSource;
+}
+
+void SPIM_SetRxInterruptMode(uint8 intSource){
+    (void)intSource;
+}
+
+/*------------------------DMA-------------------------------------------*/
+/*Nothing to hand out,so the rest are never called.*/
+uint8 SPI_TxDMA_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress){
+    return DMA_INVALID_CHANNEL;
+}
+
+uint8 SPI_RxDMA_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress){
+    return DMA_INVALID_CHANNEL;
+}
+
+void SPI_RxDone_StartEx(void (*isr)(void)){
+    (void)isr;
+}
+
+uint8 CyDmaTdAllocate(void){
+    return DMA_INVALID_TD;
+}
+
+cystatus CyDmaTdSetConfiguration(uint8 tdHandle, uint16 transferCount, uint8 nextTd, uint8 configuration){
+    return 1;
+}
+
+cystatus CyDmaTdSetAddress(uint8 tdHandle, uint16 source, uint16 destination){
+    return 1;
+}
+
+cystatus CyDmaChSetInitialTd(uint8 chHandle, uint8 startTd){
+    return 1;
+}
+
+cystatus CyDmaChEnable(uint8 chHandle, uint8 preserveTds){
+    return 1;
+}
+
+cystatus CyDmaChSetRequest(uint8 chHandle, uint8 request){
+    return 1;
+}
+
+/*------------------------Pins and the rest-----------------------------*/
+void SS_Write(uint8 value){
+    SpimFlush();
+    SimSelect(HostBoard, value);
+}
+
+uint8 PACKET_Read(void){
+    return SimIntPin(HostBoard);
+}
+
+uint8 PACKET_ClearInterrupt(void){
+    return 0;
+}
+
+void PACKET_ISR_StartEx(void (*isr)(void)){
+    SimSetIsr(HostBoard, isr);
+}
+
+void ProfTimer_Start(void){
+}
+
+uint16 ProfTimer_ReadCounter(void){
+    /*A 16 bit down counter,running off the virtual time.*/
+    return (uint16)(0xffff - (uint16)(SimNow() / (1000000000ULL / SIMPROFTIMERHZ)));
+}
+
+void CyDelay(uint32 milliseconds){
+    while (milliseconds--){
+        SimAdvance(1000000UL);
+    }
+}
+
+void CyDelayUs(uint16 microseconds){
+    SimAdvance((uint32)microseconds * 1000UL);
+}
+
+void LCD_Start(void){
+}
+
+void LCD_Position(uint8 row, uint8 column){
+    (void)row;
+    (void)column;
+}
+
+void LCD_PrintString(const char* string){
+    printf("LCD: %s\n", string);
+}
+
+void DieTemp_GetTemp(int16* temperature){
+    *temperature = 25;
+}
+
+void HostSetBoard(uint8 board){
+    /*Boards only change between SPI transactions,so each board's SPIM would
+    be idle.They share this one.*/
+    SpimFlush();
+    SpimRxCount = 0;
+    HostBoard = board;
+}
+
+/*------------------------Private Functions-----------------------------*/
+
+/*******************************************************************************
+* Function Name: SpimFlush
+********************************************************************************
+* Summary:
+*   Clocks the byte waiting in the TX latch through the model,and puts what
+*   comes back in the RX FIFO.Like the SPIM,a full RX FIFO loses the byte.
+*   The shifter is idle after it,as there is only one byte of TX latch,so
+*   SPI_DONE is latched.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void SpimFlush(void){
+    uint8 miso;
+
+    if (!SpimTxPending){
+        return;
+    }
+    SpimTxPending = 0;
+    miso = SimSpiByte(SpimTxLatch);
+    if (SpimRxCount < SPIM_RXBUFFERSIZE){
+        SpimRxFifo[(SpimRxHead + SpimRxCount) % SPIM_RXBUFFERSIZE] = miso;
+        SpimRxCount++;
+    }
+    SpimDone = 1;
+}
+
+/* [] END OF FILE */
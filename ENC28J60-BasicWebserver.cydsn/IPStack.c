@@ -11,8 +11,25 @@
 
 #include "IPStackMain.h"
 #include <string.h>
+#include <stddef.h>
 #include <device.h>
 
+/*The ENC28J60 the stack runs on.*/
+ENC28J60 ethDevice;
+
+#if (HANDLER_PROF_ENABLED)
+/*Handler profile,see GetHandlerProfile.HProfStart is the ProfTimer count
+GetPacket was called at.*/
+static HANDLERPROFILE HProf;
+static unsigned int HProfStart;
+static void HProfRecord(unsigned char handler);
+#define HPROF_BEGIN()       HProfStart = ProfTimer_ReadCounter()
+#define HPROF_END(handler)  HProfRecord(handler)
+#else
+#define HPROF_BEGIN()
+#define HPROF_END(handler)
+#endif
+
 /*******************************************************************************
 * Function Name: add32
 ********************************************************************************
@@ -130,6 +147,32 @@ uint16 checksum(unsigned char *buf, unsigned int len,unsigned char type){
     return((uint16)(sum ^ 0xFFFF));
 }
 
+/*******************************************************************************
+* Function Name: checksumUpdate
+********************************************************************************
+* Summary:
+*   Updates a checksum after one 16 bit word of the data it covers has
+*   changed,without summing up all the data again.See RFC 1624.
+*
+* Parameters:
+*   sum - the checksum,as it is in the packet.
+*   oldWord - the word,as it was.
+*   newWord - the word,as it is now.
+*            
+* Returns:
+*   16 bit checksum.
+*******************************************************************************/
+uint16 checksumUpdate(uint16 sum, uint16 oldWord, uint16 newWord){
+    uint32 acc;
+    
+    /*HC' = ~(~HC + ~m + m')*/
+    acc = (uint32)(uint16)~sum + (uint16)~oldWord + newWord;
+    while (acc>>16){
+        acc = (acc & 0xFFFF)+(acc >> 16);
+    }
+    return((uint16)(acc ^ 0xFFFF));
+}
+
 /*******************************************************************************
 * Function Name: SetupBasicIPPacket
 ********************************************************************************
@@ -180,6 +223,149 @@ void SetupBasicIPPacket( unsigned char* packet, unsigned char proto, unsigned ch
     ip->chksum = 0x00;
 }
 
+/*******************************************************************************
+* Function Name: SetInnerChksum
+********************************************************************************
+* Summary:
+*   Stores the ICMP,UDP or TCP checksum of a packet,through the chksum field
+*   of its header,so it goes out in network byte order.
+*
+* Parameters:
+*   ip - the packet.Its protocol says which header it has.
+*   value - what to store.
+*             
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void SetInnerChksum(IPhdr* ip, unsigned int value){
+    if ( ip->protocol == ICMPPROTOCOL ){
+        ((ICMPhdr*)ip)->chksum = value;
+    }else if ( ip->protocol == UDPPROTOCOL ){
+        ((UDPhdr*)ip)->chksum = value;
+    }else if ( ip->protocol == TCPPROTOCOL ){
+        ((TCPhdr*)ip)->chksum = value;
+    }
+}
+
+/*******************************************************************************
+* Function Name: SendIPPacket
+********************************************************************************
+* Summary:
+*   Fills in the IP header checksum,and the ICMP,UDP or TCP checksum of
+*   what it carries,and sends the packet.
+*   With CSUM_OFFLOAD,the checksums are worked out by the ENC28J60 once the
+*   packet is in its TX buffer,instead of here.
+*
+* Parameters:
+*   packet - pointer to the packet,with its IP length field set.
+*   len - length of the whole packet.
+*   queue - If this is 1,the packet is queued and this returns straight away.
+*           If this is 0,this waits for the packet to go out.
+*             
+* Returns:
+*   TRUE(0)- if the packet was sent(or queued).
+*   FALSE(1) - if it was not.
+*******************************************************************************/
+unsigned char SendIPPacket(unsigned char* packet, unsigned int len, unsigned char queue){
+    IPhdr* ip = (IPhdr*)packet;
+    unsigned int start = 0;//Start of the range covered by the inner checksum.
+    unsigned int field = 0;//Offset of the inner checksum field,0 if there is none.
+    unsigned char type = 0;//Type of the inner checksum,as for checksum().
+#if (CSUM_OFFLOAD)
+    CSUMSPEC csum[2];
+    uint32 seed;
+#endif
+    
+    /*Work out what the inner checksum covers.
+    For UDP and TCP,it starts at the source IP,as that is part of the pseudoheader.*/
+    if ( ip->protocol == ICMPPROTOCOL ){
+        start = sizeof(IPhdr);
+        field = offsetof(ICMPhdr, chksum);
+    }else if ( ip->protocol == UDPPROTOCOL ){
+        start = offsetof(IPhdr, source);
+        field = offsetof(UDPhdr, chksum);
+        type = 1;
+    }else if ( ip->protocol == TCPPROTOCOL ){
+        start = offsetof(IPhdr, source);
+        field = offsetof(TCPhdr, chksum);
+        type = 2;
+    }
+    
+    /*Zero out the checksums*/
+    ip->chksum = 0x00;
+    SetInnerChksum(ip, 0x00);
+    
+#if (CSUM_OFFLOAD)
+    /*The IP header checksum.*/
+    csum[0].start = sizeof(EtherNetII);
+    csum[0].end = sizeof(IPhdr) - 1;
+    csum[0].field = offsetof(IPhdr, chksum);
+    if ( !field ){
+        return(queue ? MACQueueCsum(&ethDevice, packet, len, csum, 1, 0) : MACWriteCsum(&ethDevice, packet, len, csum, 1));
+    }
+    
+    /*The inner one.The pseudoheader fields that are not in the packet,
+    the protocol and the length,are seeded into its checksum field.*/
+    if ( type ){
+        seed = (uint32)ip->protocol + (len - sizeof(IPhdr));
+        seed = (seed & 0xFFFF) + (seed >> 16);
+        SetInnerChksum(ip, (unsigned int)seed);
+    }
+    csum[1].start = start;
+    csum[1].end = len - 1;
+    csum[1].field = field;
+    
+    return(queue ? MACQueueCsum(&ethDevice, packet, len, csum, 2, 0) : MACWriteCsum(&ethDevice, packet, len, csum, 2));
+#else
+    /*Compute the checksums*/
+    ip->chksum = checksum(packet + sizeof(EtherNetII), sizeof(IPhdr) - sizeof(EtherNetII), 0);
+    if ( field ){
+        SetInnerChksum(ip, checksum(packet + start, len - start, type));
+    }
+    
+    return(queue ? MACQueue(&ethDevice, packet, len, 0) : MACWrite(&ethDevice, packet, len));
+#endif
+}
+
+/*******************************************************************************
+* Function Name: WantPacket
+********************************************************************************
+* Summary:
+*   Looks at the headers of a packet that has just come in,and decides
+*   if GetPacket has anything to do with it.
+*
+* Parameters:
+*   proto -  Protocol type that the caller of GetPacket wants.
+*   packet - pointer to the headers of the packet.
+*             
+* Returns:
+*   TRUE if the packet is needed,FALSE if it can be dropped unread.
+*******************************************************************************/
+static unsigned char WantPacket( int proto, unsigned char* packet ){
+    EtherNetII* eth = (EtherNetII*)packet;
+    
+    if ( eth->type == (ARPPACKET) ){
+        /*We only answer requests.*/
+        if ( ((ARP*)packet)->opCode == (ARPREQUEST) ){
+            return TRUE;
+        }
+    } else if ( eth->type == (IPPACKET) ){
+        IPhdr* ip = (IPhdr*)packet;
+        
+        if ( (ip->protocol == ICMPPROTOCOL) || (ip->protocol == UDPPROTOCOL) || (ip->protocol == proto) ){
+            return TRUE;
+        }
+        if ( ip->protocol == TCPPROTOCOL ){
+            TCPhdr* Pack = (TCPhdr*)packet;
+            if ( (Pack->destPort == WWWPort) || (Pack->destPort == WClientPort) ){
+                return TRUE;
+            }
+        }
+    }
+    
+    return FALSE;
+}
+
 /*******************************************************************************
 * Function Name: GetPacket
 ********************************************************************************
@@ -203,20 +389,50 @@ void SetupBasicIPPacket( unsigned char* packet, unsigned char proto, unsigned ch
 *******************************************************************************/
 unsigned int GetPacket( int proto, unsigned char* packet ){ 
     unsigned int len;
+    unsigned int sent;
+    EtherNetII* eth = (EtherNetII*)packet;
+    ICMPhdr* ping = (ICMPhdr*)packet;
+    HPROF_BEGIN();
    
-    /*Did we get any packets?*/
-    if ( len = MACRead( packet, MAXPACKETLEN ) ){
+    /*Did we get any packets?Look at the headers first.*/
+    if ( (len = MACPeek( &ethDevice, packet, sizeof(TCPhdr) )) ){
     
-        /*Lets check if its an ARP packet.*/
-        EtherNetII* eth = (EtherNetII*)packet;
+        if ( WantPacket( proto, packet ) != TRUE ){
+            /*None of our business,so leave the rest of it where it is.*/
+            MACDiscard(&ethDevice);
+            return 0;
+        }
+        
+        /*Ping requests are echoed from where they sit in the ENC28J60,
+        so there is no need to bring them in.*/
+        if ( (eth->type == (IPPACKET)) && (ping->ip.protocol == ICMPPROTOCOL) && (ping->type == ICMPREQUEST) ){
+            /*Someone has pinged us,lets reply.*/
+            sent = PingReply(ping, len);
+            MACDiscard(&ethDevice);
+            HPROF_END(HPROF_PING);
+            return sent;
+        }
         
+        /*Bring in the rest of it.*/
+        if ( len > MAXPACKETLEN ){
+            len = MAXPACKETLEN;
+            MACTruncated(&ethDevice);
+        }
+        if ( len > sizeof(TCPhdr) ){
+            MACReadAt( &ethDevice, sizeof(TCPhdr), packet + sizeof(TCPhdr), len - sizeof(TCPhdr) );
+        }
+        MACDiscard(&ethDevice);
+    
+        /*Lets check if its an ARP packet.*/
         if ( eth->type == (ARPPACKET) ){
             /*Its an ARP Packet.*/
             ARP* arpPacket = (ARP*)packet;
             if ( arpPacket->opCode == (ARPREQUEST)){
                 /*We have recd. an ARP Request,and
                   we should reply.*/
-                return(ReplyArpRequest(arpPacket));
+                sent = ReplyArpRequest(arpPacket);
+                HPROF_END(HPROF_ARP);
+                return sent;
             }
         } else if( eth->type == (IPPACKET) ){/*Is it an IP Packet?*/
         /*Its an IP Packet,so we should go ahead and check its
@@ -226,11 +442,7 @@ unsigned int GetPacket( int proto, unsigned char* packet ){
         
             /*PING PACKET HANDLER*/
             if( (ip->protocol == ICMPPROTOCOL) ){
-                ICMPhdr* ping = (ICMPhdr*)packet;
-                if(ping->type==ICMPREQUEST){
-                    /*Someone has pinged us,lets reply.*/
-                    return(PingReply((ICMPhdr*)packet, len));
-                }else if(ping->type==ICMPREPLY){
+                if(ping->type==ICMPREPLY){
                 /*We have recd. Ping replies.
                 (Did we ping someone?)
                 Process them.*/
@@ -245,15 +457,21 @@ unsigned int GetPacket( int proto, unsigned char* packet ){
 					if(Pack->SYN==1){
 						/*Its a SYN from a Client.*/
 						/*Reply with a SYNACK*/
-						return(ackTcp(Pack,(Pack->ip.len)+14,1,0,0,0));
+						sent = ackTcp(Pack,(Pack->ip.len)+14,1,0,0,0);
+						HPROF_END(HPROF_WEBSERVER);
+						return sent;
 			  		}else if((Pack->PSH==1)&&(Pack->ACK==1)){
 						/*We have recd. a request from a Client.*/
 						/*Set flag to fire a reply*/
-						return(WebServer_ProcessRequest(Pack));
+						sent = WebServer_ProcessRequest(Pack);
+						HPROF_END(HPROF_WEBSERVER);
+						return sent;
 					}else if((Pack->FIN==1)){
 						/*We've got a FIN(ACK?) from a client.*/
 						/*ACK that,and thats the end of a connection*/
-						return(ackTcp(Pack,(Pack->ip.len)+14,0,0,0,0));
+						sent = ackTcp(Pack,(Pack->ip.len)+14,0,0,0,0);
+						HPROF_END(HPROF_WEBSERVER);
+						return sent;
 					}	
 			  }
 			/*<=============WEBSERVER HANDLER END====================>*/
@@ -279,6 +497,7 @@ unsigned int GetPacket( int proto, unsigned char* packet ){
 						ackTcp(Pack,(Pack->ip.len)+14,0,0,0,0);
 					}
 				}
+				HPROF_END(HPROF_WEBCLIENT);
 			}
 			/*<=============WEBCLIENT HANDLER END====================>*/            
 			}
@@ -293,16 +512,16 @@ unsigned int GetPacket( int proto, unsigned char* packet ){
 			if( ip->protocol == UDPPROTOCOL){
 				UDPPacket* UDPPtr = (UDPPacket*)packet;
 				UDP_ProcessIncoming(UDPPtr);
+				HPROF_END(HPROF_UDP);
 				return 1;
 			}
         	/*<------------UDP HANDLER END------------------------------>*/
 			
-   
+        }
     }
     
     return 0;
 }
-}
 
 
 /*******************************************************************************
@@ -320,13 +539,15 @@ unsigned int GetPacket( int proto, unsigned char* packet ){
 *******************************************************************************/
 void IPstackIdle(void){
     unsigned char packet[MAXPACKETLEN];
-    TCPhdr* TCPacket = (TCPhdr*)packet;
     
     /*Check if Link is Up*/
-    if(IsLinkUp()==0){
+    if(IsLinkUp(&ethDevice)==0){
         return;
     }
     
+    /*Move the TX queue along*/
+    MACService(&ethDevice);
+    
     /*Nothing specific,just field the Pings and ARP Requests,SYN handshakes and GETs*/
     GetPacket(0,packet);
 	
@@ -339,6 +560,31 @@ void IPstackIdle(void){
 
 }
 
+/*******************************************************************************
+* Function Name: SwapAddresses
+********************************************************************************
+* Summary:
+*   Turns the addresses of a recd. packet round,so it can be sent back as
+*   the reply.The source MAC and IP Addresses become the destination ones,
+*   and ours are put in as the source.
+*   Swapping the addresses leaves the IP checksum as it is.
+*
+* Parameters:
+*   ip - pointer to the IP header of the packet.
+*             
+* Returns:
+*   none.
+*******************************************************************************/
+void SwapAddresses(IPhdr* ip){
+    /*Swap the MAC Addresses in the ETH header*/
+    memcpy( ip->eth.DestAddrs, ip->eth.SrcAddrs, 6 );
+    memcpy( ip->eth.SrcAddrs, deviceMAC, 6 );
+  
+    /*Swap the IP Addresses in the IP header*/
+    memcpy( ip->dest, ip->source, 4 );
+    memcpy( ip->source, deviceIP, 4 );
+}
+
 /*******************************************************************************
 * Function Name: ackTcp
 ********************************************************************************
@@ -353,7 +599,8 @@ void IPstackIdle(void){
 *             If this is 0,then its a bare-bones ACK.
 *             
 * Returns:
-*   The length of ACK packet made.
+*   TRUE(0)- if the ACK was queued for transmission.
+*   FALSE(1) - if it could not be queued.
 *******************************************************************************/
 unsigned int ackTcp(TCPhdr* tcp, unsigned int len,unsigned char syn_val,unsigned char fin_val,unsigned char rst_val,unsigned int psh_val){
     char ack[4];
@@ -361,17 +608,8 @@ unsigned int ackTcp(TCPhdr* tcp, unsigned int len,unsigned char syn_val,unsigned
     unsigned char dlength=0;
     unsigned char* datptr;
   
-    /*Zero out the checksum fields*/
-    tcp->chksum = 0x0;
-    tcp->ip.chksum = 0x0;
-  
-    /*Swap the MACs in the ETH header*/
-    memcpy( tcp->ip.eth.DestAddrs, tcp->ip.eth.SrcAddrs, 6 );
-    memcpy( tcp->ip.eth.SrcAddrs, deviceMAC, 6 );
-  
-    /*Swap the IP Addresses in the IP header*/
-    memcpy( tcp->ip.dest, tcp->ip.source, 4 );
-    memcpy( tcp->ip.source, deviceIP, 4 );
+    /*Swap the MAC and IP Addresses*/
+    SwapAddresses(&tcp->ip);
   
     /*Swap the Ports in the TCP header*/
     destPort = tcp->destPort;
@@ -425,11 +663,8 @@ unsigned int ackTcp(TCPhdr* tcp, unsigned int len,unsigned char syn_val,unsigned
     /*IP Length field.*/
     tcp->ip.len = (len-sizeof(EtherNetII));
     
-    /*Compute the checksums*/
-    tcp->ip.chksum=checksum((unsigned char*)tcp + sizeof(EtherNetII),sizeof(IPhdr)-sizeof(EtherNetII),0);
-    tcp->chksum = checksum((unsigned char*)tcp->ip.source,0x08+0x14+dlength,2);
-
-    return(MACWrite((unsigned char*)tcp,len));
+    /*Queue it,so that whatever we send next can be loaded while it goes out.*/
+    return(SendIPPacket((unsigned char*)tcp,len,1));
 }
 
 /*******************************************************************************
@@ -450,7 +685,8 @@ unsigned int ackTcp(TCPhdr* tcp, unsigned int len,unsigned char syn_val,unsigned
 *             
 * Returns:
 *   TRUE(0)- if the initialization was successful,and routerMAC has been updated properly.
-*   FALSE(1) - if the initialization(ARP for Router MAC) was not successful.
+*   FALSE(1) - if the initialization(ARP for Router MAC) was not successful,
+*              or the chip did not come out of reset.
 *******************************************************************************/
 unsigned int IPstack_Start(unsigned char devMAC[6],unsigned char devIP[4]){  
     unsigned int i = 0;
@@ -461,10 +697,19 @@ unsigned int IPstack_Start(unsigned char devMAC[6],unsigned char devIP[4]){
     memcpy(deviceIP,devIP,4);
 
     /*Initialize SPI and the Chip's memory,PHY etc.*/
-    initMAC( deviceMAC );
+    if( initMAC( &ethDevice, SS_Write, deviceMAC, MEMLAYOUT_PROFILE ) != TRUE ){
+        return FALSE;
+    }
+#if (HANDLER_PROF_ENABLED)
+    ProfTimer_Start();
+#endif
     
-    /*Check if Link is Up*/
-    if(IsLinkUp()==0){
+    /*The chip is up in a few ms,but the link can take longer to come up.
+    Wait for it,for up to LINKUPWAIT ms.*/
+    for(i=0; (IsLinkUp(&ethDevice)==0) && (i < LINKUPWAIT); i++){
+        CyDelay(1);
+    }
+    if(IsLinkUp(&ethDevice)==0){
         return FALSE;
     }
     
@@ -473,7 +718,7 @@ unsigned int IPstack_Start(unsigned char devMAC[6],unsigned char devIP[4]){
     
     /*Lets wait for the reply*/
     for(i=0; i < 0x5fff; i++){
-        if( MACRead( (unsigned char*) &arpPacket, sizeof(ARP) )!=0 ){
+        if( MACRead( &ethDevice, (unsigned char*) &arpPacket, sizeof(ARP) )!=0 ){
             if( (arpPacket.eth.type == (ARPPACKET))&& (arpPacket.opCode == (ARPREPLY)) && (!memcmp( arpPacket.senderIP, routerIP, sizeof(routerIP) )) ){
                 /*Aha! The router sends back its MAC.Copy it into our appropriate global var.*/
                 memcpy( routerMAC, arpPacket.senderMAC, sizeof(routerMAC) );
@@ -484,5 +729,83 @@ unsigned int IPstack_Start(unsigned char devMAC[6],unsigned char devIP[4]){
     return FALSE;
 }
 
+/*******************************************************************************
+* Function Name: GetHandlerProfile
+********************************************************************************
+* Summary:
+*   Takes a copy of the handler profile:for each protocol handler in
+*   GetPacket,how many packets it handled,the ProfTimer ticks they took,
+*   and a histogram of them.A packet is timed from GetPacket being called
+*   to it returning,so reading the packet in,and sending whatever reply,
+*   are counted.Packets GetPacket passes back to its caller,or drops,are
+*   not counted.
+*   Reset it,run a workload,then take a copy to see which handler holds
+*   up the main loop.
+*   All zeros unless HANDLER_PROF_ENABLED is set.
+*
+* Parameters:
+*   profile - where to put it.
+*
+* Returns:
+*   none.
+*******************************************************************************/
+void GetHandlerProfile(HANDLERPROFILE* profile){
+#if (HANDLER_PROF_ENABLED)
+    *profile = HProf;
+#else
+    memset(profile, 0, sizeof(HANDLERPROFILE));
+#endif
+}
+
+/*******************************************************************************
+* Function Name: ResetHandlerProfile
+********************************************************************************
+* Summary:
+*   Sets the handler profile back to zero.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   none.
+*******************************************************************************/
+void ResetHandlerProfile(void){
+#if (HANDLER_PROF_ENABLED)
+    memset(&HProf, 0, sizeof(HProf));
+#endif
+}
+
+#if (HANDLER_PROF_ENABLED)
+/*******************************************************************************
+* Function Name: HProfRecord
+********************************************************************************
+* Summary:
+*   Puts the time since GetPacket was called down to the handler that
+*   dealt with the packet.
+*
+* Parameters:
+*   handler - the handler,HPROF_ARP etc.
+*
+* Returns:
+*   none.
+*******************************************************************************/
+static void HProfRecord(unsigned char handler){
+    unsigned int ticks;
+    unsigned char bucket;
+    HANDLERPROFENTRY* entry = &HProf.Handler[handler];
+    
+    /*ProfTimer counts down.*/
+    ticks = HProfStart - ProfTimer_ReadCounter();
+    entry->Count++;
+    entry->Ticks += ticks;
+    if (ticks > entry->MaxTicks){
+        entry->MaxTicks = ticks;
+    }
+    for (bucket = 0; (bucket < (HPROF_BUCKETS - 1)) && (ticks >= ((unsigned int)HPROF_BUCKET0 << bucket)); bucket++){
+    }
+    entry->Buckets[bucket]++;
+}
+#endif
+
 
 /* [] END OF FILE */
\ No newline at end of file
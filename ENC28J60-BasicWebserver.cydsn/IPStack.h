@@ -16,6 +16,34 @@
 /*Maximum length of packet that the device will entertain*/
 #define MAXPACKETLEN 600
 
+/*Split of the ENC28J60's buffer between RX and TX,passed to initMAC.
+See MEMLAYOUT in "enc28j60.h" for the profiles available.*/
+#define MEMLAYOUT_PROFILE (&MemLayoutBalanced)
+
+/*Longest IPstack_Start waits for the link to come up,in ms.*/
+#define LINKUPWAIT 2000
+
+/*The ENC28J60 the stack runs on,set up by IPstack_Start.
+Its chip select is the pin called "SS".
+The stack is single-port:its functions all use this handle,and its own
+state(deviceMAC,deviceIP and the rest in "globals.c")is kept once,for
+this chip only.
+Other chips on the same SPI bus can be driven with the "enc28j60.h"
+functions on handles of their own,but the stack will not answer on them.*/
+extern ENC28J60 ethDevice;
+
+/*Set to 1 to have the ENC28J60's DMA engine work out the checksums of the
+packets we send,see SendIPPacket.Set to 0 to do them on the 8051.
+The Silicon Errata warns that packets coming in while the DMA engine works
+out a checksum can be lost,so it is off unless losing some is acceptable.*/
+#define CSUM_OFFLOAD 0
+
+/*Set to 1 to time the protocol handlers in GetPacket,see GetHandlerProfile.
+This needs the "ProfTimer" of SPI_PROF_ENABLED,see "enc28j60.h",and times
+are in its ticks.It is 16 bits,so at 1MHz a handler that takes longer
+than 65ms is not timed right.*/
+#define HANDLER_PROF_ENABLED 0
+
 /*UDP Port for DNS Lookup*/
 #define DNSUDPPORT 53
 
@@ -40,6 +68,31 @@
 #define ETHERNET 0x0001
 
 
+/*Handler profile,see GetHandlerProfile.*/
+#define HPROF_BUCKETS   10//Buckets in each histogram.
+#define HPROF_BUCKET0   32//ProfTimer ticks the first bucket goes up to.
+
+typedef struct {
+    unsigned long Count;//Packets handled.
+    unsigned long Ticks;//ProfTimer ticks spent on them.
+    unsigned int MaxTicks;//Longest one.
+    /*Packets that took under HPROF_BUCKET0 ticks,then under twice that,
+    and so on,doubling each time.The last bucket has all the rest.*/
+    unsigned long Buckets[HPROF_BUCKETS];
+} HANDLERPROFENTRY;
+
+/*Index into HANDLERPROFILE.Handler,what GetPacket did with the packet.*/
+#define HPROF_ARP       0//Answered an ARP request.
+#define HPROF_PING      1//Echoed a Ping request.
+#define HPROF_WEBSERVER 2//TCP to WWWPort,the webserver.
+#define HPROF_WEBCLIENT 3//TCP to WClientPort from serverIP,the webclient.
+#define HPROF_UDP       4//Passed UDP to UDP_ProcessIncoming.
+#define HPROF_HANDLERS  5
+
+typedef struct {
+    HANDLERPROFENTRY Handler[HPROF_HANDLERS];
+} HANDLERPROFILE;
+
 /*Struct for ETH header*/
 typedef struct
 {
@@ -63,12 +116,18 @@ typedef struct
   unsigned char targetIP[4];
 } ARP;
 
-/*Struct for IP header*/
+/*Struct for IP header
+Bit fields are least significant bit first,see TXSTATUS in "enc28j60.h".*/
 typedef struct
 {
   EtherNetII eth;
+#if defined(BITFIELDS_MSB_FIRST)
+  unsigned char version : 4;
+  unsigned char hdrlen : 4;
+#else
   unsigned char hdrlen : 4;
   unsigned char version : 4;
+#endif
   unsigned char diffsf;
   unsigned int len;
   unsigned int ident;  
@@ -88,6 +147,19 @@ typedef struct
   unsigned int destPort;
   unsigned char seqNo[4];
   unsigned char ackNo[4];
+#if defined(BITFIELDS_MSB_FIRST)
+  unsigned char hdrLen : 4;
+  unsigned char reserverd : 3;
+  unsigned char NS:1;
+  unsigned char CWR:1;
+  unsigned char ECE:1;
+  unsigned char URG:1;
+  unsigned char ACK:1;
+  unsigned char PSH:1;
+  unsigned char RST:1;
+  unsigned char SYN:1;
+  unsigned char FIN:1;
+#else
   unsigned char NS:1;
   unsigned char reserverd : 3;
   unsigned char hdrLen : 4;
@@ -99,6 +171,7 @@ typedef struct
   unsigned char URG:1;
   unsigned char ECE:1;
   unsigned char CWR:1;
+#endif
   unsigned int wndSize;
   unsigned int chksum;
   unsigned int urgentPointer;
@@ -169,7 +242,8 @@ typedef struct
 *             
 * Returns:
 *   TRUE(0)- if the initialization was successful,and routerMAC has been updated properly.
-*   FALSE(1) - if the initialization(ARP for Router MAC) was not successful.
+*   FALSE(1) - if the initialization(ARP for Router MAC) was not successful,
+*              or the chip did not come out of reset.
 *******************************************************************************/
 unsigned int IPstack_Start(unsigned char deviceMAC[6],unsigned char deviceIP[4]);
 
@@ -188,6 +262,42 @@ unsigned int IPstack_Start(unsigned char deviceMAC[6],unsigned char deviceIP[4])
 *******************************************************************************/
 void IPstackIdle(void);
 
+/*******************************************************************************
+* Function Name: GetHandlerProfile
+********************************************************************************
+* Summary:
+*   Takes a copy of the handler profile:for each protocol handler in
+*   GetPacket,how many packets it handled,the ProfTimer ticks they took,
+*   and a histogram of them.A packet is timed from GetPacket being called
+*   to it returning,so reading the packet in,and sending whatever reply,
+*   are counted.Packets GetPacket passes back to its caller,or drops,are
+*   not counted.
+*   Reset it,run a workload,then take a copy to see which handler holds
+*   up the main loop.
+*   All zeros unless HANDLER_PROF_ENABLED is set.
+*
+* Parameters:
+*   profile - where to put it.
+*
+* Returns:
+*   none.
+*******************************************************************************/
+void GetHandlerProfile(HANDLERPROFILE* profile);
+
+/*******************************************************************************
+* Function Name: ResetHandlerProfile
+********************************************************************************
+* Summary:
+*   Sets the handler profile back to zero.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   none.
+*******************************************************************************/
+void ResetHandlerProfile(void);
+
 /*******************************************************************************
 * Function Name: add32
 ********************************************************************************
@@ -236,6 +346,23 @@ void add32(unsigned char *op32, unsigned int op16);
 *******************************************************************************/
 uint16 checksum(uint8 *buf, uint16 len,uint8 type);
 
+/*******************************************************************************
+* Function Name: checksumUpdate
+********************************************************************************
+* Summary:
+*   Updates a checksum after one 16 bit word of the data it covers has
+*   changed,without summing up all the data again.See RFC 1624.
+*
+* Parameters:
+*   sum - the checksum,as it is in the packet.
+*   oldWord - the word,as it was.
+*   newWord - the word,as it is now.
+*            
+* Returns:
+*   16 bit checksum.
+*******************************************************************************/
+uint16 checksumUpdate(uint16 sum, uint16 oldWord, uint16 newWord);
+
 /*******************************************************************************
 * Function Name: SetupBasicIPPacket
 ********************************************************************************
@@ -254,6 +381,44 @@ uint16 checksum(uint8 *buf, uint16 len,uint8 type);
 *******************************************************************************/
 void SetupBasicIPPacket( unsigned char* packet, unsigned char proto, unsigned char* destIP);
 
+/*******************************************************************************
+* Function Name: SwapAddresses
+********************************************************************************
+* Summary:
+*   Turns the addresses of a recd. packet round,so it can be sent back as
+*   the reply.The source MAC and IP Addresses become the destination ones,
+*   and ours are put in as the source.
+*   Swapping the addresses leaves the IP checksum as it is.
+*
+* Parameters:
+*   ip - pointer to the IP header of the packet.
+*             
+* Returns:
+*   none.
+*******************************************************************************/
+void SwapAddresses(IPhdr* ip);
+
+/*******************************************************************************
+* Function Name: SendIPPacket
+********************************************************************************
+* Summary:
+*   Fills in the IP header checksum,and the ICMP,UDP or TCP checksum of
+*   what it carries,and sends the packet.
+*   With CSUM_OFFLOAD,the checksums are worked out by the ENC28J60 once the
+*   packet is in its TX buffer,instead of here.
+*
+* Parameters:
+*   packet - pointer to the packet,with its IP length field set.
+*   len - length of the whole packet.
+*   queue - If this is 1,the packet is queued and this returns straight away.
+*           If this is 0,this waits for the packet to go out.
+*             
+* Returns:
+*   TRUE(0)- if the packet was sent(or queued).
+*   FALSE(1) - if it was not.
+*******************************************************************************/
+unsigned char SendIPPacket(unsigned char* packet, unsigned int len, unsigned char queue);
+
 
 /*******************************************************************************
 * Function Name: GetPacket
@@ -291,7 +456,8 @@ unsigned int GetPacket( int proto, unsigned char* packet );
 *             If this is 0,then its a bare-bones ACK.
 *             
 * Returns:
-*   The length of ACK packet made.
+*   TRUE(0)- if the ACK was queued for transmission.
+*   FALSE(1) - if it could not be queued.
 *******************************************************************************/
 unsigned int ackTcp(TCPhdr* tcp, unsigned int len,unsigned char syn_val,unsigned char fin_val,unsigned char rst_val,unsigned int psh_val);
 
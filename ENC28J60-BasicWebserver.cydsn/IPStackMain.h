@@ -20,6 +20,7 @@
 #include "DNS.h"
 #include "Webserver.h"
 #include "Webclient.h"
+#include "Bench.h"
 #include "globals.h"
 
 
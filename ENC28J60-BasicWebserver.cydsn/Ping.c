@@ -15,37 +15,31 @@
 ********************************************************************************
 * Summary:
 *   Generate and send a Ping reply from a received request.
+*   The request must still be open in the ENC28J60(see MACPeek),since only
+*   the headers are sent over SPI,and the rest is copied across in the chip.
 *
 * Parameters:
-*   ping - A pointer of type ICMPhdr,to the received request's packet.
+*   ping - A pointer of type ICMPhdr,to the received request's headers.
 *   len - length of the recd. Ping request.          
 * Returns:
-*   TRUE(0)- if the Ping Reply was successfully sent.
-*   FALSE(1) - if the Ping Reply was not successful in transmission.
+*   TRUE(0)- if the Ping Reply was queued for transmission.
+*   FALSE(1) - if it could not be queued.
 *******************************************************************************/
 unsigned int PingReply(ICMPhdr* ping,unsigned int len){
 
-    if ( ping->type == ICMPREQUEST ){
+    if ( (ping->type == ICMPREQUEST) && (len >= sizeof(ICMPhdr)) ){
    /*Yes,it is a Request,lets reply.*/
-   /*Setup the packet as a reply*/
+   /*Setup the packet as a reply.
+   Only the type changes in what the ICMP checksum covers,so patch that in.*/
     ping->type = ICMPREPLY;
-    ping->chksum = 0x0;
-    ping->ip.chksum = 0x0;
+    ping->chksum = checksumUpdate(ping->chksum, ((unsigned int)ICMPREQUEST << 8) | ping->codex, ((unsigned int)ICMPREPLY << 8) | ping->codex);
     
-    /*Swap the MAC Addresses in the ETH header*/
-    memcpy( ping->ip.eth.DestAddrs, ping->ip.eth.SrcAddrs, 6);
-    memcpy( ping->ip.eth.SrcAddrs, deviceMAC,6 );
+    /*Swap the MAC and IP Addresses.That leaves the IP checksum as it is.*/
+    SwapAddresses(&ping->ip);
     
-    /*Swap the IP Addresses in the IP header*/
-    memcpy( ping->ip.dest, ping->ip.source,4);
-    memcpy( ping->ip.source, deviceIP,4);
-    
-    /*Compute the checksums*/
-    ping->chksum=checksum(((unsigned char*) ping) + sizeof(IPhdr ),len - sizeof(IPhdr),0);
-    ping->ip.chksum = checksum(((unsigned char*) ping) + sizeof(EtherNetII),sizeof(IPhdr) - sizeof(EtherNetII),0);
-    
-    /*Send it!*/
-    return(MACWrite((unsigned char*) ping, len));
+    /*The request is still in the ENC28J60,so have it copied across there,
+    with just the new headers written over it.*/
+    return(MACQueueFromRx(&ethDevice, (unsigned char*) ping, sizeof(ICMPhdr), 0, 0, 0));
   }
   return FALSE;
 }
@@ -68,33 +62,30 @@ unsigned int PingReply(ICMPhdr* ping,unsigned int len){
 unsigned int SendPing( unsigned char* targetIP ){
     unsigned int i;
     
-    /*declare an ICMP header for our ping request packet*/
-    ICMPhdr ping;
+    /*declare a buffer for our ping request packet,the ICMP header
+      followed by the 18 bytes of dummy data*/
+    unsigned char packet[sizeof(ICMPhdr)+18];
+    ICMPhdr* ping = (ICMPhdr*)packet;
     
     /*Setup the IP header part of it*/
-    SetupBasicIPPacket( (unsigned char*)&ping, ICMPPROTOCOL, targetIP );
+    SetupBasicIPPacket( packet, ICMPPROTOCOL, targetIP );
     
     /*Setup the Ping flags*/
-    ping.ip.flags = 0x0;
-    ping.type = 0x8;
-    ping.codex = 0x0;
-    ping.chksum = 0x0;
-    ping.iden = (0x1);
-    ping.seqNum = (76);
+    ping->ip.flags = 0x0;
+    ping->type = 0x8;
+    ping->codex = 0x0;
+    ping->iden = (0x1);
+    ping->seqNum = (76);
     
     /*Fill in the dummy data*/
     for(i=0;i<18;i++){
-        *((unsigned char*)&ping+sizeof(ICMPhdr)+i)='A'+i;
+        packet[sizeof(ICMPhdr)+i]='A'+i;
     }
     /*Write the length field*/
-    ping.ip.len = (60-sizeof(EtherNetII));
-    
-    /*Compute the checksums*/
-    ping.chksum=checksum(((unsigned char*)&ping) + sizeof(IPhdr ),(sizeof(ICMPhdr) - sizeof(IPhdr))+18,0);
-    ping.ip.chksum = checksum(((unsigned char*)&ping) + sizeof(EtherNetII),sizeof(IPhdr) - sizeof(EtherNetII),0);
+    ping->ip.len = (sizeof(packet)-sizeof(EtherNetII));
     
-    /*Send it!*/
-    return(MACWrite( (unsigned char*)&ping, sizeof(ICMPhdr)+18 ));  
+    /*Checksum and send it!*/
+    return(SendIPPacket( packet, sizeof(packet), 0 ));  
 }
 
 
@@ -17,13 +17,15 @@
 ********************************************************************************
 * Summary:
 *   Generate and send a Ping reply from a received request.
+*   The request must still be open in the ENC28J60(see MACPeek),since only
+*   the headers are sent over SPI,and the rest is copied across in the chip.
 *
 * Parameters:
-*   ping - A pointer of type ICMPhdr,to the received request's packet.
+*   ping - A pointer of type ICMPhdr,to the received request's headers.
 *   len - length of the recd. Ping request.          
 * Returns:
-*   TRUE(0)- if the Ping Reply was successfully sent.
-*   FALSE(1) - if the Ping Reply was not successful in transmission.
+*   TRUE(0)- if the Ping Reply was queued for transmission.
+*   FALSE(1) - if it could not be queued.
 *******************************************************************************/
 unsigned int PingReply(ICMPhdr* ping,unsigned int len);
 
@@ -29,23 +29,14 @@ unsigned int UDPReply(UDPPacket* udppkt,unsigned char* datapayload,unsigned int
     
     uint16 port;
     
-    /*Swap the MAC Addresses in the ETH header*/
-    memcpy( udppkt->udp.ip.eth.DestAddrs, udppkt->udp.ip.eth.SrcAddrs, 6);
-    memcpy( udppkt->udp.ip.eth.SrcAddrs, deviceMAC,6 );
-    
-    /*Swap the IP Addresses in the IP header*/
-    memcpy( udppkt->udp.ip.dest, udppkt->udp.ip.source,4);
-    memcpy( udppkt->udp.ip.source, deviceIP,4);
+    /*Swap the MAC and IP Addresses*/
+    SwapAddresses(&udppkt->udp.ip);
     
     /*Swap the ports*/
     port=udppkt->udp.sourcePort;
     udppkt->udp.sourcePort=udppkt->udp.destPort;
     udppkt->udp.destPort=port;
     
-    /*zero the checksums*/
-    udppkt->udp.chksum=0x00;
-    udppkt->udp.ip.chksum=0x00;
-    
     /*write in the correct lengths*/
     udppkt->udp.len=(sizeof(UDPhdr)-sizeof(IPhdr))+payloadlen;
     udppkt->udp.ip.len=(sizeof(UDPhdr)+payloadlen)-sizeof(EtherNetII);
@@ -56,12 +47,8 @@ unsigned int UDPReply(UDPPacket* udppkt,unsigned char* datapayload,unsigned int
     /*copy in the payload*/
     memcpy(udppkt->Payload,datapayload,payloadlen);
     
-    /*do the checksums.*/
-    udppkt->udp.ip.chksum=checksum(((unsigned char*) udppkt) + sizeof(EtherNetII),sizeof(IPhdr) - sizeof(EtherNetII),0);
-    udppkt->udp.chksum=checksum((unsigned char*)udppkt->udp.ip.source,16+payloadlen,1);
-    
-    /*Send the packet.*/
-    return(MACWrite((unsigned char*)udppkt, sizeof(UDPhdr)+payloadlen));
+    /*Checksum and send the packet.*/
+    return(SendIPPacket((unsigned char*)udppkt, sizeof(UDPhdr)+payloadlen, 0));
 }
 
 /*******************************************************************************
@@ -93,10 +80,6 @@ unsigned int UDPSend(unsigned char* targetIP,unsigned int targetPort,unsigned ch
     udppkt.udp.sourcePort=UDPPort;
     udppkt.udp.destPort=targetPort;
     
-    /*Zero the checksums*/
-    udppkt.udp.chksum=0x00;
-    udppkt.udp.ip.chksum=0x00;
-    
     /*Write in the correct lengths*/
     udppkt.udp.len=(sizeof(UDPhdr)-sizeof(IPhdr))+payloadlen;
     udppkt.udp.ip.len=(sizeof(UDPhdr)+payloadlen)-sizeof(EtherNetII);
@@ -104,12 +87,8 @@ unsigned int UDPSend(unsigned char* targetIP,unsigned int targetPort,unsigned ch
     /*Copy in the payload*/
     memcpy(udppkt.Payload,datapayload,payloadlen);
     
-    /*Do the checksums.*/
-    udppkt.udp.ip.chksum=checksum((unsigned char*)&udppkt + sizeof(EtherNetII),sizeof(IPhdr) - sizeof(EtherNetII),0);
-    udppkt.udp.chksum=checksum((unsigned char*)&udppkt.udp.ip.source,16+payloadlen,1);
-    
-    /*Send the packet!*/
-    return(MACWrite((unsigned char*)&udppkt, sizeof(UDPhdr)+payloadlen));
+    /*Checksum and send the packet!*/
+    return(SendIPPacket((unsigned char*)&udppkt, sizeof(UDPhdr)+payloadlen, 0));
 }
 
 /*******************************************************************************
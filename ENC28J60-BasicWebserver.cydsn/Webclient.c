@@ -59,7 +59,7 @@ unsigned int WebClient_ProcessReply(TCPhdr* Rpacket){
 unsigned int WebClient_Send(){
 	
 	/*Check if Link is Up*/
-    if(IsLinkUp()==0){
+    if(IsLinkUp(&ethDevice)==0){
         return FALSE;
     }
 	
@@ -112,16 +112,8 @@ unsigned int WebClient_BrowseURL(TCPhdr* Tpacket){
     /*Set IP Length field*/
     Tpacket->ip.len=(sizeof(TCPhdr)+datlen)-sizeof(EtherNetII);
     
-    /*Zero out the checksums*/
-    Tpacket->ip.chksum=0x00;
-    Tpacket->chksum=0x00;
-    
-    /*Compute the checksums*/
-    Tpacket->ip.chksum=checksum((unsigned char*)Tpacket + sizeof(EtherNetII),sizeof(IPhdr)-sizeof(EtherNetII),0);
-    Tpacket->chksum = checksum((unsigned char*)Tpacket->ip.source,0x08+0x14+datlen,2);
-	
-	/*Send the Query TCP Packet*/
-	return(MACWrite((unsigned char*)Tpacket,sizeof(TCPhdr)+datlen));
+	/*Checksum and send the Query TCP Packet*/
+	return(SendIPPacket((unsigned char*)Tpacket,sizeof(TCPhdr)+datlen,0));
 }
 
 /*******************************************************************************
@@ -145,7 +137,7 @@ unsigned int WebClient_SendSYN(void){
     TCPhdr* TCPacket = (TCPhdr*)packet;
     
     /*Check if Link is Up*/
-    if(IsLinkUp()==0){
+    if(IsLinkUp(&ethDevice)==0){
         return FALSE;
     }
     
@@ -179,19 +171,8 @@ unsigned int WebClient_SendSYN(void){
     *(optptr)++ =0x02;
     *(optptr)++ =0x00;
     
-
-	/*Zero out the checksums*/
-    TCPacket->ip.chksum=0x00;
-    TCPacket->chksum=0x00;
-	/*Thanks to duncanspumpkin for pointing out the absence of these valuable lines*/
-
-
-    /*Compute the checksums*/
-    TCPacket->ip.chksum=checksum((unsigned char*)TCPacket + sizeof(EtherNetII),sizeof(IPhdr)-sizeof(EtherNetII),0);
-    TCPacket->chksum = checksum((unsigned char*)TCPacket->ip.source,0x08+0x14+4,2);
-
-    /*Send the SYN*/
-    return(MACWrite((unsigned char*)TCPacket,sizeof(TCPhdr)+4));
+    /*Checksum and send the SYN*/
+    return(SendIPPacket((unsigned char*)TCPacket,sizeof(TCPhdr)+4,0));
 }
 
 /* [] END OF FILE */
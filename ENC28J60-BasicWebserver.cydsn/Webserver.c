@@ -101,16 +101,8 @@ unsigned int ReplyTCP_Webserver(TCPhdr* TCPPkt,unsigned int datlen){
     /*Set the length field*/
     TCPPkt->ip.len=(sizeof(TCPhdr)+datlen)-sizeof(EtherNetII);
     
-    /*Zero out and then compute IP checksum*/
-    TCPPkt->ip.chksum=0x00;
-    TCPPkt->ip.chksum=checksum((unsigned char*)TCPPkt + sizeof(EtherNetII),sizeof(IPhdr)-sizeof(EtherNetII),0);
-    
-    /*Zero out and then compute TCP checksum*/
-    TCPPkt->chksum=0x00;
-    TCPPkt->chksum=checksum((unsigned char*)TCPPkt->ip.source,0x08+0x14+datlen,2);
-    
-    /*Send the reply*/
-    return(MACWrite((unsigned char*)TCPPkt,sizeof(TCPhdr)+datlen)); 
+    /*Checksum and send the reply*/
+    return(SendIPPacket((unsigned char*)TCPPkt,sizeof(TCPhdr)+datlen,0)); 
  }
 
 /* [] END OF FILE */
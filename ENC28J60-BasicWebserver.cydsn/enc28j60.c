@@ -19,595 +19,2235 @@
 #include "globals.h"
 #include "enc28j60.h"
 #include "spi.h"
+#include <string.h>
 
 
 /*
-Declare structures of type TXSTATUS and RXSTATUS,which
-  will hold the status vectors.
+Pattern filter set up by initMAC.
+This part is taken from Guido Socher's AVR enc28j60 driver.Great Work,that.
+For broadcast packets we allow only ARP packets,all other packets
+should be unicast only for our mac (MAADR).
+The pattern to match on is therefore
+Type     ETH.DST
+ARP      BROADCAST
+06 08 -- ff ff ff ff ff ff
+in binary these positions are:11 0000 0011 1111
 */
-TXSTATUS TxStatus;
-RXSTATUS ptrRxStatus;
+static const unsigned char ArpPattern[14] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                                             0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                                             0x08, 0x06};
+static const unsigned char ArpPatternMask[2] = {0x3f, 0x30};
+
+#if (SPI_PROF_ENABLED)
+/*
+SPI profile,see MACGetSpiProfile.Each transaction is timed from CS going
+low to it going high again,and put down to its opcode,and to the outermost
+driver function it was done for.ProfDepth counts how deep in the driver's
+own functions we are,so the ones they call on each other dont count.
+The bus is shared,so this is kept for all the chips on it together.
+*/
+static SPIPROFILE Prof;
+static unsigned char ProfSite;
+static unsigned char ProfDepth;
+static unsigned int ProfStart;
+#define PROF_ENTER(site)    do{ if (ProfDepth++ == 0){ ProfSite = (site); } }while(0)
+#define PROF_LEAVE()        do{ if (--ProfDepth == 0){ ProfSite = SPIPROF_OTHER; } }while(0)
+#define PROF_BEGIN()        ProfStart = ProfTimer_ReadCounter()
+#define PROF_END(op,bytes)  ProfRecord((op), (bytes))
+#else
+#define PROF_ENTER(site)
+#define PROF_LEAVE()
+#define PROF_BEGIN()
+#define PROF_END(op,bytes)
+#endif
+
+/*RdPtr when ERDPT is not known.*/
+#define RDPTUNKNOWN 0xffff
+
+/*Control byte plus the TX status vector*/
+#define TXSLOTEXTRA 8
+#define TXNOROOM    0xffff
+
+/*PhyRead and PhyScan when there is no PHY register being read or scanned.*/
+#define PHYNONE     0xff
+
+/*Highest PHY register address.*/
+#define PHYMAXADDR  0x14
+
+/*Without the INT pin,IsLinkUp has a look at EIR.LINKIF once
+every LINKCHECKINTERVAL calls.*/
+#define LINKCHECKINTERVAL 64
+
+#if (ENC_INT_ENABLED)
+/*Is this the chip wired to the INT pin.*/
+#define USESINT(enc)    ((enc)->IntPin)
+
+/*The chip wired to the "PACKET" pin,see initMAC.*/
+static ENC28J60* IntDevice;
+
+/*******************************************************************************
+* Function Name: PacketIsr
+********************************************************************************
+* Summary:
+*   Fires on the falling edge of the ENC28J60 INT pin,and flags that
+*   there are packets waiting for MACRead.No SPI traffic here.
+*******************************************************************************/
+CY_ISR(PacketIsr){
+    PACKET_ClearInterrupt();
+    IntDevice->RxPending = 1;
+}
+#else
+#define USESINT(enc)    0
+#endif
+
+/*Memory layout profiles,see MEMLAYOUT in "enc28j60.h"*/
+const MEMLAYOUT MemLayoutBalanced = { RXSTART, RXEND, TXSTART, TXEND };
+const MEMLAYOUT MemLayoutRxHeavy  = { 0x0000, 0x17ff, 0x1800, 0x1fff };
+const MEMLAYOUT MemLayoutTxHeavy  = { 0x0000, 0x0bff, 0x0c00, 0x1fff };
+
+/*A control register write done by initMAC,see InitTable.*/
+typedef struct {
+    unsigned char bank;
+    unsigned char addr;
+    unsigned char value;
+} REGINIT;
+
+/*
+The control registers initMAC sets to fixed values,sorted by bank so that
+the bank only changes once for each.The ones that depend on the memory
+layout or the MAC address are written by initMAC itself.
+See 6.0 Initialization on Page 33 of the datasheet.
+*/
+static const REGINIT InitTable[] = {
+    /*REGISTER 8-1: ERXFCON: RECEIVE FILTER CONTROL REGISTER
+    See Page 50 of the datasheet.PMEN keeps on the pattern filter that
+    initMAC sets up just before.*/
+    { 1, ERXFCON, ERXFCON_UCEN | ERXFCON_CRCEN | ERXFCON_PMEN },
+    
+    /*See 6.5 MAC Initialization Settings on Page 34 of the datasheet.*/
+#if (ENC_FULL_DUPLEX)
+    /*Enable reception of frames,and of PAUSE frames both ways.*/
+    { 2, MACON1,  MACON1_MARXEN | MACON1_TXPAUS | MACON1_RXPAUS },
+    { 2, MACON3,  MACON3_FRMLNEN |    // Type / len field will be checked
+                  MACON3_TXCRCEN |    // MAC will append valid CRC
+                  MACON3_PADCFG0 |    // All small packets will be padded
+                  MACON3_FULDPX },    // Full duplex
+#else
+    { 2, MACON1,  MACON1_MARXEN },    // Enable reception of frames
+    { 2, MACON3,  MACON3_FRMLNEN |    // Type / len field will be checked
+                  MACON3_TXCRCEN |    // MAC will append valid CRC
+                  MACON3_PADCFG0 },   // All small packets will be padded
+#endif
+    { 2, MAMXFLL, (unsigned char)( MAXFRAMELEN & 0x00ff) },// set max frame len
+    { 2, MAMXFLH, (unsigned char)((MAXFRAMELEN & 0xff00)>>8) },
+#if (ENC_FULL_DUPLEX)
+    { 2, MABBIPG, 0x15 },// back to back interpacket gap,for full duplex.
+    { 2, MAIPGL,  0x12 },// non back to back interpacket gap.MAIPGH is not used in full duplex.
+#else
+    { 2, MABBIPG, 0x12 },// back to back interpacket gap. set as per data sheet
+    { 2, MAIPGL,  0x12 },// non back to back interpacket gap. set as per data sheet
+    { 2, MAIPGH,  0x0C },
+#endif
+};
+
+/*Bound on the wait for ESTAT.CLKRDY after a reset,in CLKRDYPOLLUS steps.*/
+#define CLKRDYTRIES     100
+#define CLKRDYPOLLUS    50
 
 /*Define the Private Functions*/
 
-static unsigned char ReadETHReg(unsigned char bytAddress);// read an ETH reg
-static unsigned char ReadMacReg(unsigned char bytAddress);// read a MAC reg
-static unsigned int ReadPhyReg(unsigned char);// read a PHY reg
-static unsigned int ReadMacBuffer(unsigned char * ,unsigned int);//read the mac buffer (ptrBuffer, no. of bytes)
-static unsigned char WriteCtrReg(unsigned char,unsigned char);// write to a Control reg
-static unsigned char WritePhyReg(unsigned char,unsigned int);// write to a Phy reg
-static unsigned int WriteMacBuffer(unsigned char *,unsigned int);// write to the MAC buffer
-static void ResetMac(void);//Reset the MAC.
-static unsigned char SetBitField(unsigned char, unsigned char);//Set Bit Field in the register.
-static unsigned char ClrBitField(unsigned char, unsigned char);//Clear Bit Fir
-static void BankSel(unsigned char);
+static unsigned char ReadETHReg(ENC28J60* enc, unsigned char bytAddress);// read an ETH reg
+static unsigned char ReadMacReg(ENC28J60* enc, unsigned char bytAddress);// read a MAC reg
+static unsigned int ReadPhyReg(ENC28J60* enc, unsigned char);// read a PHY reg
+static unsigned int ReadMacBuffer(ENC28J60* enc, unsigned char * ,unsigned int);//read the mac buffer (ptrBuffer, no. of bytes)
+static unsigned char WriteCtrReg(ENC28J60* enc, unsigned char,unsigned char);// write to a Control reg
+static unsigned char WritePhyReg(ENC28J60* enc, unsigned char,unsigned int);// write to a Phy reg
+static unsigned int WriteMacBuffer(ENC28J60* enc, unsigned char *,unsigned int);// write to the MAC buffer
+static unsigned char ResetMac(ENC28J60* enc);//Reset the MAC.
+static unsigned char SetBitField(ENC28J60* enc, unsigned char, unsigned char);//Set Bit Field in the register.
+static unsigned char ClrBitField(ENC28J60* enc, unsigned char, unsigned char);//Clear Bit Fir
+static void BankSel(ENC28J60* enc, unsigned char);
+static void CheckLink(ENC28J60* enc);//Refresh LinkUp if the PHY flagged a link change.
+static void PhyIdle(ENC28J60* enc);//Get the MII interface to itself.
+static void PhyResume(ENC28J60* enc);//Start scanning again after PhyIdle.
+static void PhyFetch(ENC28J60* enc);//Pick up the result of PHYReadStart.
+static unsigned int TxAlloc(ENC28J60* enc, unsigned int);//Find a slot in the TX buffer.
+static void TxStart(ENC28J60* enc, TXDESC*);//Put a queued packet on the wire.
+static unsigned char TxFinish(ENC28J60* enc, TXDESC*);//Read back the TX status of a sent packet.
+static void RxOpen(ENC28J60* enc);//Open the next received packet.
+static void RxReadAt(ENC28J60* enc, unsigned int, unsigned char*, unsigned int);//Read from the open packet.
+static void RxRelease(ENC28J60* enc);//Free the open packet.
+static void SetReadPtr(ENC28J60* enc, unsigned int);//Point ERDPT somewhere.
+static void SetRxReadPtr(ENC28J60* enc);//Free the RX buffer up to RxNextPtr.
+static void RxRecover(ENC28J60* enc);//Reset the receive side after corruption.
+static void TxChecksum(ENC28J60* enc, unsigned int, const CSUMSPEC*);//Fill in a checksum with the DMA engine.
+static unsigned int TxSlot(ENC28J60* enc, unsigned int);//Make room in the TX queue and buffer.
+static void TxCommit(ENC28J60* enc, unsigned int, unsigned int, const CSUMSPEC*, unsigned char, TXCALLBACK);//Queue a packet written to a slot.
+static void RunDma(ENC28J60* enc, unsigned int, unsigned int, unsigned char);//Run the DMA engine,and wait.
+static unsigned char HashPointer(const unsigned char*);//Hash table bit for a MAC address.
+static unsigned char FindGroup(ENC28J60* enc, const unsigned char*);//Look up a joined group.
+#if (SPI_PROF_ENABLED)
+static void ProfRecord(unsigned char, unsigned int);//Account for an SPI transaction.
+#endif
+#if (ENC_BENCH_ENABLED)
+static unsigned int BenchLap(unsigned int*);//ProfTimer ticks since the last lap.
+#endif
+#if (ENC_FULL_DUPLEX)
+static void FlowControl(ENC28J60* enc, unsigned char);//Start or stop PAUSE frames.
+#endif
 
 /*Macro for Silicon Errata to do with Transmit Logic Reset.
 Silicon Errata No.12 as per Latest Errata doc for ENC28J60
 See http://ww1.microchip.com/downloads/en/DeviceDoc/80349c.pdf */
-#define ERRATAFIX   SetBitField(ECON1, ECON1_TXRST);ClrBitField(ECON1, ECON1_TXRST);ClrBitField(EIR, EIR_TXERIF | EIR_TXIF)
+#define ERRATAFIX   SetBitField(enc, ECON1, ECON1_TXRST);ClrBitField(enc, ECON1, ECON1_TXRST);ClrBitField(enc, EIR, EIR_TXERIF | EIR_TXIF)
 
 
-unsigned char ReadChipRev(void){
-    BankSel(3);
-    return(ReadETHReg(EREVID));
+unsigned char ReadChipRev(ENC28J60* enc){
+    BankSel(enc, 3);
+    return(ReadETHReg(enc, EREVID));
 }
 
-void initMAC(unsigned char* deviceMAC){
-    /*Initialize the SPI Module*/
+unsigned char initMAC(ENC28J60* enc, ENCSELECT select, unsigned char* deviceMAC, const MEMLAYOUT* layout){
+    unsigned char i;
+    PROF_ENTER(SPIPROF_INIT);
+    
+    /*Initialize the SPI Module,if no other chip on the bus has yet.*/
     spiInit();        
+    enc->Select = select;
+#if (SPI_PROF_ENABLED || ENC_BENCH_ENABLED)
+    ProfTimer_Start();
+#endif
+    
+    /*Use the layout asked for,if it makes sense.
+    The RX buffer has to end on an odd address,since ERXRDPT is set to it
+    when reading wraps around.(See No.5 in the Silicon Errata.)
+    The TX buffer has to come after it,and hold a full sized frame.*/
+    if ( (layout == 0) ||
+         (layout->RxStart & 1) || !(layout->RxEnd & 1) ||
+         (layout->RxEnd <= layout->RxStart) ||
+         (layout->TxStart <= layout->RxEnd) || (layout->TxEnd > 0x1fff) ||
+         (layout->TxEnd < layout->TxStart) ||
+         ((layout->TxEnd - layout->TxStart + 1) < (MAXFRAMELEN + 8)) ){
+        layout = &MemLayoutBalanced;
+    }
+    enc->Layout = *layout;
+    enc->RxNextPtr = enc->Layout.RxStart;
+    enc->RxPckOpen = 0;
+    enc->RdPtr = RDPTUNKNOWN;
+    enc->McastCount = 0;//The reset clears the hash table.
+#if (ENC_FULL_DUPLEX)
+    enc->FlowPaused = 0;
+#endif
+    enc->TxHead = 0;
+    enc->TxCount = 0;
+    enc->TxTail = enc->Layout.TxStart;
+    enc->TxLastStatus = TRUE;
+    enc->LinkCheckCount = 0;
+    enc->PhyRead = PHYNONE;//The reset stops any MII operation.
+    enc->PhyScan = PHYNONE;
+#if (ENC_INT_ENABLED)
+    /*The first chip set up gets the INT pin,the others are polled.
+    RxPending starts set,so that the first MACRead has a look at the chip.*/
+    if (IntDevice == 0){
+        IntDevice = enc;
+    }
+    enc->IntPin = (IntDevice == enc);
+    enc->RxMode = enc->IntPin ? RXMODE_HYBRID : RXMODE_POLL;
+    enc->RxPending = 1;
+    enc->RxPolling = 0;
+#endif
     
-    /*Execute a Soft Reset to the MAC*/
-    ResetMac();
+    /*Execute a Soft Reset to the MAC.
+    If its clock never comes back,there is no point going on.*/
+    if (ResetMac(enc) != TRUE){
+        PROF_LEAVE();
+        return FALSE;
+    }
     
     /*Setup the 8kb Memory space on the ENC28J60
-    by defining ERXST and ERXND*/
-    BankSel(0);//Select Bank 0
-    WriteCtrReg(ERXSTL,(unsigned char)( RXSTART & 0x00ff));    
-    WriteCtrReg(ERXSTH,(unsigned char)((RXSTART & 0xff00)>> 8));
-    WriteCtrReg(ERXNDL,(unsigned char)( RXEND   & 0x00ff));
-    WriteCtrReg(ERXNDH,(unsigned char)((RXEND   & 0xff00)>>8));
+    by defining ERXST and ERXND.Everything from here on is done in bank
+    order,so each bank is only selected once.*/
+    BankSel(enc, 0);//Select Bank 0
+    WriteCtrReg(enc, ERXSTL,(unsigned char)( enc->Layout.RxStart & 0x00ff));    
+    WriteCtrReg(enc, ERXSTH,(unsigned char)((enc->Layout.RxStart & 0xff00)>> 8));
+    WriteCtrReg(enc, ERXNDL,(unsigned char)( enc->Layout.RxEnd   & 0x00ff));
+    WriteCtrReg(enc, ERXNDH,(unsigned char)((enc->Layout.RxEnd   & 0xff00)>>8));
 
     /*Set RX Read pointer to start of RX Buffer*/
-    WriteCtrReg(ERXRDPTL, (unsigned char)( RXSTART & 0x00ff));
-    WriteCtrReg(ERXRDPTH, (unsigned char)((RXSTART & 0xff00)>> 8));
+    WriteCtrReg(enc, ERXRDPTL, (unsigned char)( enc->Layout.RxStart & 0x00ff));
+    WriteCtrReg(enc, ERXRDPTH, (unsigned char)((enc->Layout.RxStart & 0xff00)>> 8));
 	
 	/*Setup Transmit Buffer*/
-	WriteCtrReg(ETXSTL,(unsigned char)( TXSTART & 0x00ff));//Start of buffer
-	WriteCtrReg(ETXSTH,(unsigned char)((TXSTART & 0xff00)>>8));
+	WriteCtrReg(enc, ETXSTL,(unsigned char)( enc->Layout.TxStart & 0x00ff));//Start of buffer
+	WriteCtrReg(enc, ETXSTH,(unsigned char)((enc->Layout.TxStart & 0xff00)>>8));
 	/*End of buffer will depend on packets,so no point
 	hardcoding it*/
 
-    /*Set the RX Filters*/
-    BankSel(1);//Select Bank 1
-    /*REGISTER 8-1: ERXFCON: RECEIVE FILTER CONTROL REGISTER
-    See Page 50 of the datasheet.*/
-    WriteCtrReg(ERXFCON,( ERXFCON_UCEN + ERXFCON_CRCEN + ERXFCON_PMEN));
-	
-	//---Setup packet filter---
-	//This part is taken from Guido Socher's AVR enc28j60 driver.Great Work,that.
-	//For broadcast packets we allow only ARP packtets
-	//All other packets should be unicast only for our mac (MAADR)
-	//The pattern to match on is therefore
-	//Type     ETH.DST
-	//ARP      BROADCAST
-	//06 08 -- ff ff ff ff ff ff -> ip checksum for theses bytes=f7f9
-	//in binary these poitions are:11 0000 0011 1111
-	//This is hex 303F->EPMM0=0x3f,EPMM1=0x30
-	WriteCtrReg(EPMM0, 0x3f);
-	WriteCtrReg(EPMM1, 0x30);
-	WriteCtrReg(EPMCSL,0x39);
-	WriteCtrReg(EPMCSH,0xf7);
-
-
-    /*Initialize the MAC Registers*/
-    BankSel(2); // select bank 2
-    SetBitField(MACON1, MACON1_MARXEN);// Enable reception of frames
-    WriteCtrReg(MACON3, MACON3_FRMLNEN +    // Type / len field will be checked
-                        MACON3_TXCRCEN +    // MAC will append valid CRC
-                        MACON3_PADCFG0);    // All small packets will be padded
-     
-    WriteCtrReg(MAMXFLL, (unsigned char)( MAXFRAMELEN & 0x00ff));// set max frame len
-    WriteCtrReg(MAMXFLH, (unsigned char)((MAXFRAMELEN & 0xff00)>>8));
-    WriteCtrReg(MABBIPG, 0x12);// back to back interpacket gap. set as per data sheet
-    WriteCtrReg(MAIPGL , 0x12);// non back to back interpacket gap. set as per data sheet
-    WriteCtrReg(MAIPGH , 0x0C);
+	/*For broadcast packets we allow only ARP packets,see ArpPattern.*/
+	MACSetPattern(enc, 0, ArpPatternMask, ArpPattern, sizeof(ArpPattern));
 
+    /*Set the RX filters and the MAC registers,from InitTable.*/
+    for (i = 0; i < (sizeof(InitTable) / sizeof(InitTable[0])); i++){
+        BankSel(enc, InitTable[i].bank);
+        WriteCtrReg(enc, InitTable[i].addr, InitTable[i].value);
+    }
   
     /*Assign the MAC Address to the chip.*/
-    BankSel(3);//Select Bank 3.              
-    WriteCtrReg(MAADR1,deviceMAC[0]);   
-    WriteCtrReg(MAADR2,deviceMAC[1]);  
-    WriteCtrReg(MAADR3,deviceMAC[2]);
-    WriteCtrReg(MAADR4,deviceMAC[3]);
-    WriteCtrReg(MAADR5,deviceMAC[4]);
-    WriteCtrReg(MAADR6,deviceMAC[5]);
+    BankSel(enc, 3);//Select Bank 3.              
+    WriteCtrReg(enc, MAADR1,deviceMAC[0]);   
+    WriteCtrReg(enc, MAADR2,deviceMAC[1]);  
+    WriteCtrReg(enc, MAADR3,deviceMAC[2]);
+    WriteCtrReg(enc, MAADR4,deviceMAC[3]);
+    WriteCtrReg(enc, MAADR5,deviceMAC[4]);
+    WriteCtrReg(enc, MAADR6,deviceMAC[5]);
 
     /*Initialise the PHY registers
     REGISTER 11-3: PHCON1: PHY CONTROL REGISTER 1
     See Page 65 of the Datasheet.*/
-    WritePhyReg(PHCON1, 0x000);
+#if (ENC_FULL_DUPLEX)
+    /*PDPXMD has to match MACON3.FULDPX.*/
+    WritePhyReg(enc, PHCON1, PHCON1_PDPXMD);
+#else
+    WritePhyReg(enc, PHCON1, 0x000);
     /*
     "If using half duplex, the host controller may wish to set
     the PHCON2.HDLDIS bit to prevent automatic
     loopback of the data which is transmitted."
     See Section 6.6 on Page 40 */
-    WritePhyReg(PHCON2, PHCON2_HDLDIS);
+    WritePhyReg(enc, PHCON2, PHCON2_HDLDIS);
+#endif
+    
+    /*Have the PHY raise EIR.LINKIF on link changes,so that the
+    link state can be cached instead of read on every packet.
+    See Section 12.1.5 on Page 71 of the datasheet.*/
+    WritePhyReg(enc, PHIE, PHIE_PGEIE | PHIE_PLNKIE);
     
+#if (ENC_INT_ENABLED)
+    if (enc->IntPin){
+        /*Let PKTIF,LINKIF and RXERIF drive the INT pin.*/
+        WriteCtrReg(enc, EIE, EIE_INTIE | EIE_PKTIE | EIE_LINKIE | EIE_RXERIE);
+        PACKET_ISR_StartEx(PacketIsr);
+    }
+#endif
+
+    /*Read the link state once to start with.
+    Reading PHIR also clears any link change flagged so far.*/
+    ReadPhyReg(enc, PHIR);
+    enc->LinkUp = (ReadPhyReg(enc, PHSTAT2) & PHSTAT2_LSTAT) ? 0x01 : 0x00;
+
     /*Enable reception of packets*/
-    WriteCtrReg(ECON1,  ECON1_RXEN);     
+    WriteCtrReg(enc, ECON1,  ECON1_RXEN);     
+    PROF_LEAVE();
+    return TRUE;
 }
 
-unsigned char MACWrite(unsigned char* packet, unsigned int len){
+void SetRxMode(ENC28J60* enc, unsigned char mode){
+    PROF_ENTER(SPIPROF_READ);
+#if (ENC_INT_ENABLED)
+    if ((mode > RXMODE_HYBRID) || !enc->IntPin){
+        PROF_LEAVE();
+        return;
+    }
+    
+    /*Leave any polling burst,with PKTIE enabled again.*/
+    if (enc->RxPolling){
+        enc->RxPolling = 0;
+        SetBitField(enc, EIE, EIE_PKTIE);
+    }
+    
+    /*Look at the chip once,in case packets came in before the switch.*/
+    enc->RxPending = 1;
+    enc->RxMode = mode;
+#else
+    (void)enc;
+    (void)mode;
+#endif
+    /*Without the INT pin,or on a chip not wired to it,polling is all we can do.*/
+    PROF_LEAVE();
+}
 
-    unsigned char  bytControl=0x00;
-  	
-	/*Check if Link is Up*/
-    if(IsLinkUp()==0){
+unsigned char MACSetPattern(ENC28J60* enc, unsigned int offset, const unsigned char* mask, const unsigned char* values, unsigned char len){
+    unsigned char i;
+    unsigned char maskByte;
+    unsigned char hiByte = 1;
+    unsigned long sum = 0;
+    PROF_ENTER(SPIPROF_FILTER);
+    
+    if ((len == 0) || (len > 64)){
+        PROF_LEAVE();
         return FALSE;
     }
-	
-    /*Configure TX Buffer Pointers*/
-    BankSel(0);// select bank 0
     
-    /*Buffer write ptr to start of Tx packet*/
-    WriteCtrReg(ETXSTL,(unsigned char)( TXSTART & 0x00ff));        
-    WriteCtrReg(ETXSTH,(unsigned char)((TXSTART & 0xff00)>>8));
+    /*The checksum is over the masked bytes only,taken one after the other
+    as if there was nothing in between,and worked out like an IP checksum.*/
+    for (i = 0; i < len; i++){
+        if (mask[i >> 3] & (1 << (i & 0x07))){
+            sum += hiByte ? ((unsigned int)values[i] << 8) : values[i];
+            hiByte = !hiByte;
+        }
+    }
+    while (sum >> 16){
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    sum ^= 0xFFFF;
+    
+    BankSel(enc, 1);
+    
+    /*Off while it is changed,so no packet is matched against half a pattern.*/
+    ClrBitField(enc, ERXFCON, ERXFCON_PMEN);
+    
+    /*Bits from len up are cleared,in the last mask byte too,or the chip
+    would check bytes that are not in the checksum.*/
+    for (i = 0; i < 8; i++){
+        maskByte = 0x00;
+        if (i < ((len + 7) >> 3)){
+            maskByte = mask[i];
+            if ((i == ((len - 1) >> 3)) && (len & 0x07)){
+                maskByte &= (1 << (len & 0x07)) - 1;
+            }
+        }
+        WriteCtrReg(enc, EPMM0 + i, maskByte);
+    }
+    WriteCtrReg(enc, EPMCSL, (unsigned char)( sum & 0x00ff));
+    WriteCtrReg(enc, EPMCSH, (unsigned char)((sum & 0xff00) >> 8));
+    WriteCtrReg(enc, EPMOL, (unsigned char)( offset & 0x00ff));
+    WriteCtrReg(enc, EPMOH, (unsigned char)((offset & 0xff00) >> 8));
+    
+    SetBitField(enc, ERXFCON, ERXFCON_PMEN);
+    
+    PROF_LEAVE();
+    return TRUE;
+}
+
+void MACClearPattern(ENC28J60* enc){
+    PROF_ENTER(SPIPROF_FILTER);
+    BankSel(enc, 1);
+    ClrBitField(enc, ERXFCON, ERXFCON_PMEN);
+    PROF_LEAVE();
+}
+
+unsigned char MACJoinGroup(ENC28J60* enc, const unsigned char* groupMAC){
+    unsigned char hash;
+    PROF_ENTER(SPIPROF_FILTER);
+    
+    if (FindGroup(enc, groupMAC) < enc->McastCount){
+        PROF_LEAVE();
+        return TRUE;//Already in.
+    }
+    if (enc->McastCount == MCASTMAX){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    hash = HashPointer(groupMAC);
+    memcpy(enc->McastGroups[enc->McastCount].mac, groupMAC, 6);
+    enc->McastGroups[enc->McastCount].hash = hash;
+    enc->McastCount++;
+    
+    /*Set its bit,and turn the hash table filter on.
+    Bits 5:3 of the pointer pick EHT0-EHT7,bits 2:0 the bit in it.*/
+    BankSel(enc, 1);
+    SetBitField(enc, EHT0 + (hash >> 3), 1 << (hash & 0x07));
+    SetBitField(enc, ERXFCON, ERXFCON_HTEN);
+    
+    PROF_LEAVE();
+    return TRUE;
+}
+
+unsigned char MACLeaveGroup(ENC28J60* enc, const unsigned char* groupMAC){
+    unsigned char i;
+    unsigned char hash;
+    PROF_ENTER(SPIPROF_FILTER);
+    
+    i = FindGroup(enc, groupMAC);
+    if (i >= enc->McastCount){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    /*Take it out of the list,filling the gap with the last one.*/
+    hash = enc->McastGroups[i].hash;
+    enc->McastCount--;
+    enc->McastGroups[i] = enc->McastGroups[enc->McastCount];
+    
+    /*Clear its bit,unless another group hashes to it too.*/
+    for (i = 0; i < enc->McastCount; i++){
+        if (enc->McastGroups[i].hash == hash){
+            PROF_LEAVE();
+            return TRUE;
+        }
+    }
+    BankSel(enc, 1);
+    ClrBitField(enc, EHT0 + (hash >> 3), 1 << (hash & 0x07));
+    
+    /*Nothing left to let through.*/
+    if (enc->McastCount == 0){
+        ClrBitField(enc, ERXFCON, ERXFCON_HTEN);
+    }
     
-	/*Set write buffer pointer to point to start of Tx Buffer*/
-	WriteCtrReg(EWRPTL,(unsigned char)( TXSTART & 0x00ff));        
-	WriteCtrReg(EWRPTH,(unsigned char)((TXSTART & 0xff00)>>8));
+    PROF_LEAVE();
+    return TRUE;
+}
+
+void MACGetStats(ENC28J60* enc, MACSTATS* stats){
+    *stats = enc->Stats;
+}
+
+void MACResetStats(ENC28J60* enc){
+    memset(&enc->Stats, 0, sizeof(enc->Stats));
+}
+
+void MACGetSpiProfile(SPIPROFILE* profile){
+#if (SPI_PROF_ENABLED)
+    *profile = Prof;
+#else
+    memset(profile, 0, sizeof(SPIPROFILE));
+#endif
+}
+
+void MACResetSpiProfile(void){
+#if (SPI_PROF_ENABLED)
+    memset(&Prof, 0, sizeof(Prof));
+#endif
+}
+
+unsigned char MACQueue(ENC28J60* enc, unsigned char* packet, unsigned int len, TXCALLBACK done){
+    return MACQueueCsum(enc, packet, len, 0, 0, done);
+}
+
+unsigned char MACQueueCsum(ENC28J60* enc, unsigned char* packet, unsigned int len, const CSUMSPEC* csum, unsigned char count, TXCALLBACK done){
+    unsigned char  bytControl=0x00;
+    unsigned int start;
+    PROF_ENTER(SPIPROF_QUEUE);
+  	
+    /*Find room for it in the TX buffer*/
+    if ((start = TxSlot(enc, len)) == TXNOROOM){
+        PROF_LEAVE();
+        return FALSE;
+    }
 	
+    /*Set write buffer pointer to point to the slot*/
+    BankSel(enc, 0);// select bank 0
+	WriteCtrReg(enc, EWRPTL,(unsigned char)( start & 0x00ff));        
+	WriteCtrReg(enc, EWRPTH,(unsigned char)((start & 0xff00)>>8));
     
     /*Write the Per Packet Control Byte
     See FIGURE 7-1: FORMAT FOR PER PACKET CONTROL BYTES
     on Page 41 of the datasheet */
-    WriteMacBuffer(&bytControl,1);
+    WriteMacBuffer(enc, &bytControl,1);
       
-    /*Write the packet into the ENC's buffer*/
-	WriteMacBuffer(packet, len);  
+    /*Write the packet into the ENC's buffer.
+    This can happen while an earlier packet is still going out.*/
+	WriteMacBuffer(enc, packet, len);  
     
-	/*Tell MAC when the end of the packet is*/
-	WriteCtrReg(ETXNDL, (unsigned char)( (len+TXSTART+1) & 0x00ff));       
-	WriteCtrReg(ETXNDH, (unsigned char)(((len+TXSTART+1) & 0xff00)>>8));
+    TxCommit(enc, start, len, csum, count, done);
+    PROF_LEAVE();
+    return TRUE;
+}
 
-    /*We would like to enable Interrupts on Packet TX complete.*/
-    ClrBitField(EIR,EIR_TXIF);
-    SetBitField(EIE, EIE_TXIE |EIE_INTIE);
+unsigned char MACQueueFromRx(ENC28J60* enc, unsigned char* header, unsigned int hdrLen, const CSUMSPEC* csum, unsigned char count, TXCALLBACK done){
+    unsigned char  bytControl=0x00;
+    unsigned int start;
+    unsigned int last;
+    PROF_ENTER(SPIPROF_QUEUE);
     
-    /*Macro for Silicon Errata to do with Transmit Logic Reset.
-    Silicon Errata No.12 as per Latest Errata doc for ENC28J60
-    See http://ww1.microchip.com/downloads/en/DeviceDoc/80349c.pdf */
-    ERRATAFIX;    
+    if (!enc->RxPckOpen || (hdrLen > enc->RxPckLen)){
+        PROF_LEAVE();
+        return FALSE;
+    }
     
-    /*Send that Packet!*/
-    SetBitField(ECON1, ECON1_TXRTS);
+    /*Find room for a copy in the TX buffer*/
+    if ((start = TxSlot(enc, enc->RxPckLen)) == TXNOROOM){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    /*Have the DMA engine copy the packet across,after the control byte.
+    It wraps at the end of the RX buffer by itself.*/
+    last = enc->RxPckPtr + enc->RxPckLen - 1;
+    if (last > enc->Layout.RxEnd){
+        last -= (enc->Layout.RxEnd - enc->Layout.RxStart + 1);
+    }
+    BankSel(enc, 0);
+    WriteCtrReg(enc, EDMADSTL,(unsigned char)( (start + 1) & 0x00ff));
+    WriteCtrReg(enc, EDMADSTH,(unsigned char)(((start + 1) & 0xff00)>>8));
+    RunDma(enc, enc->RxPckPtr, last, 0);
     
-    /*Wait for the Chip to finish the TX,and
-      read the TX interrrupt bit to check the same.*/
-    do{}while (!(ReadETHReg(EIR) & (EIR_TXIF)));             // kill some time. Note: Nice place to block?             // kill some time. Note: Nice place to block?
+    /*Now write the Control Byte and the new header over the start of it.*/
+    WriteCtrReg(enc, EWRPTL,(unsigned char)( start & 0x00ff));        
+	WriteCtrReg(enc, EWRPTH,(unsigned char)((start & 0xff00)>>8));
+    WriteMacBuffer(enc, &bytControl,1);
+    WriteMacBuffer(enc, header, hdrLen);
+    
+    TxCommit(enc, start, enc->RxPckLen, csum, count, done);
+    PROF_LEAVE();
+    return TRUE;
+}
 
-    /*Clear TXRTS,since the packet has been TX'd.*/
-    ClrBitField(ECON1, ECON1_TXRTS);
+void MACService(ENC28J60* enc){
+    TXDESC* desc;
+    unsigned char status;
+    PROF_ENTER(SPIPROF_SERVICE);
+    
+    /*Finish off a PHY read started by PHYReadStart,if it is done.*/
+    if (enc->PhyRead != PHYNONE){
+        PHYReadPoll(enc, 0);
+    }
+    
+    if (enc->TxCount == 0){
+        PROF_LEAVE();
+        return;//Nothing on the wire.
+    }
+    
+    /*TXIF or TXERIF are set once the packet is done with.*/
+    if (!(ReadETHReg(enc, EIR) & (EIR_TXIF | EIR_TXERIF))){
+        PROF_LEAVE();
+        return;//Still going out.
+    }
+    
+    desc = &enc->TxQueue[enc->TxHead];
+    status = TxFinish(enc, desc);
+    
+    /*A late collision is not retried by the chip,so send it again from
+    the same slot,as nothing has been written over it.*/
+    if ((status != TRUE) && enc->TxStatus.bits.LateCollision && desc->retries){
+        desc->retries--;
+        TxStart(enc, desc);
+        PROF_LEAVE();
+        return;
+    }
+    
+    /*Take it off the queue,and start the next one straight away.*/
+    enc->TxHead = (enc->TxHead + 1) % TXQUEUELEN;
+    enc->TxCount--;
+    if (enc->TxCount){
+        TxStart(enc, &enc->TxQueue[enc->TxHead]);
+    }else{
+        enc->TxTail = enc->Layout.TxStart;//Empty,so start from the top again.
+    }
+    
+    if (desc->done){
+        desc->done(status);
+    }
+    PROF_LEAVE();
+}
+
+unsigned char MACWrite(ENC28J60* enc, unsigned char* packet, unsigned int len){
+    return MACWriteCsum(enc, packet, len, 0, 0);
+}
+
+unsigned char MACWriteCsum(ENC28J60* enc, unsigned char* packet, unsigned int len, const CSUMSPEC* csum, unsigned char count){
+    PROF_ENTER(SPIPROF_WRITE);
+    
+	/*Check if Link is Up*/
+    if(IsLinkUp(enc)==0){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    /*Queue it,waiting for room if the queue is full.*/
+    while (MACQueueCsum(enc, packet, len, csum, count, 0) == FALSE){
+        if (enc->TxCount == 0){
+            PROF_LEAVE();
+            return FALSE;//Too big to ever fit.
+        }
+        MACService(enc);
+    }
+    
+    /*Wait for the Chip to finish the TX of everything queued,
+    ours being the last.*/
+    while (enc->TxCount){
+        MACService(enc);
+    }
+    
+    PROF_LEAVE();
+    return enc->TxLastStatus;
+}
+
+unsigned int MACRead(ENC28J60* enc, unsigned char* packet, unsigned int maxLen){
+	unsigned int pckLen;
+    PROF_ENTER(SPIPROF_READ);
+    
+    /*Pick up the packet left open by MACPeek,or the next one in.*/
+    if (!enc->RxPckOpen){
+        RxOpen(enc);
+        if (!enc->RxPckOpen){
+            PROF_LEAVE();
+            return 0;//Report that No Proper Packets RX'd.
+        }
+    }
+    
+	pckLen = enc->RxPckLen;
+	if( pckLen > maxLen ){
+	pckLen = maxLen;
+	enc->Stats.RxTruncated++;
+	}
+	
+    /*Read the packet only if it was RX'd Okay.
+    We should be checking other flags too,like Length Out of Range,
+    but that one doesnt seem reliable.
+    We need more work and testing here.*/
+    if(enc->RxStatus.bits.RxOk==0x01){
+        RxReadAt(enc, 0, packet, pckLen);//Read packet into buffer.
+    }
+    
+    RxRelease(enc);
   
-    /*We will now attempt to read the TX Status Vectors.
-    See TABLE 7-1: TRANSMIT STATUS VECTORS on Page 43 of the datasheet.*/
-    BankSel(0);
+  /*Return the length of the packet RX'd*/
+  PROF_LEAVE();
+  return pckLen;
+}
+
+unsigned int MACPeek(ENC28J60* enc, unsigned char* header, unsigned int hdrLen){
+    PROF_ENTER(SPIPROF_READ);
     
-    /*Because,that control byte.*/
-    len++;
+    if (!enc->RxPckOpen){
+        RxOpen(enc);
+        if (!enc->RxPckOpen){
+            PROF_LEAVE();
+            return 0;
+        }
+    }
     
-    /*Configure the buffer read ptr to read status structure*/
-    WriteCtrReg(ERDPTL, (unsigned char)( len & 0x00ff));       
-    WriteCtrReg(ERDPTH, (unsigned char)((len & 0xff00)>>8));
+    /*Bad packets are not worth a look.*/
+    if(enc->RxStatus.bits.RxOk!=0x01){
+        RxRelease(enc);
+        PROF_LEAVE();
+        return 0;
+    }
     
-    /*Read In the TX Status Vectors*/
-    /*Note: Use these for debugging.Really useful.*/
-    ReadMacBuffer(&TxStatus.v[0],7);
+    if (hdrLen > enc->RxPckLen){
+        hdrLen = enc->RxPckLen;
+    }
+    RxReadAt(enc, 0, header, hdrLen);
+    
+    PROF_LEAVE();
+    return enc->RxPckLen;
+}
 
-    /*Read TX status vectors to see if TX was interrupted.*/
-    if (ReadETHReg(ESTAT) & ESTAT_TXABRT){
-        if (TxStatus.bits.LateCollision){
-            ClrBitField(ECON1, ECON1_TXRTS);//Toggle the TXRTS
-            SetBitField(ECON1, ECON1_TXRTS);
-            ClrBitField(ESTAT,ESTAT_TXABRT | ESTAT_LATECOL);//Clear the Late Collision Bit.
+unsigned int MACReadAt(ENC28J60* enc, unsigned int offset, unsigned char* buffer, unsigned int len){
+    PROF_ENTER(SPIPROF_READ);
+    
+    if (!enc->RxPckOpen || (offset >= enc->RxPckLen)){
+        PROF_LEAVE();
+        return 0;
+    }
+    
+    if (len > (enc->RxPckLen - offset)){
+        len = enc->RxPckLen - offset;
+    }
+    RxReadAt(enc, offset, buffer, len);
+    
+    PROF_LEAVE();
+    return len;
+}
+
+void MACDiscard(ENC28J60* enc){
+    PROF_ENTER(SPIPROF_READ);
+    if (enc->RxPckOpen){
+        RxRelease(enc);
+    }
+    PROF_LEAVE();
+}
+
+void MACTruncated(ENC28J60* enc){
+    if (enc->RxPckOpen){
+        enc->Stats.RxTruncated++;
+    }
+}
+
+unsigned char PHYReadStart(ENC28J60* enc, unsigned char address, PHYCALLBACK done){
+    PROF_ENTER(SPIPROF_PHY);
+    
+    if ((address > PHYMAXADDR) || (enc->PhyRead != PHYNONE) || (enc->PhyScan != PHYNONE)){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    /*A PHY write takes a while too,dont wait for it here.*/
+    BankSel(enc, 3);
+    if (ReadMacReg(enc, MISTAT) & MISTAT_BUSY){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    /*Ask for the read,see Section 3.3.1 on Page 21 of the datasheet.*/
+    BankSel(enc, 2);
+    WriteCtrReg(enc, MIREGADR, address);
+    WriteCtrReg(enc, MICMD, MICMD_MIIRD);
+    enc->PhyRead = address;
+    enc->PhyReadDone = 0;
+    enc->PhyDone = done;
+    
+    PROF_LEAVE();
+    return TRUE;
+}
+
+unsigned char PHYReadPoll(ENC28J60* enc, unsigned int* value){
+    unsigned char address;
+    PROF_ENTER(SPIPROF_PHY);
+    
+    if (enc->PhyRead == PHYNONE){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    if (!enc->PhyReadDone){
+        BankSel(enc, 3);
+        if (ReadMacReg(enc, MISTAT) & MISTAT_BUSY){
+            PROF_LEAVE();
+            return FALSE;//Still going.
+        }
+        PhyFetch(enc);
+    }
+    
+    /*Hand it over,and free up the MII interface for the next one.*/
+    address = enc->PhyRead;
+    enc->PhyRead = PHYNONE;
+    if (value){
+        *value = enc->PhyValue;
+    }
+    if (enc->PhyDone){
+        enc->PhyDone(address, enc->PhyValue);
+    }
+    
+    PROF_LEAVE();
+    return TRUE;
+}
+
+unsigned char PHYScanStart(ENC28J60* enc, unsigned char address){
+    PROF_ENTER(SPIPROF_PHY);
+    
+    if ((address > PHYMAXADDR) || (enc->PhyRead != PHYNONE)){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    /*Stop scanning whatever was scanned before,and start on this one.*/
+    PhyIdle(enc);
+    enc->PhyScan = address;
+    PhyResume(enc);
+    
+    PROF_LEAVE();
+    return TRUE;
+}
+
+unsigned char PHYScanRead(ENC28J60* enc, unsigned int* value){
+    PROF_ENTER(SPIPROF_PHY);
+    
+    if (enc->PhyScan == PHYNONE){
+        PROF_LEAVE();
+        return FALSE;
+    }
+    
+    /*Only the first read has to wait for NVALID,MIRD stays valid after.*/
+    if (!enc->PhyScanValid){
+        BankSel(enc, 3);
+        if (ReadMacReg(enc, MISTAT) & MISTAT_NVALID){
+            PROF_LEAVE();
+            return FALSE;
         }
-    ClrBitField(EIR, EIR_TXERIF | EIR_TXIF);//Clear the Interrupt Flags.
-    ClrBitField(ESTAT,ESTAT_TXABRT);//Clear the Abort Flag.
-    return FALSE;//Report a Failed Packet TX.
-  }else{
-    return TRUE;//Packet Sent Okay! :-)
-  }
-   return TRUE;
+        enc->PhyScanValid = 1;
+    }
+    
+    BankSel(enc, 2);
+    *value = (unsigned int)ReadMacReg(enc, MIRDL);
+    *value |= ((unsigned int)ReadMacReg(enc, MIRDH) << 8);
+    
+    PROF_LEAVE();
+    return TRUE;
+}
+
+void PHYScanStop(ENC28J60* enc){
+    PROF_ENTER(SPIPROF_PHY);
+    if (enc->PhyScan != PHYNONE){
+        PhyIdle(enc);
+        enc->PhyScan = PHYNONE;
+    }
+    PROF_LEAVE();
 }
 
-unsigned int MACRead(unsigned char* packet, unsigned int maxLen){
-	volatile unsigned int pckLen;
-	static unsigned int nextpckptr = RXSTART;
+unsigned char MACLoopbackBench(ENC28J60* enc, unsigned char* frame, unsigned int len, unsigned int count, LOOPBENCH* result){
+#if (ENC_BENCH_ENABLED)
+    unsigned int i;
+    unsigned int n;
+    unsigned int tries;
+    unsigned int got;
+    unsigned int mark;
+    unsigned char rxOk;
+    unsigned char hdr[14];
+    unsigned char macon3;
+    unsigned int phcon1;
+    unsigned long ticks;
+    
+    if ((len < 60) || (len > (MAXFRAMELEN - 4)) || enc->TxCount || enc->RxPckOpen){
+        return FALSE;
+    }
+    memset(result, 0, sizeof(LOOPBENCH));
+    
+    /*Destination and source are both our own MAC address,so the frames get
+    past the unicast filter.The rest is a pattern that is easy to check.*/
+    BankSel(enc, 3);
+    hdr[0] = hdr[6]  = ReadMacReg(enc, MAADR1);
+    hdr[1] = hdr[7]  = ReadMacReg(enc, MAADR2);
+    hdr[2] = hdr[8]  = ReadMacReg(enc, MAADR3);
+    hdr[3] = hdr[9]  = ReadMacReg(enc, MAADR4);
+    hdr[4] = hdr[10] = ReadMacReg(enc, MAADR5);
+    hdr[5] = hdr[11] = ReadMacReg(enc, MAADR6);
+    hdr[12] = 0x88;//Local experimental Ethertype.
+    hdr[13] = 0xb5;
+    memcpy(frame, hdr, sizeof(hdr));
+    for (i = sizeof(hdr); i < len; i++){
+        frame[i] = (unsigned char)i;
+    }
+    
+    /*Throw away whatever is waiting.*/
+    for (;;){
+        RxOpen(enc);
+        if (!enc->RxPckOpen){
+            break;
+        }
+        RxRelease(enc);
+    }
+    
+    /*Loopback needs the MAC and PHY in full duplex.
+    See REGISTER 11-3: PHCON1 on Page 65 of the datasheet.*/
+    BankSel(enc, 2);
+    macon3 = ReadMacReg(enc, MACON3);
+    phcon1 = ReadPhyReg(enc, PHCON1);
+    BankSel(enc, 2);
+    WriteCtrReg(enc, MACON3, macon3 | MACON3_FULDPX);
+    WriteCtrReg(enc, MABBIPG, 0x15);
+    WritePhyReg(enc, PHCON1, phcon1 | PHCON1_PDPXMD | PHCON1_PLOOPBK);
+    
+    /*There might be no cable,but the frames dont go near it anyway.
+    The real state is read back at the end.*/
+    enc->LinkUp = 1;
+    
+    for (n = 0; n < count; n++){
+        mark = ProfTimer_ReadCounter();
+        if (MACQueue(enc, frame, len, 0) == FALSE){
+            result->Errors++;
+            continue;
+        }
+        result->WriteTicks += BenchLap(&mark);
+        
+        while (enc->TxCount){
+            MACService(enc);
+        }
+        result->TxWaitTicks += BenchLap(&mark);
+        
+        /*The read of the one that comes back is timed on its own,
+        the empty polls before it are waiting.*/
+        got = 0;
+        for (tries = BENCHRXTRIES; tries && !got; tries--){
+            RxOpen(enc);
+            result->RxWaitTicks += BenchLap(&mark);
+            if (enc->RxPckOpen){
+                rxOk = enc->RxStatus.bits.RxOk;
+                got = MACRead(enc, frame, len);
+                if (!rxOk){
+                    got = 0;//Not read at all.
+                }
+                result->ReadTicks += BenchLap(&mark);
+            }
+        }
+        
+        /*It is read back over what was sent,so if it is the same,
+        the buffer is ready for the next one as it is.*/
+        if ((got == len) && memcmp(frame, hdr, sizeof(hdr))){
+            got = 0;
+        }
+        for (i = sizeof(hdr); (got == len) && (i < len); i++){
+            if (frame[i] != (unsigned char)i){
+                got = 0;
+            }
+        }
+        if (got == len){
+            result->Frames++;
+            result->Bytes += len;
+        }else{
+            result->Errors++;
+            memcpy(frame, hdr, sizeof(hdr));
+            for (i = sizeof(hdr); i < len; i++){
+                frame[i] = (unsigned char)i;
+            }
+        }
+    }
+    
+    /*Put it all back.*/
+    WritePhyReg(enc, PHCON1, phcon1);
+    BankSel(enc, 2);
+    WriteCtrReg(enc, MACON3, macon3);
+    WriteCtrReg(enc, MABBIPG, (macon3 & MACON3_FULDPX) ? 0x15 : 0x12);
+    
+    /*The link may have come or gone meanwhile,and a CheckLink in RxOpen
+    may have taken the LINKIF of it,so read the state afresh rather than
+    put back the old one.Reading PHIR clears any LINKIF still flagged.*/
+    ReadPhyReg(enc, PHIR);
+    enc->LinkUp = (ReadPhyReg(enc, PHSTAT2) & PHSTAT2_LSTAT) ? 0x01 : 0x00;
+    
+    /*Work out the rates from the time per frame,to keep it in 32 bits.*/
+    ticks = result->WriteTicks + result->TxWaitTicks + result->RxWaitTicks + result->ReadTicks;
+    if (result->Frames && (ticks >= result->Frames)){
+        ticks /= result->Frames;
+        result->FramesPerSec = PROFTIMER_HZ / ticks;
+        result->BytesPerSec = result->FramesPerSec * len;
+    }
+    return TRUE;
+#else
+    (void)enc;
+    (void)frame;
+    (void)len;
+    (void)count;
+    (void)result;
+    return FALSE;
+#endif
+}
+
+/*------------------------Private Functions-----------------------------*/
+
+/*******************************************************************************
+* Function Name: ReadETHReg
+********************************************************************************
+* Summary:
+*   Reads an ETH Register.Assumes that the correct bank is already selected.
+*
+* Parameters:
+*   enc - the chip.
+*   bytAddress - Address of the Register to be Read.
+*
+* Returns:
+*   Data in the Register,as an unsigned char.
+*******************************************************************************/
+static unsigned char ReadETHReg(ENC28J60* enc, unsigned char bytAddress){
+    /*Define the datahold for incoming Register Data.*/
+    unsigned char bytData;
+
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+    
+    spiTxBuffer(&bytAddress,1);//Write the OpCode
+    spiRxBuffer(&bytData, 1);//Read the Data
+    
+    enc->Select(FALSE);//Deactivate CS(Pulled High.)
+    PROF_END(bytAddress, 2);
+  
+  /*Return the data fetched.*/
+    return bytData;
+}
+
+/*******************************************************************************
+* Function Name: ReadMacReg
+********************************************************************************
+* Summary:
+*   Reads a MAC Register.Assumes that the correct bank is already selected.
+*
+* Parameters:
+*   enc - the chip.
+*   bytAddress - Address of the Register to be Read.
+*
+* Returns:
+*   Data in the Register,as an unsigned char.
+*******************************************************************************/
+static unsigned char ReadMacReg(ENC28J60* enc, unsigned char bytAddress){
+    /*Define the datahold for incoming Register Data.*/
+    unsigned char bytData;
+    
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+    
+    spiTxBuffer(&bytAddress,1);//Write the OpCode.
+    spiRxBuffer(&bytData, 1);//Read in the Dummy Byte.
+    spiRxBuffer(&bytData, 1);//Read the Actual Value.
+    
+    enc->Select(FALSE);//Deactivate CS(Pulled High.)
+    PROF_END(bytAddress, 3);
+
+    return bytData;
+}
+
+/*******************************************************************************
+* Function Name: WritePhyReg
+********************************************************************************
+* Summary:
+*   Writes to a PHY Reg,following the Indirect Writing sequence detailed in 
+*   Section 3.3.2 on Page 21 of the datasheet.
+*
+* Parameters:
+*   enc - the chip.
+*   bytAddress - Address of the Register to be Read.
+*
+* Returns:
+*   TRUE  - Write executed.
+*   FALSE - Invalid Address.
+*******************************************************************************/
+static unsigned char WritePhyReg(ENC28J60* enc, unsigned char address, unsigned int datapayload){ 
+    if (address > PHYMAXADDR){
+        return FALSE;
+    }   
+    
+    /*Wait for any earlier MII operation to finish,and stop scanning.*/
+    PhyIdle(enc);
+    
+    BankSel(enc, 2);
+    
+    /*Write the address of the PHY register we wish to write to.*/
+    WriteCtrReg(enc, MIREGADR,address);
+    
+    /*Write the lower byte of the Payload to write.*/
+    WriteCtrReg(enc, MIWRL,(unsigned char)datapayload); 
+    
+    /*Write the higher byte of the Payload to write.*/
+    WriteCtrReg(enc, MIWRH,((unsigned char)(datapayload >>8)));
+    
+    PhyResume(enc);
+    return TRUE;
+}
+
+/*******************************************************************************
+* Function Name: ReadPhyReg
+********************************************************************************
+* Summary:
+*   Reads from a PHY Reg,following the indirect reading sequence detailed in 
+*   Section 3.3.1 on Page 21 of the datasheet.
+*
+* Parameters:
+*   enc - the chip.
+*   address - Address of the Register to be Read.
+*
+* Returns:
+*   TRUE  - Write executed.
+*   FALSE - Invalid Address.
+*******************************************************************************/
+static unsigned int ReadPhyReg(ENC28J60* enc, unsigned char address){
+    volatile unsigned int uiData;
+    volatile unsigned char bytStat;
+
+    /*Wait for any earlier MII operation to finish,and stop scanning.*/
+    PhyIdle(enc);
+    
+    BankSel(enc, 2);
+    /*Write into MIREGADR the address of PHY register you want to read.*/
+    WriteCtrReg(enc, MIREGADR,address);
+    
+    /*Set the MIIRD Bit,to request a read.
+    MICMD is a MAC register,so it has to be written whole,Bit Field
+    Set/Clear only work on the ETH registers.*/
+    WriteCtrReg(enc, MICMD, MICMD_MIIRD);
+    
+    /*Wait and Check if the Read has finished execution.MISTAT is in Bank 3.*/
+    BankSel(enc, 3);
+    do{bytStat = ReadMacReg(enc, MISTAT);
+    }while(bytStat & MISTAT_BUSY);
+    BankSel(enc, 2);
+    
+    /*Clear the Read Request bit.*/
+    WriteCtrReg(enc, MICMD, 0x00);
+    
+    /*Read the low,high data bytes,and assemble them*/
+    uiData = (unsigned int)ReadMacReg(enc, MIRDL);       
+    uiData |=((unsigned int)ReadMacReg(enc, MIRDH)<<8); // Read high data byte
+
+    PhyResume(enc);
+    return uiData;
+}
+
+/*******************************************************************************
+* Function Name: PhyIdle
+********************************************************************************
+* Summary:
+*   Gets the MII interface ready for ReadPhyReg or WritePhyReg.A read
+*   started by PHYReadStart is finished,and its result kept for PHYReadPoll.
+*   Scanning is stopped,and started again by PhyResume.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   Nothing.Leaves bank 3 selected.
+*******************************************************************************/
+static void PhyIdle(ENC28J60* enc){
+    BankSel(enc, 3);
+    if ((enc->PhyRead != PHYNONE) && !enc->PhyReadDone){
+        while(ReadMacReg(enc, MISTAT) & MISTAT_BUSY);
+        PhyFetch(enc);
+    }else if (enc->PhyScan != PHYNONE){
+        BankSel(enc, 2);
+        WriteCtrReg(enc, MICMD, 0x00);
+    }
+    
+    BankSel(enc, 3);
+    while(ReadMacReg(enc, MISTAT) & MISTAT_BUSY);
+}
+
+/*******************************************************************************
+* Function Name: PhyResume
+********************************************************************************
+* Summary:
+*   Starts scanning the PHY register set by PHYScanStart again,after
+*   PhyIdle stopped it.MIRD is kept up to date with it every 10.24us.
+*   See Section 3.3.3 on Page 21 of the datasheet.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void PhyResume(ENC28J60* enc){
+    if (enc->PhyScan == PHYNONE){
+        return;
+    }
+    
+    /*A write might still be going out.*/
+    BankSel(enc, 3);
+    while(ReadMacReg(enc, MISTAT) & MISTAT_BUSY);
+    
+    BankSel(enc, 2);
+    WriteCtrReg(enc, MIREGADR, enc->PhyScan);
+    WriteCtrReg(enc, MICMD, MICMD_MIISCAN);
+    enc->PhyScanValid = 0;
+}
+
+/*******************************************************************************
+* Function Name: PhyFetch
+********************************************************************************
+* Summary:
+*   Reads the result of the read started by PHYReadStart out of MIRD,once
+*   MISTAT.BUSY has cleared,and keeps it in PhyValue.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void PhyFetch(ENC28J60* enc){
+    BankSel(enc, 2);
+    WriteCtrReg(enc, MICMD, 0x00);
+    enc->PhyValue = (unsigned int)ReadMacReg(enc, MIRDL);
+    enc->PhyValue |= ((unsigned int)ReadMacReg(enc, MIRDH) << 8);
+    enc->PhyReadDone = 1;
+}
+
+/*******************************************************************************
+* Function Name: WriteCtrReg
+********************************************************************************
+* Summary:
+*   Writes to a control Register.Assumes the correct bank is already selected.
+*
+* Parameters:
+*   enc - the chip.
+*   bytAddress - Address of the Register to be Read.
+*   bytData - The data payload to write.
+*
+* Returns:
+*   Data in the Register,as an unsigned char.
+*******************************************************************************/
+static unsigned char WriteCtrReg(ENC28J60* enc, unsigned char bytAddress,unsigned char bytData){
+    
+    /*Check Validity of Address*/
+    if (bytAddress > 0x1f){
+        return FALSE;
+    }
+    /*Keep the ECON1 shadow in step.*/
+    if (bytAddress == ECON1){
+        enc->ECON1Shadow = bytData;
+    }
+    
+    bytAddress |= WCR_OP;//Set the Opcode.
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+    spiTxBuffer(&bytAddress,1);//Send the OpCode and Address.
+    spiTxBuffer(&bytData,1);//Send the data payload.
+    enc->Select(FALSE);//Deactivate CS(Pulled High.)
+    PROF_END(bytAddress, 2);
+  
+    return TRUE;
+}
+
+/*******************************************************************************
+* Function Name: ReadMacBuffer
+********************************************************************************
+* Summary:
+*   Reads the 8kb buffer of the ENC chip.
+*
+* Parameters:
+*   enc - the chip.
+*   bytBuffer - The buffer to store the read data.
+*   byt_length - Number of bytes to read into bytBuffer.
+*
+* Returns:
+*   Number of bytes read.
+*******************************************************************************/
+static unsigned int ReadMacBuffer(ENC28J60* enc, unsigned char * bytBuffer,unsigned int byt_length){
+    unsigned char bytOpcode;
+    volatile unsigned int len;
+
+    bytOpcode = RBM_OP;//Set the Opcode.
+    
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+    
+    spiTxBuffer(&bytOpcode,1);//Send the OpCode.
+    len = spiRxBuffer(bytBuffer, byt_length);//Read bytes into the buffer.
+    
+    enc->Select(FALSE);//Deactivate CS(Pulled High.)
+    PROF_END(bytOpcode, 1 + len);
+    
+    /*ERDPT has moved along,wrapping at the end of the RX buffer.*/
+    if (enc->RdPtr != RDPTUNKNOWN){
+        if ((enc->RdPtr <= enc->Layout.RxEnd) && ((enc->RdPtr + len) > enc->Layout.RxEnd)){
+            enc->RdPtr = enc->RdPtr + len - (enc->Layout.RxEnd - enc->Layout.RxStart + 1);
+        }else{
+            enc->RdPtr += len;
+        }
+    }
+  
+    return len;
+}
+
+
+/*******************************************************************************
+* Function Name: WriteMacBuffer
+********************************************************************************
+* Summary:
+*   Writes the 8kb buffer of the ENC chip.Assumes auto increment is ON.
+*
+* Parameters:
+*   enc - the chip.
+*   bytBuffer - The buffer that stores data to be written.
+*   ui_len - Number of bytes to write into bytBuffer.
+*
+* Returns:
+*   Number of bytes written.
+*******************************************************************************/
+static unsigned int WriteMacBuffer(ENC28J60* enc, unsigned char * bytBuffer,unsigned int ui_len){
+    unsigned char bytOpcode;
+    volatile unsigned int len;
+
+    bytOpcode = WBM_OP;//Set the opcode.
+    
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+      
+    spiTxBuffer(&bytOpcode,1);//Send the opcode
+    len = spiTxBuffer(bytBuffer, ui_len);//Send the bytes out
+    
+    enc->Select(FALSE);//Deactivate CS(Pulled High.)
+    PROF_END(bytOpcode, 1 + len);
+  
+    return len;
+}
+
+/*******************************************************************************
+* Function Name: SetBitField
+********************************************************************************
+* Summary:
+*   Sets those bits in the register at location bytAddress,which are set in bytData.
+*   Assumes that the correct bank is already selected.
+* Parameters:
+*   enc - the chip.
+*   bytAddress - Address of the register
+*   bytData - appropriate bitmask that needs to be set.
+*
+* Returns:
+*   TRUE - Command executed.
+*   FALSE - Invalid Address.
+*******************************************************************************/
+static unsigned char SetBitField(ENC28J60* enc, unsigned char bytAddress, unsigned char bytData){
+    
+    if (bytAddress > 0x1f){
+        return FALSE;
+    }
+
+    /*Keep the ECON1 shadow in step.*/
+    if (bytAddress == ECON1){
+        enc->ECON1Shadow |= bytData;
+    }
+
+    bytAddress |= BFS_OP;//Set the opcode.
+    
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+ 
+    spiTxBuffer(&bytAddress,1);//Send the opcode and address.
+    spiTxBuffer(&bytData,1);//Send the data.
+    
+    enc->Select(FALSE);//Deactivate CS(Pulled High.)
+    PROF_END(bytAddress, 2);
+  
+    return TRUE;
+}
+
+/*******************************************************************************
+* Function Name: ClrBitField
+********************************************************************************
+* Summary:
+*   Clears those bits in the register at location bytAddress,which are set in bytData.
+*   Assumes that the correct bank is already selected.
+* Parameters:
+*   enc - the chip.
+*   bytAddress - Address of the register
+*   bytData - appropriate bitmask that needs to be cleared.
+*
+* Returns:
+*   TRUE - Command executed.
+*   FALSE - Invalid Address.
+*******************************************************************************/
+static unsigned char ClrBitField(ENC28J60* enc, unsigned char bytAddress, unsigned char bytData){
+    
+    if (bytAddress > 0x1f){
+        return FALSE;
+    }
+
+    /*Keep the ECON1 shadow in step.*/
+    if (bytAddress == ECON1){
+        enc->ECON1Shadow &= ~bytData;
+    }
+
+    bytAddress |= BFC_OP;//Set the opcode.
+    
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+
+    spiTxBuffer(&bytAddress,1);//Send the opcode and address.
+    spiTxBuffer(&bytData,1);//Send the data.
+    
+    enc->Select(FALSE);//Deactivate CS(Pulled Low.)
+    PROF_END(bytAddress, 2);
+  
+    return TRUE;
+}
+
+/*******************************************************************************
+* Function Name: BankSel
+********************************************************************************
+* Summary:
+*   Sets the correct bank,for further register manipulation.
+*   Note that you should call this before any register manipulation,to set the
+*   right bank.EIE,EIR,ESTAT,ECON2 and ECON1 need no bank selection.
+*   The current bank is taken from the ECON1 shadow,so nothing is sent if
+*   the bank is already selected,and only the BSEL bits that change are
+*   touched,using Bit Field Set/Clear instead of a read-modify-write.
+* Parameters:
+*   enc - the chip.
+*   bank - can be either of 0,1,2 or 3,depending on which bank you want to set.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void BankSel(ENC28J60* enc, unsigned char bank){
+    unsigned char current;
+    if (bank >3)
+        return;
+        
+    current = enc->ECON1Shadow & ECON1_BSEL;
+    if (current == bank){
+        return;//Already there.
+    }
+    
+    if (current & ~bank){
+        ClrBitField(enc, ECON1, current & ~bank);//Clear the BSEL bits we dont want.
+    }
+    if (bank & ~current){
+        SetBitField(enc, ECON1, bank & ~current);//Set the BSEL bits we need.
+    }
+}
+/*******************************************************************************
+* Function Name: ResetMac
+********************************************************************************
+* Summary:
+*   Sends a Soft Reset command over SPI to the chip,and waits till its
+*   clock is running again,going by ESTAT.CLKRDY.The wait is bounded,
+*   so this cannot hang on a chip that is not there.
+* Parameters:
+*   enc - the chip.
+* Returns:
+*   TRUE(0)- if CLKRDY came back.
+*   FALSE(1) - if it did not,within CLKRDYTRIES polls.
+*******************************************************************************/
+static unsigned char ResetMac(ENC28J60* enc){
+    unsigned char bytOpcode = RESET_OP;
+    unsigned char tries;
+    
+    enc->Select(TRUE);//Activate CS(Pulled Low.)
+    PROF_BEGIN();
+    
+    spiTxBuffer(&bytOpcode,1);//Send the Command.
+    
+    enc->Select(FALSE);//Deactivate CS(Pulled High.)
+    PROF_END(bytOpcode, 1);
+    
+    /*ECON1 comes out of reset as 0x00,so Bank 0 is selected.*/
+    enc->ECON1Shadow = 0x00;
+    
+    /*CLKRDY is not cleared by a soft reset,so it cannot be trusted till
+    the chip has had 1ms to stop its clock and start it again.
+    (See No.2 in the Silicon Errata.)*/
+    CyDelay(1);
+    for (tries = CLKRDYTRIES; tries && !(ReadETHReg(enc, ESTAT) & ESTAT_CLKRDY); tries--){
+        CyDelayUs(CLKRDYPOLLUS);
+    }
+    return tries ? TRUE : FALSE;
+}
+
+
+/*******************************************************************************
+* Function Name: RxOpen
+********************************************************************************
+* Summary:
+*   Checks for a received packet,and if there is one,reads its status vector
+*   into enc->RxStatus and opens it for RxReadAt.Nothing of the packet itself
+*   is read.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   Nothing.RxPckOpen is set if a packet was opened.
+*******************************************************************************/
+static void RxOpen(ENC28J60* enc){
+    unsigned char pckCount;
+    unsigned char woken = 0;
+    unsigned int next;
+    unsigned int len;
+    
+#if (ENC_INT_ENABLED)
+    /*Unless we are polling,dont touch the bus till the INT pin has fired.*/
+    if ((enc->RxMode != RXMODE_POLL) && !enc->RxPolling){
+        if (!enc->RxPending){
+            return;
+        }
+        enc->RxPending = 0;
+        woken = 1;
+        
+        /*It might have been the link that changed.*/
+        CheckLink(enc);
+    }
+#endif
+
+	/*Check if Link is Up*/
+    if(IsLinkUp(enc)==0){
+#if (ENC_INT_ENABLED)
+        /*If INT is still low,PKTIF is holding it there,so the LINKIF of
+        the link coming back makes no new edge.Keep RxPending set,so that
+        IsLinkUp keeps looking till it does.*/
+        if ((enc->RxMode != RXMODE_POLL) && !enc->RxPolling && (PACKET_Read() == 0)){
+            enc->RxPending = 1;
+        }
+#endif
+        return;
+    }
+	
+    /*Read EPKTCNT to see if we have any packets in.*/
+    BankSel(enc, 1);//Select Bank 1.
+    pckCount = ReadETHReg(enc, EPKTCNT);
+#if (ENC_FULL_DUPLEX)
+    FlowControl(enc, pckCount);
+#endif
+    /*EIR is only read when there are packets in,as only then can there
+    be no room,or when INT has fired,as RXERIF holds INT low too and
+    has to be cleared even if they have all been read.When polling,one
+    flagged as the last packet drains is counted with the next one in.
+    That keeps idle polls down to the one read of EPKTCNT.*/
+    if ((pckCount || woken) && (ReadETHReg(enc, EIR) & EIR_RXERIF)){
+        /*Packets were dropped for want of room(or EPKTCNT hit 255).
+        The ones already in are fine,and drain as usual.*/
+        ClrBitField(enc, EIR, EIR_RXERIF);
+        enc->Stats.RxOverflows++;
+    }
+    if(pckCount == 0){
+#if (ENC_INT_ENABLED)
+        if (enc->RxPolling){
+            /*Drained,so go back to waiting for the interrupt.*/
+            enc->RxPolling = 0;
+            SetBitField(enc, EIE, EIE_PKTIE);
+        }
+#endif
+        return;
+    }
+    
+#if (ENC_INT_ENABLED)
+    if ((enc->RxMode == RXMODE_HYBRID) && !enc->RxPolling && (pckCount > 1)){
+        /*A backlog is building up,mask PKTIE and poll till its gone.*/
+        enc->RxPolling = 1;
+        ClrBitField(enc, EIE, EIE_PKTIE);
+    }
+#endif
+        
+    /*Setup memory pointers to Read in this RX'd packet.*/
+    SetReadPtr(enc, enc->RxNextPtr);
+    
+    /*Read in the Next Packet Pointer,and the following 32bit Status Vector.
+    See FIGURE 7-3: SAMPLE RECEIVE PACKET LAYOUT on Page 45 of the datasheet.*/
+    ReadMacBuffer(enc, (unsigned char*)&enc->RxStatus.v[0],6);
+    
+    /*The packet starts right after,which is where ERDPT is now.*/
+    enc->RxPckPtr = enc->RdPtr;
+    
+    /*Because,Little Endian.*/
+    next = CYSWAP_ENDIAN16(enc->RxStatus.bits.NextPacket);
+    len = CYSWAP_ENDIAN16(enc->RxStatus.bits.ByteCount);
+    
+    /*Packets always start on an even address inside the RX buffer,and
+    are no bigger than MAXFRAMELEN.If not,we have lost our place in the
+    buffer,and it has to be started again.*/
+    if ((next & 1) || (next < enc->Layout.RxStart) || (next > enc->Layout.RxEnd) ||
+        (len < 4) || (len > MAXFRAMELEN + 4)){
+        RxRecover(enc);
+        return;
+    }
+    enc->RxNextPtr = next;
+    
+    /*Compute actual length of the RX'd Packet.*/
+    enc->RxPckLen = len - 4; //We take away 4 as that is the CRC
+    enc->RxPckOpen = 1;
+    
+    /*Keep count.LenOutofRange is left out,as it is set for every packet
+    with a type field instead of a length.*/
+    if (enc->RxStatus.bits.RxOk){
+        enc->Stats.RxFrames++;
+        enc->Stats.RxBytes += enc->RxPckLen;
+        if (enc->RxStatus.bits.RxBroadCast){
+            enc->Stats.RxBroadcast++;
+        }else if (enc->RxStatus.bits.RxMultiCast){
+            enc->Stats.RxMulticast++;
+        }
+    }
+    if (enc->RxStatus.bits.CRCError){
+        enc->Stats.RxCrcErrors++;
+    }
+    if (enc->RxStatus.bits.LenChkError){
+        enc->Stats.RxLengthErrors++;
+    }
+}
+
+/*******************************************************************************
+* Function Name: RxReadAt
+********************************************************************************
+* Summary:
+*   Reads len bytes of the open packet,starting offset bytes in.
+*   Takes care of the packet wrapping around the end of the RX buffer.
+*
+* Parameters:
+*   enc - the chip.
+*   offset - Where in the packet to start reading.
+*   buffer - The buffer to store the read data.
+*   len - Number of bytes to read.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void RxReadAt(ENC28J60* enc, unsigned int offset, unsigned char* buffer, unsigned int len){
+    unsigned int addr;
+    
+    addr = enc->RxPckPtr + offset;
+    if (addr > enc->Layout.RxEnd){
+        addr -= (enc->Layout.RxEnd - enc->Layout.RxStart + 1);
+    }
+    SetReadPtr(enc, addr);
+    ReadMacBuffer(enc, buffer, len);
+}
+
+/*******************************************************************************
+* Function Name: RxRelease
+********************************************************************************
+* Summary:
+*   Frees the space of the open packet in the RX buffer,read or not,by
+*   moving ERXRDPT past it and decrementing EPKTCNT.If PAUSE frames are being
+*   sent,FlowControl is run again with the room that frees up.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void RxRelease(ENC28J60* enc){
+    /*Free up memory in that 8kb buffer by adjusting the RX Read pointer,
+    since we are done with the packet.*/
+    SetRxReadPtr(enc);
+    
+    /*To signal that we are done with the packet,decrement EPKTCNT*/
+    SetBitField(enc, ECON2, ECON2_PKTDEC);
+    enc->RxPckOpen = 0;
+  
+#if (ENC_FULL_DUPLEX)
+    /*With the INT pin,RxOpen is not called again till a packet comes in,
+    and none may while the other end is paused,so see here if the PAUSE
+    frames can stop.*/
+    if (enc->FlowPaused){
+        FlowControl(enc, 0);
+    }
+#endif
+#if (ENC_INT_ENABLED)
+    /*If INT is still low,PKTIF is still set and there will be no new edge,
+    so flag the packets that are still waiting ourselves.*/
+    if ((enc->RxMode != RXMODE_POLL) && !enc->RxPolling && (PACKET_Read() == 0)){
+        enc->RxPending = 1;
+    }
+#endif
+}
+
+/*******************************************************************************
+* Function Name: SetRxReadPtr
+********************************************************************************
+* Summary:
+*   Moves ERXRDPT up to just before RxNextPtr,giving the space of
+*   everything before it back to the chip.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void SetRxReadPtr(ENC28J60* enc){
+    /*Ensure that ERXRDPT is Always ODD! Else Buffer gets corrupted.
+    See No.5 in the Silicon Errata*/                                      
+    BankSel(enc, 0);
+    if ( ((enc->RxNextPtr - 1) < enc->Layout.RxStart) || ((enc->RxNextPtr-1) > enc->Layout.RxEnd) ) {
+        WriteCtrReg(enc, ERXRDPTL, (enc->Layout.RxEnd & 0x00ff));
+        WriteCtrReg(enc, ERXRDPTH, ((enc->Layout.RxEnd & 0xff00) >> 8));
+    }else{
+        WriteCtrReg(enc, ERXRDPTL, (( enc->RxNextPtr - 1 ) & 0x00ff ));
+        WriteCtrReg(enc, ERXRDPTH, ((( enc->RxNextPtr - 1 ) & 0xff00 ) >> 8 ));
+    }
+}
+
+/*******************************************************************************
+* Function Name: RxRecover
+********************************************************************************
+* Summary:
+*   Gets the receive side back into a clean state after the RX buffer has
+*   been found corrupted.Everything in it is thrown away,the receive logic
+*   is reset,and the buffer set up again,empty.
+*   The waits are bounded,so this cannot hang on a chip that is not there.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void RxRecover(ENC28J60* enc){
+    unsigned int tries;
+    
+    enc->Stats.RxResets++;
     
-	/*Check if Link is Up*/
-    if(IsLinkUp()==0){
-        return FALSE;
-    }
-	
-    /*Read EPKTCNT to see if we have any packets in.*/
-    BankSel(1);//Select Bank 1.
-    if(ReadETHReg(EPKTCNT) == 0){
-        return 0;//Report that No Proper Packets RX'd.
+    /*Stop taking in packets,and let the one coming in finish.*/
+    ClrBitField(enc, ECON1, ECON1_RXEN);
+    for (tries = RXRECOVERTRIES; tries && (ReadETHReg(enc, ESTAT) & ESTAT_RXBUSY); tries--){
     }
-        
-    /*Setup memory pointers to Read in this RX'd packet.*/
-    BankSel(0);
-    WriteCtrReg(ERDPTL,(unsigned char)( nextpckptr & 0x00ff));
-    WriteCtrReg(ERDPTH,(unsigned char)((nextpckptr & 0xff00)>>8));
     
-    /*Read in the Next Packet Pointer,and the following 32bit Status Vector.
-    See FIGURE 7-3: SAMPLE RECEIVE PACKET LAYOUT on Page 45 of the datasheet.*/
-    ReadMacBuffer((unsigned char*)&ptrRxStatus.v[0],6);
+    /*Reset the receive logic.That leaves the pointers as they were.*/
+    SetBitField(enc, ECON1, ECON1_RXRST);
+    ClrBitField(enc, ECON1, ECON1_RXRST);
     
-    /*Because,Little Endian.*/
-    nextpckptr = CYSWAP_ENDIAN16(ptrRxStatus.bits.NextPacket);
+    /*Writing ERXST is what moves ERXWRPT back to the start,so the buffer
+    is set up again,as initMAC does,before ERXRDPT.*/
+    BankSel(enc, 0);
+    WriteCtrReg(enc, ERXSTL,(unsigned char)( enc->Layout.RxStart & 0x00ff));
+    WriteCtrReg(enc, ERXSTH,(unsigned char)((enc->Layout.RxStart & 0xff00)>> 8));
+    WriteCtrReg(enc, ERXNDL,(unsigned char)( enc->Layout.RxEnd   & 0x00ff));
+    WriteCtrReg(enc, ERXNDH,(unsigned char)((enc->Layout.RxEnd   & 0xff00)>>8));
     
-    /*Compute actual length of the RX'd Packet.*/
-    pckLen=CYSWAP_ENDIAN16(ptrRxStatus.bits.ByteCount) - 4; //We take away 4 as that is the CRC
+    /*The buffer is empty now,so the next packet goes at the start.*/
+    enc->RxNextPtr = enc->Layout.RxStart;
+    enc->RxPckOpen = 0;
+    enc->RdPtr = RDPTUNKNOWN;
+    SetRxReadPtr(enc);
     
-	if( pckLen > (maxLen-1) ){
-	pckLen = maxLen;
-	}
-	
-    /*Read the packet only if it was RX'd Okay.
-    We should be checking other flags too,like Length Out of Range,
-    but that one doesnt seem reliable.
-    We need more work and testing here.*/
-    if(ptrRxStatus.bits.RxOk==0x01){
-        ReadMacBuffer(packet,pckLen);//Read packet into buffer.
+    /*Count EPKTCNT down to zero.*/
+    BankSel(enc, 1);
+    for (tries = RXRECOVERTRIES; tries && ReadETHReg(enc, EPKTCNT); tries--){
+        SetBitField(enc, ECON2, ECON2_PKTDEC);
     }
+    ClrBitField(enc, EIR, EIR_RXERIF | EIR_PKTIF);
+    
+    SetBitField(enc, ECON1, ECON1_RXEN);
+}
 
-    /*Ensure that ERXRDPT is Always ODD! Else Buffer gets corrupted.
-    See No.5 in the Silicon Errata*/                                      
-    BankSel(0);
-    if ( ((nextpckptr - 1) < RXSTART) || ((nextpckptr-1) > RXEND) ) {
-        /*Free up memory in that 8kb buffer by adjusting the RX Read pointer,
-        since we are done with the packet.*/
-        WriteCtrReg(ERXRDPTL, (RXEND & 0x00ff));
-        WriteCtrReg(ERXRDPTH, ((RXEND & 0xff00) >> 8));
-    }else{
-        WriteCtrReg(ERXRDPTL, (( nextpckptr - 1 ) & 0x00ff ));
-        WriteCtrReg(ERXRDPTH, ((( nextpckptr - 1 ) & 0xff00 ) >> 8 ));
+/*******************************************************************************
+* Function Name: SetReadPtr
+********************************************************************************
+* Summary:
+*   Points ERDPT at addr,unless it is there already.
+*
+* Parameters:
+*   enc - the chip.
+*   addr - Address in the 8kb buffer to read from next.
+*
+* Returns:
+*   Nothing.
+*******************************************************************************/
+static void SetReadPtr(ENC28J60* enc, unsigned int addr){
+    if (addr == enc->RdPtr){
+        return;
     }
-  /*To signal that we are done with the packet,decrement EPKTCNT*/
-  SetBitField(ECON2, ECON2_PKTDEC);
-  
-  /*Return the length of the packet RX'd*/
-  return pckLen;
+    BankSel(enc, 0);
+    WriteCtrReg(enc, ERDPTL,(unsigned char)( addr & 0x00ff));
+    WriteCtrReg(enc, ERDPTH,(unsigned char)((addr & 0xff00)>>8));
+    enc->RdPtr = addr;
 }
 
-/*------------------------Private Functions-----------------------------*/
-
 /*******************************************************************************
-* Function Name: ReadETHReg
+* Function Name: TxAlloc
 ********************************************************************************
 * Summary:
-*   Reads an ETH Register.Assumes that the correct bank is already selected.
+*   Finds a contiguous slot of size bytes in the TX buffer,behind the packets
+*   already queued.Slots are freed in the order they were taken,so the free
+*   space is either after the last slot,or before the oldest one.
+*   The chip does not wrap a packet around the end of the TX buffer,so neither do we.
 *
 * Parameters:
-*   bytAddress - Address of the Register to be Read.
+*   enc - the chip.
+*   size - Number of bytes needed.
 *
 * Returns:
-*   Data in the Register,as an unsigned char.
+*   Start address of the slot,or TXNOROOM.
 *******************************************************************************/
-static unsigned char ReadETHReg(unsigned char bytAddress){
-    /*Define the datahold for incoming Register Data.*/
-    unsigned char bytData;
-
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
+static unsigned int TxAlloc(ENC28J60* enc, unsigned int size){
+    unsigned int oldest;
     
-    spiTxBuffer(&bytAddress,1);//Write the OpCode
-    spiRxBuffer(&bytData, 1);//Read the Data
+    if (enc->TxCount == 0){
+        return (size <= (enc->Layout.TxEnd - enc->Layout.TxStart + 1)) ? enc->Layout.TxStart : TXNOROOM;
+    }
     
-    SPI_SEL(FALSE);//Deactivate CS(Pulled High.)
-  
-  /*Return the data fetched.*/
-    return bytData;
+    oldest = enc->TxQueue[enc->TxHead].start;
+    if (enc->TxTail > oldest){
+        /*Free space is after the tail,and before the oldest slot.*/
+        if (size <= (enc->Layout.TxEnd - enc->TxTail + 1)){
+            return enc->TxTail;
+        }
+        if (size <= (oldest - enc->Layout.TxStart)){
+            return enc->Layout.TxStart;
+        }
+    }else if (size <= (oldest - enc->TxTail)){
+        /*Wrapped around already,free space is between the two.*/
+        return enc->TxTail;
+    }
+    return TXNOROOM;
 }
 
 /*******************************************************************************
-* Function Name: ReadMacReg
+* Function Name: TxStart
 ********************************************************************************
 * Summary:
-*   Reads a MAC Register.Assumes that the correct bank is already selected.
+*   Points ETXST/ETXND at a queued packet and starts its transmission.
 *
 * Parameters:
-*   bytAddress - Address of the Register to be Read.
+*   enc - the chip.
+*   desc - The queued packet.
 *
 * Returns:
-*   Data in the Register,as an unsigned char.
+*   Nothing.
 *******************************************************************************/
-static unsigned char ReadMacReg(unsigned char bytAddress){
-    /*Define the datahold for incoming Register Data.*/
-    unsigned char bytData;
-    
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
+static void TxStart(ENC28J60* enc, TXDESC* desc){
+    BankSel(enc, 0);// select bank 0
     
-    spiTxBuffer(&bytAddress,1);//Write the OpCode.
-    spiRxBuffer(&bytData, 1);//Read in the Dummy Byte.
-    spiRxBuffer(&bytData, 1);//Read the Actual Value.
+    /*Start of the packet,at its control byte*/
+    WriteCtrReg(enc, ETXSTL,(unsigned char)( desc->start & 0x00ff));        
+    WriteCtrReg(enc, ETXSTH,(unsigned char)((desc->start & 0xff00)>>8));
     
-    SPI_SEL(FALSE);//Deactivate CS(Pulled High.)
+	/*Tell MAC when the end of the packet is*/
+	WriteCtrReg(enc, ETXNDL, (unsigned char)( (desc->start+desc->len) & 0x00ff));       
+	WriteCtrReg(enc, ETXNDH, (unsigned char)(((desc->start+desc->len) & 0xff00)>>8));
 
-    return bytData;
+    /*We would like to enable Interrupts on Packet TX complete.*/
+    ClrBitField(enc, EIR,EIR_TXIF);
+    if (!USESINT(enc)){
+        /*Only when the INT pin is not used for RX,TXIF is polled anyway.*/
+        SetBitField(enc, EIE, EIE_TXIE |EIE_INTIE);
+    }
+    
+    /*Macro for Silicon Errata to do with Transmit Logic Reset.
+    Silicon Errata No.12 as per Latest Errata doc for ENC28J60
+    See http://ww1.microchip.com/downloads/en/DeviceDoc/80349c.pdf */
+    ERRATAFIX;    
+    
+    /*Send that Packet!*/
+    SetBitField(enc, ECON1, ECON1_TXRTS);
 }
 
 /*******************************************************************************
-* Function Name: WritePhyReg
+* Function Name: TxChecksum
 ********************************************************************************
 * Summary:
-*   Writes to a PHY Reg,following the Indirect Writing sequence detailed in 
-*   Section 3.3.2 on Page 21 of the datasheet.
+*   Has the DMA engine of the ENC28J60 work out a checksum over part of a
+*   packet in the TX buffer,and writes the result into the packet.
+*   See 14.2 Checksum Calculations on Page 72 of the datasheet.
 *
 * Parameters:
-*   bytAddress - Address of the Register to be Read.
+*   enc - the chip.
+*   base - Address of the first byte of the packet in the TX buffer.
+*   csum - What to checksum,and where to put it.
 *
 * Returns:
-*   TRUE  - Write executed.
-*   FALSE - Invalid Address.
+*   Nothing.
 *******************************************************************************/
-static unsigned char WritePhyReg(unsigned char address, unsigned int datapayload){ 
-    if (address > 0x14){
-        return FALSE;
-    }   
-    BankSel(2);
-    
-    /*Write the address of the PHY register we wish to write to.*/
-    WriteCtrReg(MIREGADR,address);
+static void TxChecksum(ENC28J60* enc, unsigned int base, const CSUMSPEC* csum){
+    unsigned int addr;
+    unsigned char result[2];
     
-    /*Write the lower byte of the Payload to write.*/
-    WriteCtrReg(MIWRL,(unsigned char)datapayload); 
+    RunDma(enc, base + csum->start, base + csum->end, 1);
     
-    /*Write the higher byte of the Payload to write.*/
-    WriteCtrReg(MIWRH,((unsigned char)(datapayload >>8)));
+    /*EDMACSH goes first,as the result is already in network order.*/
+    result[0] = ReadETHReg(enc, EDMACSH);
+    result[1] = ReadETHReg(enc, EDMACSL);
     
-    return TRUE;
+    /*Write it over the checksum field.*/
+    addr = base + csum->field;
+    WriteCtrReg(enc, EWRPTL,(unsigned char)( addr & 0x00ff));
+    WriteCtrReg(enc, EWRPTH,(unsigned char)((addr & 0xff00)>>8));
+    WriteMacBuffer(enc, result, 2);
 }
 
 /*******************************************************************************
-* Function Name: ReadPhyReg
+* Function Name: RunDma
 ********************************************************************************
 * Summary:
-*   Reads from a PHY Reg,following the indirect reading sequence detailed in 
-*   Section 3.3.1 on Page 21 of the datasheet.
+*   Runs the DMA engine of the ENC28J60 over first..last,and waits for it.
+*   To copy,EDMADST must be set up before.To checksum,the result is left
+*   in EDMACS.Leaves bank 0 selected.
+*   See 14.0 Direct Memory Access Controller on Page 71 of the datasheet.
 *
 * Parameters:
-*   address - Address of the Register to be Read.
+*   enc - the chip.
+*   first - Address of the first byte.
+*   last - Address of the last byte.
+*   csum - 1 to checksum the bytes,0 to copy them.
 *
 * Returns:
-*   TRUE  - Write executed.
-*   FALSE - Invalid Address.
+*   Nothing.
 *******************************************************************************/
-static unsigned int ReadPhyReg(unsigned char address){
-    volatile unsigned int uiData;
-    volatile unsigned char bytStat;
-
-    BankSel(2);
-    /*Write into MIREGADR the address of PHY register you want to read.*/
-    WriteCtrReg(MIREGADR,address);
+static void RunDma(ENC28J60* enc, unsigned int first, unsigned int last, unsigned char csum){
+    BankSel(enc, 0);
+    WriteCtrReg(enc, EDMASTL,(unsigned char)( first & 0x00ff));
+    WriteCtrReg(enc, EDMASTH,(unsigned char)((first & 0xff00)>>8));
+    WriteCtrReg(enc, EDMANDL,(unsigned char)( last & 0x00ff));
+    WriteCtrReg(enc, EDMANDH,(unsigned char)((last & 0xff00)>>8));
     
-    /*Set the MIIRD Bit,to request a read.*/
-    SetBitField(MICMD, MICMD_MIIRD);
+    if (csum){
+        SetBitField(enc, ECON1, ECON1_CSUMEN);
+    }
+    SetBitField(enc, ECON1, ECON1_DMAST);
     
-    /*Wait and Check if the Read has finished execution*/
-    do{bytStat = ReadMacReg(MISTAT);
-    }while(bytStat & MISTAT_BUSY);
+    /*DMAST clears once it is done.*/
+    while (ReadETHReg(enc, ECON1) & ECON1_DMAST){
+    }
+    ClrBitField(enc, ECON1, ECON1_CSUMEN | ECON1_DMAST);
+}
+
+/*******************************************************************************
+* Function Name: HashPointer
+********************************************************************************
+* Summary:
+*   Works out which bit of the hash table filter a destination MAC address
+*   falls on.That is bits 28:23 of the Ethernet CRC-32 over the address,
+*   as the ENC28J60 computes it.
+*   See 8.3.4 Hash Table Filter on Page 52 of the datasheet.
+*
+* Parameters:
+*   mac - The MAC address.
+*
+* Returns:
+*   The bit pointer,0 to 63.
+*******************************************************************************/
+static unsigned char HashPointer(const unsigned char* mac){
+    unsigned long crc = 0xFFFFFFFF;
+    unsigned char i, j;
+    unsigned char bytData;
     
-    /*Clear the Read Request bit.*/
-    ClrBitField(MICMD,MICMD_MIIRD);
+    /*Bytes go in as they go on the wire,least significant bit first.*/
+    for (i = 0; i < 6; i++){
+        bytData = mac[i];
+        for (j = 0; j < 8; j++){
+            if (((crc >> 31) ^ bytData) & 0x01){
+                crc = (crc << 1) ^ 0x04C11DB7;
+            }else{
+                crc <<= 1;
+            }
+            bytData >>= 1;
+        }
+    }
     
-    /*Read the low,high data bytes,and assemble them*/
-    uiData = (unsigned int)ReadMacReg(MIRDL);       
-    uiData |=((unsigned int)ReadMacReg(MIRDH)<<8); // Read high data byte
-
-    return uiData;
+    return (unsigned char)((crc >> 23) & 0x3f);
 }
 
 /*******************************************************************************
-* Function Name: WriteCtrReg
+* Function Name: FindGroup
 ********************************************************************************
 * Summary:
-*   Writes to a control Register.Assumes the correct bank is already selected.
+*   Looks for a multicast group in the list of those joined.
 *
 * Parameters:
-*   bytAddress - Address of the Register to be Read.
-*   bytData - The data payload to write.
+*   enc - the chip.
+*   mac - The group's MAC address.
 *
 * Returns:
-*   Data in the Register,as an unsigned char.
+*   Its index in McastGroups,or McastCount if it is not there.
 *******************************************************************************/
-static unsigned char WriteCtrReg(unsigned char bytAddress,unsigned char bytData){
+static unsigned char FindGroup(ENC28J60* enc, const unsigned char* mac){
+    unsigned char i;
     
-    /*Check Validity of Address*/
-    if (bytAddress > 0x1f){
-        return FALSE;
+    for (i = 0; i < enc->McastCount; i++){
+        if (memcmp(enc->McastGroups[i].mac, mac, 6) == 0){
+            break;
+        }
     }
-    bytAddress |= WCR_OP;//Set the Opcode.
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
-    spiTxBuffer(&bytAddress,1);//Send the OpCode and Address.
-    spiTxBuffer(&bytData,1);//Send the data payload.
-    SPI_SEL(FALSE);//Deactivate CS(Pulled High.)
-  
-    return TRUE;
+    return i;
 }
 
+#if (ENC_FULL_DUPLEX)
 /*******************************************************************************
-* Function Name: ReadMacBuffer
+* Function Name: FlowControl
 ********************************************************************************
 * Summary:
-*   Reads the 8kb buffer of the ENC chip.
+*   Has the ENC28J60 send PAUSE frames while the RX buffer is over half
+*   full,and stop once it is down to a quarter,by sending one with a zero
+*   pause time.The fill level is only read if there is a backlog,or
+*   frames are being paused.Called from RxOpen,and from RxRelease while
+*   paused.
+*   See 6.7 Flow Control on Page 41 of the datasheet.
 *
 * Parameters:
-*   bytBuffer - The buffer to store the read data.
-*   byt_length - Number of bytes to read into bytBuffer.
+*   enc - the chip.
+*   pckCount - Packets waiting,as read from EPKTCNT.
 *
 * Returns:
-*   Number of bytes read.
+*   Nothing.
 *******************************************************************************/
-static unsigned int ReadMacBuffer(unsigned char * bytBuffer,unsigned int byt_length){
-    unsigned char bytOpcode;
-    volatile unsigned int len;
-
-    bytOpcode = RBM_OP;//Set the Opcode.
+static void FlowControl(ENC28J60* enc, unsigned char pckCount){
+    unsigned int size;
+    unsigned int used;
+    unsigned int wrPtr;
     
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
+    if (!enc->FlowPaused && (pckCount < 2)){
+        return;
+    }
     
-    spiTxBuffer(&bytOpcode,1);//Send the OpCode.
-    len = spiRxBuffer(bytBuffer, byt_length);//Read bytes into the buffer.
+    /*Bytes in the RX buffer,from the next packet to be read up to
+    where the chip is writing.*/
+    size = enc->Layout.RxEnd - enc->Layout.RxStart + 1;
+    BankSel(enc, 0);
+    wrPtr = ReadETHReg(enc, ERXWRPTL);
+    wrPtr |= (unsigned int)ReadETHReg(enc, ERXWRPTH) << 8;
+    if (wrPtr >= enc->RxNextPtr){
+        used = wrPtr - enc->RxNextPtr;
+    }else{
+        used = size - (enc->RxNextPtr - wrPtr);
+    }
     
-    SPI_SEL(FALSE);//Deactivate CS(Pulled High.)
-  
-    return len;
+    BankSel(enc, 3);
+    if (!enc->FlowPaused && (used > (size >> 1))){
+        /*Send PAUSE frames,again and again,till told to stop.*/
+        WriteCtrReg(enc, EFLOCON, EFLOCON_FCEN1 | EFLOCON_FCEN0);
+        enc->FlowPaused = 1;
+    }else if (enc->FlowPaused && (used < (size >> 2))){
+        /*Send one with a zero pause time,then stop.*/
+        WriteCtrReg(enc, EFLOCON, EFLOCON_FCEN1);
+        enc->FlowPaused = 0;
+    }
 }
+#endif
 
-
+#if (ENC_BENCH_ENABLED)
 /*******************************************************************************
-* Function Name: WriteMacBuffer
+* Function Name: BenchLap
 ********************************************************************************
 * Summary:
-*   Writes the 8kb buffer of the ENC chip.Assumes auto increment is ON.
+*   Takes a lap time off ProfTimer,for MACLoopbackBench.
 *
 * Parameters:
-*   bytBuffer - The buffer that stores data to be written.
-*   ui_len - Number of bytes to write into bytBuffer.
+*   mark - ProfTimer count at the end of the last lap,moved on to now.
 *
 * Returns:
-*   Number of bytes written.
+*   ProfTimer ticks since the last lap.
 *******************************************************************************/
-static unsigned int WriteMacBuffer(unsigned char * bytBuffer,unsigned int ui_len){
-    unsigned char bytOpcode;
-    volatile unsigned int len;
-
-    bytOpcode = WBM_OP;//Set the opcode.
-    
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
-      
-    spiTxBuffer(&bytOpcode,1);//Send the opcode
-    len = spiTxBuffer(bytBuffer, ui_len);//Send the bytes out
+static unsigned int BenchLap(unsigned int* mark){
+    unsigned int now;
+    unsigned int ticks;
     
-    SPI_SEL(FALSE);//Deactivate CS(Pulled High.)
-  
-    return len;
+    /*ProfTimer counts down.*/
+    now = ProfTimer_ReadCounter();
+    ticks = *mark - now;
+    *mark = now;
+    return ticks;
 }
+#endif
 
+#if (SPI_PROF_ENABLED)
 /*******************************************************************************
-* Function Name: SetBitField
+* Function Name: ProfRecord
 ********************************************************************************
 * Summary:
-*   Sets those bits in the register at location bytAddress,which are set in bytData.
-*   Assumes that the correct bank is already selected.
+*   Puts an SPI transaction that has just finished down to its opcode,
+*   and to the driver function it was done for.
+*
 * Parameters:
-*   bytAddress - Address of the register
-*   bytData - appropriate bitmask that needs to be set.
+*   op - The opcode byte sent,with the address in its low bits.
+*   bytes - Bytes clocked,opcode included.
 *
 * Returns:
-*   TRUE - Command executed.
-*   FALSE - Invalid Address.
+*   Nothing.
 *******************************************************************************/
-static unsigned char SetBitField(unsigned char bytAddress, unsigned char bytData){
+static void ProfRecord(unsigned char op, unsigned int bytes){
+    unsigned int ticks;
+    SPIPROFENTRY* entry;
     
-    if (bytAddress > 0x1f){
-        return FALSE;
-    }
-
-    bytAddress |= BFS_OP;//Set the opcode.
+    /*ProfTimer counts down.*/
+    ticks = ProfStart - ProfTimer_ReadCounter();
     
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
- 
-    spiTxBuffer(&bytAddress,1);//Send the opcode and address.
-    spiTxBuffer(&bytData,1);//Send the data.
+    /*The opcode is in the top 3 bits.*/
+    entry = &Prof.ByOp[op >> 5];
+    entry->Count++;
+    entry->Bytes += bytes;
+    entry->Ticks += ticks;
     
-    SPI_SEL(FALSE);//Deactivate CS(Pulled High.)
-  
-    return TRUE;
+    entry = &Prof.BySite[ProfSite];
+    entry->Count++;
+    entry->Bytes += bytes;
+    entry->Ticks += ticks;
 }
+#endif
 
 /*******************************************************************************
-* Function Name: ClrBitField
+* Function Name: TxSlot
 ********************************************************************************
 * Summary:
-*   Clears those bits in the register at location bytAddress,which are set in bytData.
-*   Assumes that the correct bank is already selected.
+*   Retires whatever has gone out,then finds room in the TX buffer for a
+*   packet,if there is a free entry in the queue.
+*
 * Parameters:
-*   bytAddress - Address of the register
-*   bytData - appropriate bitmask that needs to be cleared.
+*   enc - the chip.
+*   len - Length of the packet.
 *
 * Returns:
-*   TRUE - Command executed.
-*   FALSE - Invalid Address.
+*   Address of the slot,or TXNOROOM if there is none or the link is down.
 *******************************************************************************/
-static unsigned char ClrBitField(unsigned char bytAddress, unsigned char bytData){
-    
-    if (bytAddress > 0x1f){
-        return FALSE;
+static unsigned int TxSlot(ENC28J60* enc, unsigned int len){
+	/*Check if Link is Up*/
+    if(IsLinkUp(enc)==0){
+        return TXNOROOM;
     }
-
-    bytAddress |= BFC_OP;//Set the opcode.
     
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
-
-    spiTxBuffer(&bytAddress,1);//Send the opcode and address.
-    spiTxBuffer(&bytData,1);//Send the data.
+    /*Retire whatever has finished,to make room.*/
+    MACService(enc);
     
-    SPI_SEL(FALSE);//Deactivate CS(Pulled Low.)
-  
-    return TRUE;
+    if (enc->TxCount == TXQUEUELEN){
+        return TXNOROOM;
+    }
+    return TxAlloc(enc, len + TXSLOTEXTRA);
 }
 
 /*******************************************************************************
-* Function Name: BankSel
+* Function Name: TxCommit
 ********************************************************************************
 * Summary:
-*   Sets the correct bank,for further register manipulation.
-*   Note that you should call this before any register manipulation,to set the
-*   right bank.
+*   Fills in the checksums of a packet that has been written to its slot,
+*   adds it to the queue,and starts it if the transmitter is free.
+*
 * Parameters:
-*   bank - can be either of 0,1,2 or 3,depending on which bank you want to set.
+*   enc - the chip.
+*   start - Address of the slot,as from TxSlot.
+*   len - Length of the packet.
+*   csum - Checksums for the DMA engine to fill in.
+*   count - How many there are in csum.
+*   done - Called once it has gone out,or 0.
 *
 * Returns:
 *   Nothing.
 *******************************************************************************/
-static void BankSel(unsigned char bank){
-    volatile unsigned char temp;
-    if (bank >3)
-        return;
-        
-    temp = ReadETHReg(ECON1);//Read ECON1 Register.
-    temp &= ~ECON1_BSEL;//Mask off the BSEL<1:0> bits
-    temp |= bank;//Set the new BSEL bits.
-    WriteCtrReg(ECON1, temp);//Write the new ECON1 back.
+static void TxCommit(ENC28J60* enc, unsigned int start, unsigned int len, const CSUMSPEC* csum, unsigned char count, TXCALLBACK done){
+    unsigned char i;
+    TXDESC* desc;
+    
+    /*Have the DMA engine fill in the checksums,now that the packet is in.
+    The packet starts after the control byte.*/
+    for (i = 0; i < count; i++){
+        TxChecksum(enc, start + 1, &csum[i]);
+    }
+    
+    /*Add it to the queue*/
+    desc = &enc->TxQueue[(enc->TxHead + enc->TxCount) % TXQUEUELEN];
+    desc->start = start;
+    desc->len = len;
+    desc->done = done;
+    desc->retries = TXLATECOLRETRIES;
+    enc->TxCount++;
+    enc->TxTail = start + len + TXSLOTEXTRA;
+    
+    /*Send it now,if the transmitter is free.*/
+    if (enc->TxCount == 1){
+        TxStart(enc, desc);
+    }
 }
+
 /*******************************************************************************
-* Function Name: ResetMac
+* Function Name: TxFinish
 ********************************************************************************
 * Summary:
-*   Sends a Soft Reset command over SPI to the chip.
-*   Gives a large delay of 1second before returning.
-*   right bank.
+*   Reads the TX status vector of a packet that has gone out into enc->TxStatus,
+*   and clears the TX flags for the next one.
+*   See TABLE 7-1: TRANSMIT STATUS VECTORS on Page 43 of the datasheet.
+*
 * Parameters:
-*   none.
+*   enc - the chip.
+*   desc - The packet that was on the wire.
+*
 * Returns:
-*   Nothing.
+*   TRUE(0)- if the Packet was successfully transmitted.
+*   FALSE(1) - if the Packet was not successfully transmitted.
 *******************************************************************************/
-static void ResetMac(void){
-    unsigned char bytOpcode = RESET_OP;
+static unsigned char TxFinish(ENC28J60* enc, TXDESC* desc){
+    unsigned int ptr;
     
-    SPI_SEL(TRUE);//Activate CS(Pulled Low.)
+    /*Clear TXRTS,since the packet has been TX'd.*/
+    ClrBitField(enc, ECON1, ECON1_TXRTS);
     
-    spiTxBuffer(&bytOpcode,1);//Send the Command.
+    /*The status vector is written right after the last byte of the packet.*/
+    ptr = desc->start + desc->len + 1;
+    SetReadPtr(enc, ptr);
     
-    SPI_SEL(FALSE);//Deactivate CS(Pulled High.)
+    /*Read In the TX Status Vectors*/
+    /*Note: Use these for debugging.Really useful.*/
+    ReadMacBuffer(enc, &enc->TxStatus.v[0],7);
     
-    /*Give it 1sec to come out of Reset.*/
-    CyDelay(1000);
-}
+    /*Keep count.See TABLE 7-1: TRANSMIT STATUS VECTORS on Page 43.*/
+    enc->Stats.TxCollisions += enc->TxStatus.bits.CollisionCount;
+    if (enc->TxStatus.bits.LateCollision){
+        enc->Stats.TxLateCollisions++;
+    }
+    if (enc->TxStatus.bits.PacketDefer){
+        enc->Stats.TxDeferrals++;
+    }
+    if (enc->TxStatus.bits.Done){
+        enc->Stats.TxFrames++;
+        enc->Stats.TxBytes += CYSWAP_ENDIAN16(enc->TxStatus.bits.ByteCount);
+        if (enc->TxStatus.bits.Broadcast){
+            enc->Stats.TxBroadcast++;
+        }else if (enc->TxStatus.bits.Multicast){
+            enc->Stats.TxMulticast++;
+        }
+    }else if (!(enc->TxStatus.bits.LateCollision && desc->retries)){
+        /*One cut short by a late collision is sent again by MACService,
+        so is not given up on yet.*/
+        enc->Stats.TxAborts++;
+    }
 
+    /*Read TX status vectors to see if TX was interrupted.*/
+    if (ReadETHReg(enc, ESTAT) & ESTAT_TXABRT){
+        ClrBitField(enc, EIR, EIR_TXERIF | EIR_TXIF);//Clear the Interrupt Flags.
+        ClrBitField(enc, ESTAT,ESTAT_TXABRT | ESTAT_LATECOL);//Clear the Abort and Late Collision Flags.
+        enc->TxLastStatus = FALSE;//Report a Failed Packet TX.
+    }else{
+        enc->TxLastStatus = TRUE;//Packet Sent Okay! :-)
+    }
+    return enc->TxLastStatus;
+}
 
 /*******************************************************************************
 * Function Name: IsLinkUp
@@ -617,13 +2257,52 @@ static void ResetMac(void){
 *   Do not call this before initMAC,since SPIM is started in InitMAC function.
 *
 * Parameters:
-*   none.
+*   enc - the chip.
 *
 * Returns:
 *   0x01 - If link is up.
 *   0x00 - If link is not up.
 *
+*   The state is cached,and only re-read from the PHY after a link change.
+*   On the chip wired to the INT pin,link changes are picked up by MACRead.
+*   On the others,EIR.LINKIF is checked every LINKCHECKINTERVAL calls.
+*
+*******************************************************************************/
+unsigned char IsLinkUp(ENC28J60* enc){
+    PROF_ENTER(SPIPROF_LINK);
+    if (!USESINT(enc) && (++enc->LinkCheckCount >= LINKCHECKINTERVAL)){
+        enc->LinkCheckCount = 0;
+        CheckLink(enc);
+    }
+#if (ENC_INT_ENABLED)
+    /*While the link is down,MACRead does not get as far as looking at
+    what the INT pin flagged,so have a look here.*/
+    if (USESINT(enc) && !enc->LinkUp && enc->RxPending){
+        CheckLink(enc);
+    }
+#endif
+    PROF_LEAVE();
+    return enc->LinkUp;
+}
+
+/*******************************************************************************
+* Function Name: CheckLink
+********************************************************************************
+* Summary:
+*   Checks EIR.LINKIF,and if the PHY has flagged a link change,re-reads
+*   the link state from PHSTAT2 into the cached LinkUp.
+*   Reading PHIR clears PLNKIF and PGIF,which clears LINKIF.
+*
+* Parameters:
+*   enc - the chip.
+*
+* Returns:
+*   nothing.
+*
 *******************************************************************************/
-unsigned char IsLinkUp(void){
-    return(unsigned char)(ReadPhyReg(PHSTAT2) && 0x0400);
+static void CheckLink(ENC28J60* enc){
+    if (ReadETHReg(enc, EIR) & EIR_LINKIF){
+        ReadPhyReg(enc, PHIR);
+        enc->LinkUp = (ReadPhyReg(enc, PHSTAT2) & PHSTAT2_LSTAT) ? 0x01 : 0x00;
+    }
 }
\ No newline at end of file
@@ -20,22 +20,55 @@
 #ifndef ENC28J60_H
 #define ENC28J60_H
 
+/*Split of the ENC28J60's 8kb buffer between RX and TX,as passed to initMAC.
+RxEnd has to be odd,and TX has to come after RX.Any SRAM outside of the
+two is left alone by the driver,and is free to use as scratch space.*/
+typedef struct {
+    unsigned int RxStart;
+    unsigned int RxEnd;
+    unsigned int TxStart;
+    unsigned int TxEnd;
+} MEMLAYOUT;
+
+/*One ENC28J60 on the SPI bus,see ENC28J60 below.*/
+typedef struct ENC28J60 ENC28J60;
+
+/*Drives the chip select line of an ENC28J60,eg. SS_Write for a pin called "SS".
+Called with TRUE(0) to pull it low,and FALSE(1) to let it go high.*/
+typedef void (*ENCSELECT)(unsigned char level);
+
+/*4kb RX,4kb TX.The layout this driver has always used.*/
+extern const MEMLAYOUT MemLayoutBalanced;
+/*6kb RX,2kb TX.For nodes that mostly listen,and get bursts of traffic.*/
+extern const MEMLAYOUT MemLayoutRxHeavy;
+/*3kb RX,5kb TX.For nodes that mostly send,so more frames can be queued.*/
+extern const MEMLAYOUT MemLayoutTxHeavy;
 
 
 /*******************************************************************************
 * Function Name: initMAC
 ********************************************************************************
 * Summary:
-*   Initializes the ENC28J60 Chip.
+*   Initializes the ENC28J60 Chip,and the handle the other functions
+*   use to get at it.Each chip on the SPI bus needs a handle,and a chip
+*   select line,of its own.
 *
 * Parameters:
+*   enc - the handle to set up.
+*   select - drives the chip select line of this chip.
 *   deviceMAC - The MAC Address to be assigned to the ENC28J60
+*   layout - How the 8kb buffer is split between RX and TX.Use one of
+*            MemLayoutBalanced,MemLayoutRxHeavy,MemLayoutTxHeavy or your own.
+*            Passing 0,or a layout that does not make sense,gets you
+*            MemLayoutBalanced.
 *
 * Returns:
-*   nothing.
+*   TRUE(0)- if the chip was set up.
+*   FALSE(1) - if its clock did not come back after the Soft Reset,
+*              as when there is no chip there.
 *
 *******************************************************************************/
-void initMAC(unsigned char* deviceMAC);
+unsigned char initMAC(ENC28J60* enc, ENCSELECT select, unsigned char* deviceMAC, const MEMLAYOUT* layout);
 
 
 /*******************************************************************************
@@ -43,8 +76,10 @@ void initMAC(unsigned char* deviceMAC);
 ********************************************************************************
 * Summary:
 *   This function writes a packet to ENC28J60's buffer,and sends it.
+*   It waits till the packet,and any queued before it,have gone out.
 *
 * Parameters:
+*   enc - the chip,as set up by initMAC.
 *   packet - The buffer that contains the packet to be written.
 *   len - The length of the packet present in the buffer 'packet'
 *
@@ -53,7 +88,194 @@ void initMAC(unsigned char* deviceMAC);
 *   FALSE(1) - if the Packet was not successfully transmitted.
 *
 *******************************************************************************/
-unsigned char MACWrite(unsigned char* packet, unsigned int len);
+unsigned char MACWrite(ENC28J60* enc, unsigned char* packet, unsigned int len);
+
+/*Called with TRUE(0) or FALSE(1) once a queued packet has gone out.*/
+typedef void (*TXCALLBACK)(unsigned char status);
+
+/*Driver statistics,see MACGetStats.
+The RX ones come from the RX status vector of each packet,the TX ones
+from the TX status vector the chip writes after sending each packet.*/
+typedef struct {
+    unsigned long RxFrames;//Packets received okay.
+    unsigned long RxBytes;//Bytes in them,without the CRC.
+    unsigned int RxCrcErrors;//Packets with a bad CRC.initMAC sets ERXFCON_CRCEN,which has the chip drop them,so this stays 0 unless that is cleared.
+    unsigned int RxLengthErrors;//Packets whose length field did not match their length.
+    unsigned int RxBroadcast;//Broadcast packets received okay.
+    unsigned int RxMulticast;//Multicast packets received okay.
+    unsigned int RxTruncated;//Packets cut short by MACRead,or by a MACPeek caller(see MACTruncated),to fit its buffer.
+    unsigned int RxOverflows;//Times packets were dropped for want of room in the RX buffer.
+    unsigned int RxResets;//Times the RX buffer was found corrupted,and started again.
+    unsigned long TxFrames;//Packets sent okay.
+    unsigned long TxBytes;//Bytes in them,as counted by the chip.
+    unsigned int TxBroadcast;//Broadcast packets sent okay.
+    unsigned int TxMulticast;//Multicast packets sent okay.
+    unsigned int TxCollisions;//Collisions,over all packets sent.
+    unsigned int TxLateCollisions;//Late collisions,once for each time a packet is sent.
+    unsigned int TxDeferrals;//Packets that had to wait for the medium.
+    unsigned int TxAborts;//Packets given up on.
+} MACSTATS;
+
+/*SPI profile,see MACGetSpiProfile.*/
+typedef struct {
+    unsigned long Count;//Transactions.
+    unsigned long Bytes;//Bytes clocked,opcodes included.
+    unsigned long Ticks;//ProfTimer ticks spent with CS low.
+} SPIPROFENTRY;
+
+/*Index into SPIPROFILE.ByOp,the top 3 bits of the opcode.*/
+#define SPIPROF_RCR     0//Read Control Register.
+#define SPIPROF_RBM     1//Read Buffer Memory.
+#define SPIPROF_WCR     2//Write Control Register.
+#define SPIPROF_WBM     3//Write Buffer Memory.
+#define SPIPROF_BFS     4//Bit Field Set.
+#define SPIPROF_BFC     5//Bit Field Clear.
+#define SPIPROF_SRC     7//System Reset Command.
+#define SPIPROF_OPS     8
+
+/*Index into SPIPROFILE.BySite,the driver function the bus was used for.
+When they call on each other,it all goes to the one called first.*/
+#define SPIPROF_OTHER   0//Anything else.
+#define SPIPROF_INIT    1//initMAC.
+#define SPIPROF_READ    2//MACRead,MACPeek,MACReadAt,MACDiscard,SetRxMode.
+#define SPIPROF_QUEUE   3//MACQueue,MACQueueCsum,MACQueueFromRx.
+#define SPIPROF_WRITE   4//MACWrite,MACWriteCsum.
+#define SPIPROF_SERVICE 5//MACService.
+#define SPIPROF_LINK    6//IsLinkUp.
+#define SPIPROF_FILTER  7//MACJoinGroup,MACLeaveGroup,MACSetPattern,MACClearPattern.
+#define SPIPROF_PHY     8//PHYReadStart,PHYReadPoll,PHYScanStart,PHYScanRead,PHYScanStop.
+#define SPIPROF_SITES   9
+
+typedef struct {
+    SPIPROFENTRY ByOp[SPIPROF_OPS];
+    SPIPROFENTRY BySite[SPIPROF_SITES];
+} SPIPROFILE;
+
+/*A checksum for the ENC28J60's DMA engine to work out and fill in,
+see MACQueueCsum.Offsets are from the start of the packet.
+The 16 bit word at field is summed along with the rest,so it can hold a
+seed,like the sum of the TCP/UDP pseudoheader fields that are not in the range.*/
+typedef struct {
+    unsigned int start;//First byte to checksum.
+    unsigned int end;//Last byte to checksum.
+    unsigned int field;//Where the result goes.
+} CSUMSPEC;
+
+/*******************************************************************************
+* Function Name: MACQueue
+********************************************************************************
+* Summary:
+*   This function writes a packet to ENC28J60's buffer,and queues it for
+*   transmission without waiting for it to go out.Up to TXQUEUELEN packets
+*   can wait in the TX buffer,and the next one is written in while the
+*   current one is on the wire.
+*   Call MACService regularly to move the queue along.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   packet - The buffer that contains the packet to be written.
+*            It can be reused as soon as this returns.
+*   len - The length of the packet present in the buffer 'packet'
+*   done - Function to call once the packet has gone out,or 0.
+*
+* Returns:
+*   TRUE(0)- if the Packet was queued.
+*   FALSE(1) - if the link is down,or there is no room in the queue.
+*
+*******************************************************************************/
+unsigned char MACQueue(ENC28J60* enc, unsigned char* packet, unsigned int len, TXCALLBACK done);
+
+/*******************************************************************************
+* Function Name: MACQueueCsum
+********************************************************************************
+* Summary:
+*   Same as MACQueue,but once the packet is in the TX buffer,the
+*   ENC28J60's DMA engine works out the checksums in csum,in the order given,
+*   and each is written over its field in the buffer before the packet goes out.
+*   This saves the 8051 from summing up the whole packet itself.
+*   Reception is left running,and the Silicon Errata warns that packets
+*   coming in while the checksum is worked out can be lost.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   packet - a pointer to the packet,with its checksum fields seeded.
+*   len - length of the packet.
+*   csum - the checksums to fill in.
+*   count - how many there are in csum.
+*   done - called from MACService once it has gone out,or 0.
+*
+* Returns:
+*   TRUE(0)- if the packet was queued.
+*   FALSE(1) - if the link is down,or there is no room in the queue.
+*
+*******************************************************************************/
+unsigned char MACQueueCsum(ENC28J60* enc, unsigned char* packet, unsigned int len, const CSUMSPEC* csum, unsigned char count, TXCALLBACK done);
+
+/*******************************************************************************
+* Function Name: MACWriteCsum
+********************************************************************************
+* Summary:
+*   Same as MACWrite,with the checksums in csum filled in by the ENC28J60,
+*   see MACQueueCsum.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   packet - a pointer to the packet,with its checksum fields seeded.
+*   len - length of the packet.
+*   csum - the checksums to fill in.
+*   count - how many there are in csum.
+*
+* Returns:
+*   TRUE(0)- if the Packet was successfully transmitted.
+*   FALSE(1) - if the Packet was not successfully transmitted.
+*
+*******************************************************************************/
+unsigned char MACWriteCsum(ENC28J60* enc, unsigned char* packet, unsigned int len, const CSUMSPEC* csum, unsigned char count);
+
+/*******************************************************************************
+* Function Name: MACQueueFromRx
+********************************************************************************
+* Summary:
+*   Queues the packet opened by MACPeek to be sent back out,without it
+*   going over SPI.The DMA engine of the ENC28J60 copies it from the RX
+*   buffer to the TX buffer,and only its first hdrLen bytes are replaced
+*   with header.Checksums are filled in as for MACQueueCsum.
+*   The packet is still open afterwards,free it with MACDiscard.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   header - a pointer to the new headers.
+*   hdrLen - length of the headers.
+*   csum - the checksums to fill in,or 0.
+*   count - how many there are in csum.
+*   done - called from MACService once it has gone out,or 0.
+*
+* Returns:
+*   TRUE(0)- if the packet was queued.
+*   FALSE(1) - if there is no open packet,the link is down,
+*              or there is no room in the queue.
+*
+*******************************************************************************/
+unsigned char MACQueueFromRx(ENC28J60* enc, unsigned char* header, unsigned int hdrLen, const CSUMSPEC* csum, unsigned char count, TXCALLBACK done);
+
+/*******************************************************************************
+* Function Name: MACService
+********************************************************************************
+* Summary:
+*   Checks if the packet on the wire has gone out,and if so reads its status,
+*   starts the next queued packet and calls the completion callback.
+*   A packet aborted by a late collision is sent again,up to
+*   TXLATECOLRETRIES times,before it is given up on.
+*   Also finishes off a read started by PHYReadStart,if it is done.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACService(ENC28J60* enc);
 
 /*******************************************************************************
 * Function Name: MACRead
@@ -62,6 +284,7 @@ unsigned char MACWrite(unsigned char* packet, unsigned int len);
 *   This function read a packet from ENC28J60's buffer,if there is one.
 *
 * Parameters:
+*   enc - the chip,as set up by initMAC.
 *   packet - a pointer to a buffer of data that will hold the packet read.
 *	maxLen - Maximum length of the packet that will be read.
 *
@@ -69,7 +292,80 @@ unsigned char MACWrite(unsigned char* packet, unsigned int len);
 *   the length of the packet read into the buffer pointed to by packet.
 *
 *******************************************************************************/
-unsigned int MACRead(unsigned char* packet, unsigned int maxLen);
+unsigned int MACRead(ENC28J60* enc, unsigned char* packet, unsigned int maxLen);
+
+/*******************************************************************************
+* Function Name: MACPeek
+********************************************************************************
+* Summary:
+*   This function reads only the first hdrLen bytes of the next packet in
+*   the ENC28J60's buffer,and leaves the packet there,open.
+*   Follow it up with MACReadAt to read other parts of the packet,then
+*   MACDiscard to free it.MACRead also reads in an open packet.
+*   Packets that were not received okay are freed straight away.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   header - a pointer to a buffer that will hold the bytes read.
+*   hdrLen - Number of bytes to read from the start of the packet.
+*
+* Returns:
+*   the length of the whole packet,or 0 if there is none.
+*
+*******************************************************************************/
+unsigned int MACPeek(ENC28J60* enc, unsigned char* header, unsigned int hdrLen);
+
+/*******************************************************************************
+* Function Name: MACReadAt
+********************************************************************************
+* Summary:
+*   This function reads part of the packet opened by MACPeek,straight
+*   from where it is in the ENC28J60's buffer.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   offset - Where in the packet to start reading.
+*   buffer - a pointer to a buffer that will hold the bytes read.
+*   len - Number of bytes to read.
+*
+* Returns:
+*   the number of bytes read,which is less than len at the end of the packet.
+*
+*******************************************************************************/
+unsigned int MACReadAt(ENC28J60* enc, unsigned int offset, unsigned char* buffer, unsigned int len);
+
+/*******************************************************************************
+* Function Name: MACDiscard
+********************************************************************************
+* Summary:
+*   This function frees the packet opened by MACPeek,whether or not all of
+*   it was read.The rest of it never goes over SPI.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACDiscard(ENC28J60* enc);
+
+/*******************************************************************************
+* Function Name: MACTruncated
+********************************************************************************
+* Summary:
+*   Counts the packet opened by MACPeek in RxTruncated,for a caller that
+*   has no room for all of it.MACRead does the same by itself.
+*   Call it before MACDiscard.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACTruncated(ENC28J60* enc);
 
 /*******************************************************************************
 * Function Name: ReadChipRev
@@ -78,7 +374,7 @@ unsigned int MACRead(unsigned char* packet, unsigned int maxLen);
 *   This function reads the silicon Revision of the chip.
 *
 * Parameters:
-*   none.
+*   enc - the chip,as set up by initMAC.
 *
 * Returns:
 *   The silicon revision of the chip.Could be either of 
@@ -90,7 +386,7 @@ unsigned int MACRead(unsigned char* packet, unsigned int maxLen);
 *   See http://ww1.microchip.com/downloads/en/DeviceDoc/80349c.pdf
 *
 *******************************************************************************/
-unsigned char ReadChipRev(void);
+unsigned char ReadChipRev(ENC28J60* enc);
 
 /*******************************************************************************
 * Function Name: IsLinkUp
@@ -98,27 +394,353 @@ unsigned char ReadChipRev(void);
 * Summary:
 *   Returns the status of the PHY link,from PHSTAT2 register.
 *   Do not call this before initMAC,since SPIM is started in InitMAC function.
+*   The state is cached,and only re-read from the PHY after it flags a link change.
 *
 * Parameters:
-*   none.
+*   enc - the chip,as set up by initMAC.
 *
 * Returns:
 *   0x01 - If link is up.
 *   0x00 - If link is not up.
 *
 *******************************************************************************/
-unsigned char IsLinkUp(void);
+unsigned char IsLinkUp(ENC28J60* enc);
+
+/*******************************************************************************
+* Function Name: SetRxMode
+********************************************************************************
+* Summary:
+*   Selects how MACRead finds out about received packets.
+*   RXMODE_INTERRUPT and RXMODE_HYBRID need ENC_INT_ENABLED,and the chip
+*   wired to the INT pin,else the driver stays in RXMODE_POLL.That chip
+*   starts up in RXMODE_HYBRID.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   mode - RXMODE_POLL,RXMODE_INTERRUPT or RXMODE_HYBRID.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void SetRxMode(ENC28J60* enc, unsigned char mode);
+
+/*******************************************************************************
+* Function Name: MACJoinGroup
+********************************************************************************
+* Summary:
+*   Has the ENC28J60 accept packets sent to a multicast MAC address,by
+*   setting its bit in the hash table filter(EHT0-EHT7).Other multicast
+*   groups that share the bit get through too,and are left to the stack.
+*   See 8.3.4 Hash Table Filter on Page 52 of the datasheet.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   groupMAC - the multicast MAC address,eg. 01:00:5e:xx:xx:xx for IPv4.
+*
+* Returns:
+*   TRUE(0)- if the group was joined,or had been already.
+*   FALSE(1) - if MCASTMAX groups have been joined already.
+*
+*******************************************************************************/
+unsigned char MACJoinGroup(ENC28J60* enc, const unsigned char* groupMAC);
+
+/*******************************************************************************
+* Function Name: MACLeaveGroup
+********************************************************************************
+* Summary:
+*   Stops accepting packets sent to a multicast MAC address joined with
+*   MACJoinGroup.Its hash table bit is only cleared if no other group
+*   joined needs it.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   groupMAC - the multicast MAC address.
+*
+* Returns:
+*   TRUE(0)- if the group was left.
+*   FALSE(1) - if it had not been joined.
+*
+*******************************************************************************/
+unsigned char MACLeaveGroup(ENC28J60* enc, const unsigned char* groupMAC);
+
+/*******************************************************************************
+* Function Name: MACGetStats
+********************************************************************************
+* Summary:
+*   Takes a copy of the driver statistics,all at one point in time.
+*   Take two,and the difference shows what happened in between.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   stats - where to put them.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACGetStats(ENC28J60* enc, MACSTATS* stats);
+
+/*******************************************************************************
+* Function Name: MACResetStats
+********************************************************************************
+* Summary:
+*   Sets all the driver statistics back to zero.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACResetStats(ENC28J60* enc);
 
+/*******************************************************************************
+* Function Name: MACGetSpiProfile
+********************************************************************************
+* Summary:
+*   Takes a copy of the SPI profile:how many transactions,bytes,and
+*   ProfTimer ticks went to each kind of opcode,and to each driver function.
+*   Reset it,run a workload,then take a copy to see where the bus time goes.
+*   It covers the whole SPI bus,so every chip on it is counted together.
+*   All zeros unless SPI_PROF_ENABLED is set.
+*
+* Parameters:
+*   profile - where to put it.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACGetSpiProfile(SPIPROFILE* profile);
+
+/*******************************************************************************
+* Function Name: MACResetSpiProfile
+********************************************************************************
+* Summary:
+*   Sets the SPI profile back to zero.
+*
+* Parameters:
+*   none.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACResetSpiProfile(void);
+
+/*******************************************************************************
+* Function Name: MACSetPattern
+********************************************************************************
+* Summary:
+*   Programs the pattern match filter,so the ENC28J60 also accepts packets
+*   with given values at given places,on top of the unicast ones.The mask
+*   register(EPMM0-EPMM7) and the checksum(EPMCS) are worked out from them.
+*   There is only one pattern,so this replaces the one set by initMAC,which
+*   lets through broadcast ARP packets.
+*   See 8.2.3 Pattern Match Filter on Page 51 of the datasheet.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   offset - where the 64 byte window starts,counted from the first byte
+*            of the destination address.
+*   mask - bit n(bit n%8 of mask[n/8]) is set if byte n of the window
+*          has to match.(len+7)/8 bytes long.Bits from len up are
+*          ignored.
+*   values - what the window has to hold,len bytes long.Bytes not in the
+*            mask are ignored.
+*   len - how many bytes of the window are given,1 to 64.
+*
+* Returns:
+*   TRUE(0)- if the filter was set.
+*   FALSE(1) - if len is out of range.
+*
+*******************************************************************************/
+unsigned char MACSetPattern(ENC28J60* enc, unsigned int offset, const unsigned char* mask, const unsigned char* values, unsigned char len);
+
+/*******************************************************************************
+* Function Name: MACClearPattern
+********************************************************************************
+* Summary:
+*   Turns off the pattern match filter.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void MACClearPattern(ENC28J60* enc);
+
+/*Called with the PHY register address,and what was read from it,once a
+read started by PHYReadStart is done.*/
+typedef void (*PHYCALLBACK)(unsigned char address, unsigned int value);
+
+/*******************************************************************************
+* Function Name: PHYReadStart
+********************************************************************************
+* Summary:
+*   Starts reading a PHY register,without waiting the 10.24us it takes.
+*   Pick up the result with PHYReadPoll,or have MACService call done
+*   with it.Only one read can be going at a time,and none while scanning.
+*   See Section 3.3.1 on Page 21 of the datasheet.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   address - the PHY register,eg. PHSTAT2.
+*   done - called once the read is done,or 0.
+*
+* Returns:
+*   TRUE(0)- if the read was started.
+*   FALSE(1) - if the MII interface is busy,or the address is out of range.
+*
+*******************************************************************************/
+unsigned char PHYReadStart(ENC28J60* enc, unsigned char address, PHYCALLBACK done);
+
+/*******************************************************************************
+* Function Name: PHYReadPoll
+********************************************************************************
+* Summary:
+*   Checks if the read started by PHYReadStart is done,and if so hands
+*   over the result,calls its callback,and frees the MII interface.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   value - where to put what was read,or 0.
+*
+* Returns:
+*   TRUE(0)- if the read is done.
+*   FALSE(1) - if it is still going,or none was started.
+*
+*******************************************************************************/
+unsigned char PHYReadPoll(ENC28J60* enc, unsigned int* value);
+
+/*******************************************************************************
+* Function Name: PHYScanStart
+********************************************************************************
+* Summary:
+*   Has the MII interface read a PHY register over and over by itself,
+*   keeping MIRD up to date with it,so PHYScanRead can get it with two
+*   register reads instead of a whole PHY read.Scanning PHSTAT2 gives the
+*   live link,duplex,collision and TX/RX status.
+*   Scanning stops for a moment whenever the driver reads or writes
+*   another PHY register itself,eg. on a link change.
+*   See Section 3.3.3 on Page 21 of the datasheet.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   address - the PHY register to scan.
+*
+* Returns:
+*   TRUE(0)- if scanning was started.
+*   FALSE(1) - if a PHYReadStart read is going,or the address is out of range.
+*
+*******************************************************************************/
+unsigned char PHYScanStart(ENC28J60* enc, unsigned char address);
+
+/*******************************************************************************
+* Function Name: PHYScanRead
+********************************************************************************
+* Summary:
+*   Reads the latest value of the PHY register being scanned.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   value - where to put it.
+*
+* Returns:
+*   TRUE(0)- if value was read.
+*   FALSE(1) - if nothing is being scanned,or the first scan is not done yet.
+*
+*******************************************************************************/
+unsigned char PHYScanRead(ENC28J60* enc, unsigned int* value);
+
+/*******************************************************************************
+* Function Name: PHYScanStop
+********************************************************************************
+* Summary:
+*   Stops scanning,started with PHYScanStart.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*
+* Returns:
+*   nothing.
+*
+*******************************************************************************/
+void PHYScanStop(ENC28J60* enc);
+
+/*Results of MACLoopbackBench.Times are in ProfTimer ticks.*/
+typedef struct {
+    unsigned int Frames;//Frames that came back okay.
+    unsigned int Errors;//Frames that did not come back,or came back wrong.
+    unsigned long Bytes;//Bytes in the frames that came back okay.
+    unsigned long WriteTicks;//Writing frames over SPI,in MACQueue.
+    unsigned long TxWaitTicks;//Waiting for them to go out,in MACService.
+    unsigned long RxWaitTicks;//Waiting for them to come back,in MACRead.
+    unsigned long ReadTicks;//Reading them over SPI,in MACRead.
+    unsigned long FramesPerSec;//Frames okay,over the time of all four stages.
+    unsigned long BytesPerSec;//Bytes okay,the same way.
+} LOOPBENCH;
+
+/*******************************************************************************
+* Function Name: MACLoopbackBench
+********************************************************************************
+* Summary:
+*   Measures how fast the driver can move frames,with no network peer.
+*   The PHY is put in loopback(PHCON1.PLOOPBK),with the MAC and PHY in
+*   full duplex as loopback needs,and count frames are sent to our own
+*   MAC address and read back one at a time,through MACQueue,MACService
+*   and MACRead.Each comes back checked against what was sent.
+*   Everything is put back as it was afterwards.Frames waiting in the RX
+*   buffer beforehand are thrown away.The frames count in MACGetStats,and
+*   in the SPI profile,so that can be used to break the time down further.
+*   Needs ENC_BENCH_ENABLED.
+*
+* Parameters:
+*   enc - the chip,as set up by initMAC.
+*   frame - scratch buffer of len bytes.
+*   len - length of each frame,60 to MAXFRAMELEN-4.
+*   count - how many frames to send.
+*   result - where to put the results.
+*
+* Returns:
+*   TRUE(0)- if the benchmark was run.
+*   FALSE(1) - if it is not built in,len is out of range,or packets are
+*              queued for TX or open for RX.
+*
+*******************************************************************************/
+unsigned char MACLoopbackBench(ENC28J60* enc, unsigned char* frame, unsigned int len, unsigned int count, LOOPBENCH* result);
 
 
 /*Structure defined to hold
 bits from of the TX Status Vectors
 See ENC28J60 datasheet Page 43,Table 7-1
+Bit fields are given least significant bit first,as Keil C51 lays them out.
+A compiler that lays them out the other way gets BITFIELDS_MSB_FIRST defined
+in its <device.h>,see "Host/device.h".
 */
 typedef union {
 	unsigned char v[7];
 	struct {
 		unsigned int	ByteCount;
+#if defined(BITFIELDS_MSB_FIRST)
+		unsigned char	Done:1;
+		unsigned char	LengthOutOfRange:1;
+		unsigned char	LengthCheckError:1;
+		unsigned char	CRCError:1;
+		unsigned char	CollisionCount:4;
+		unsigned char	Underrun:1;
+		unsigned char	Giant:1;
+		unsigned char	LateCollision:1;
+		unsigned char	MaximumCollisions:1;
+		unsigned char	ExcessiveDefer:1;
+		unsigned char	PacketDefer:1;
+		unsigned char	Broadcast:1;
+		unsigned char	Multicast:1;
+#else
 		unsigned char	CollisionCount:4;
 		unsigned char	CRCError:1;
 		unsigned char	LengthCheckError:1;
@@ -132,12 +754,21 @@ typedef union {
 		unsigned char	LateCollision:1;
 		unsigned char	Giant:1;
 		unsigned char	Underrun:1;
+#endif
 		unsigned int	BytesTransmittedOnWire;
+#if defined(BITFIELDS_MSB_FIRST)
+		unsigned char	Zeros:4;
+		unsigned char	VLANTaggedFrame:1;
+		unsigned char	BackpressureApplied:1;
+		unsigned char	PAUSEControlFrame:1;
+		unsigned char	ControlFrame:1;
+#else
 		unsigned char	ControlFrame:1;
 		unsigned char	PAUSEControlFrame:1;
 		unsigned char	BackpressureApplied:1;
 		unsigned char	VLANTaggedFrame:1;
 		unsigned char	Zeros:4;
+#endif
 	} bits;
 } TXSTATUS;
 
@@ -150,6 +781,24 @@ typedef union {
 	struct {
 		unsigned int    NextPacket;
         unsigned int	ByteCount;
+#if defined(BITFIELDS_MSB_FIRST)
+		unsigned char	RxOk:1;
+		unsigned char	LenOutofRange:1;
+		unsigned char	LenChkError:1;
+		unsigned char	CRCError:1;
+		unsigned char	Reserved2:1;
+		unsigned char	CarrierEvent:1;
+		unsigned char	Reserved:1;
+		unsigned char	LongEvent:1;
+		unsigned char	Zeros:1;
+        unsigned char   RxVlan:1;
+		unsigned char	RxUkwnOpcode:1;
+		unsigned char	RxPauseFrame:1;
+		unsigned char	RxCntrlFrame:1;
+		unsigned char	DribbleNibble:1;
+		unsigned char	RxBroadCast:1;
+		unsigned char	RxMultiCast:1;
+#else
 		unsigned char	LongEvent:1;
 		unsigned char	Reserved:1;
 		unsigned char	CarrierEvent:1;
@@ -166,12 +815,14 @@ typedef union {
 		unsigned char	RxUkwnOpcode:1;
         unsigned char   RxVlan:1;
 		unsigned char	Zeros:1;
+#endif
 	} bits;
 } RXSTATUS;
 
 /*Memory Organization of the
 ENC28J60's 8kb circular buffer
 See ENC28J60 datasheet Page 20,Figure 3-2
+These are the defaults,used by MemLayoutBalanced.
 */
 #define RXSTART        0x0000
 #define RXEND          0x0fff
@@ -183,6 +834,140 @@ See ENC28J60 datasheet Page 20,Figure 3-2
 /*Maximum length of a packet it can RX.*/
 #define MAXFRAMELEN     1518
 
+/*Number of packets that can wait in the TX buffer,see MACQueue.*/
+#define TXQUEUELEN      4
+
+/*Set ENC_FULL_DUPLEX to 1 to run the MAC and PHY in full duplex.
+The other end has to be set to full duplex too,as the ENC28J60 does not
+autonegotiate.While the RX buffer is over half full,PAUSE frames are sent
+to hold off the other end,until it is down to a quarter.*/
+#define ENC_FULL_DUPLEX 0
+
+/*Set SPI_PROF_ENABLED to 1 to count and time every SPI transaction,
+see MACGetSpiProfile.This needs a 16 bit Timer component called "ProfTimer"
+on the TopDesign,free running with a period of 0xFFFF.Times are reported in
+its ticks,so clock it at a rate that suits,eg. BUS_CLK.*/
+#define SPI_PROF_ENABLED 0
+
+/*Set ENC_BENCH_ENABLED to 1 to build in MACLoopbackBench.It times with
+the same "ProfTimer" as SPI_PROF_ENABLED.Stages are timed in 16 bits,so
+clock ProfTimer slow enough that a full sized frame takes well under
+65536 ticks to go over SPI,eg. 1MHz,and set PROFTIMER_HZ to match.*/
+#define ENC_BENCH_ENABLED 0
+#define PROFTIMER_HZ    1000000UL
+
+/*Bound on the wait for each frame to come back,in MACRead polls.*/
+#define BENCHRXTRIES    1000
+
+/*Bound on the waits when the receive side is reset,in register reads.*/
+#define RXRECOVERTRIES  1000
+
+/*Times a packet is sent again after a late collision,see MACService.*/
+#define TXLATECOLRETRIES 2
+
+/*Number of multicast groups that can be joined,see MACJoinGroup.*/
+#define MCASTMAX        4
+
+/*Set ENC_INT_ENABLED to 1 if the INT pin of the ENC28J60 is wired to
+the "PACKET" pin,set to interrupt on a falling edge,with an isr component
+called "PACKET_ISR" on its irq output.
+With more than one chip,the pin belongs to the first one passed to
+initMAC,and the others are polled.*/
+#define ENC_INT_ENABLED 0
+
+/*Receive modes,see SetRxMode.
+RXMODE_POLL      - EPKTCNT is read over SPI on every MACRead.
+RXMODE_INTERRUPT - MACRead does not touch the bus until PKTIF has
+                   pulled the INT pin low.
+RXMODE_HYBRID    - As RXMODE_INTERRUPT while traffic is light.When a
+                   backlog builds up,PKTIE is masked and MACRead polls
+                   until the RX buffer is empty,then goes back to
+                   interrupts.(Like NAPI in Linux.)
+*/
+#define RXMODE_POLL         0
+#define RXMODE_INTERRUPT    1
+#define RXMODE_HYBRID       2
+
+/*Packet waiting in the TX buffer of a chip,see MACQueue.Each takes up
+the control byte,the packet,and the 7 byte status vector the chip writes
+after it,all in one contiguous slot.*/
+typedef struct {
+    unsigned int start;//Address of the control byte.
+    unsigned int len;//Length of the packet,without the control byte.
+    TXCALLBACK done;//Called once it has gone out,or 0.
+    unsigned char retries;//Late collision resends left.
+} TXDESC;
+
+/*A multicast group joined,see MACJoinGroup.The hash table bit is kept,so
+that a bit is only cleared once no other group needs it.*/
+typedef struct {
+    unsigned char mac[6];
+    unsigned char hash;
+} MCASTGROUP;
+
+/*Everything the driver keeps about one ENC28J60.
+Set up by initMAC,and passed to every other driver function.
+Its members belong to the driver,use the functions to get at them.*/
+struct ENC28J60 {
+    ENCSELECT Select;//Chip select line.
+    
+    /*Shadow of the ECON1 register,as last written by the driver.
+    The bank currently selected is kept in its BSEL<1:0> bits,so BankSel
+    does not have to read ECON1 back over SPI to know where it is.
+    TXRTS and DMAST are cleared by the chip itself,so those bits
+    in the shadow are not to be trusted.*/
+    unsigned char ECON1Shadow;
+    
+    MEMLAYOUT Layout;//SRAM layout in use,as passed to initMAC.
+    
+    /*Receive side.*/
+    unsigned int RxNextPtr;//Where the next packet in the RX buffer starts.
+    RXSTATUS RxStatus;//Status vector of the last packet opened.
+    unsigned char RxPckOpen;//Set while a packet opened by MACPeek or MACRead is not freed yet.
+    unsigned int RxPckPtr;//Address of its first byte.
+    unsigned int RxPckLen;//Its length,without the CRC.
+    
+    /*Shadow of ERDPT.It moves along as the buffer is read,so a read that
+    carries on from where the last one ended does not have to set it.*/
+    unsigned int RdPtr;
+    
+    /*Transmit side.The packet at TxHead is the one on the wire.*/
+    TXDESC TxQueue[TXQUEUELEN];
+    unsigned char TxHead;
+    unsigned char TxCount;
+    unsigned int TxTail;//Next free address in the TX buffer.
+    unsigned char TxLastStatus;//Status of the last packet finished.
+    TXSTATUS TxStatus;//Status vector of the last packet sent.
+    
+    /*Cached state of the PHY link,refreshed from PHSTAT2 only when the
+    PHY reports a link change through EIR.LINKIF.*/
+    unsigned char LinkUp;
+    unsigned char LinkCheckCount;//Calls to IsLinkUp since EIR.LINKIF was checked.
+    
+    /*PHY access,see PHYReadStart and PHYScanStart.*/
+    unsigned char PhyRead;//PHY register being read.
+    unsigned char PhyReadDone;//Set once its result is in PhyValue.
+    unsigned int PhyValue;
+    PHYCALLBACK PhyDone;
+    unsigned char PhyScan;//PHY register being scanned.
+    unsigned char PhyScanValid;//Set once MIRD holds a scanned value.
+    
+#if (ENC_INT_ENABLED)
+    unsigned char IntPin;//Set if this is the chip wired to the "PACKET" pin.
+    unsigned char RxMode;//Receive mode,as set by SetRxMode.
+    volatile unsigned char RxPending;//Set by the INT pin,cleared by MACRead.
+    unsigned char RxPolling;//Set while RXMODE_HYBRID is in a polling burst.
+#endif
+#if (ENC_FULL_DUPLEX)
+    unsigned char FlowPaused;//Set while PAUSE frames are being sent.
+#endif
+    
+    MCASTGROUP McastGroups[MCASTMAX];//Multicast groups joined.
+    unsigned char McastCount;
+    
+    MACSTATS Stats;//Driver statistics,see MACGetStats.
+};
+
 /*SPI Opcodes for the ENC28J60
 See ENC28J60 datasheet Page 28,Table 4-1
 */
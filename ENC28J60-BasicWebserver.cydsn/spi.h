@@ -8,6 +8,10 @@
  6-05-11 : Added the Wait for Existing Data to go out in spiTxByte.
  18-6-12 : Added Buffer Read-Write functions and changed function
            names to make them more meaningful.            
+ 17-10-26: Added the DMA path for long buffer transfers.
+ 17-10-26: Added the FIFO pipelined path,used when DMA is off or unavailable.
+ 17-10-26: Slave Select left to the caller,and spiInit made safe to call again,
+           for more than one device on the bus.
 */
 #ifndef SPI_H
 #define SPI_H
@@ -15,8 +19,33 @@
 
 #define DummyByte 0x00 //0x00 or 0xFF.
 
-//Expects the Slave Select Pin to be called "SS".Hence the macro.
-#define SPI_SEL(x)  SS_Write(x)
+/*Slave Select is driven by whoever uses the bus,so that more than one
+  device can share it.The ENC28J60 driver takes it as a function,eg. SS_Write
+  for a pin called "SS",see initMAC.*/
+
+/*Set SPI_FIFO_ENABLED to 1 to keep the SPIM TX FIFO full during buffer
+  transfers,instead of waiting for SPI_DONE after every byte.*/
+#define SPI_FIFO_ENABLED 1
+
+/*Set SPI_DMA_ENABLED to 1 to move long buffers with DMA instead of the CPU.
+  This needs the following on the TopDesign,
+  -A DMA component called "SPI_RxDMA",with its drq tied to the SPIM rx_interrupt.
+  -A DMA component called "SPI_TxDMA",with its drq set to Rising Edge,and tied
+   to an AND of the SPIM tx_interrupt and the inverted SPIM rx_interrupt.
+  -An isr component called "SPI_RxDone",tied to the nrq of SPI_RxDMA.
+  spiInit sets the SPIM interrupt outputs to TX FIFO EMPTY and RX FIFO NOT
+  EMPTY,so each DMA request moves exactly one byte.The AND holds TX back in
+  hardware:a byte is only queued once the last one is in the shifter and
+  the RX channel has taken everything that came in,so no more than 2 bytes
+  are ever in flight,and the RX FIFO cannot overrun.*/
+#define SPI_DMA_ENABLED 0
+
+/*Transfers shorter than this go through the byte loop,since
+  setting up the TDs costs more than clocking out a few bytes.*/
+#define SPI_DMA_THRESHOLD 16
+
+/*Most bytes a TD can move,its transfer count being 12 bits.*/
+#define SPI_DMA_MAXTDLEN 4095
 
 //Function defines.
 
@@ -102,12 +131,199 @@ unsigned int spiTxBuffer(unsigned char * ptrBuffer, unsigned int Len);
 *******************************************************************************/
 unsigned int spiRxBuffer(unsigned char * ptrBuffer, unsigned int Len);
 
+#if (SPI_FIFO_ENABLED)
+/*******************************************************************************
+* Function Name: spiFifoTransfer
+********************************************************************************
+* Summary:
+*   Moves a buffer over SPI,keeping the SPIM TX FIFO topped up and draining
+*   the RX FIFO as bytes come in.It only waits for the bus at the end of the
+*   burst,so there are no idle gaps between bytes.
+*
+* Parameters:
+*   ptrTx - A pointer to the bytes to transmit,or 0 to clock out DummyByte.
+*   ptrRx - A pointer to the buffer for the received bytes,or 0 to discard them.
+*   Len - The number of bytes to transfer.
+*
+* Returns:
+*   The number of bytes actually transferred.
+*   Note: You need to control the CS line externally.
+*         This function assumes CS is active.
+*
+*******************************************************************************/
+unsigned int spiFifoTransfer(unsigned char * ptrTx, unsigned char * ptrRx, unsigned int Len);
+#endif
+
+#if (SPI_DMA_ENABLED)
+/*******************************************************************************
+* Function Name: spiDmaTransfer
+********************************************************************************
+* Summary:
+*   Moves a buffer over SPI using the SPI_TxDMA and SPI_RxDMA channels.
+*   One TD on each channel moves the whole buffer(up to SPI_DMA_MAXTDLEN
+*   bytes),TX being paced by RX in hardware,see SPI_DMA_ENABLED.The CPU
+*   starts it off with one software request on the TX channel,and then only
+*   waits for the SPI_RxDone interrupt at the end.
+*   Not tried on hardware yet,the Linux build has no DMA channels.
+*
+* Parameters:
+*   ptrTx - A pointer to the bytes to transmit,or 0 to clock out DummyByte.
+*   ptrRx - A pointer to the buffer for the received bytes,or 0 to discard them.
+*   Len - The number of bytes to transfer.
+*
+* Returns:
+*   The number of bytes actually transferred.
+*   Note: You need to control the CS line externally.
+*         This function assumes CS is active.
+*
+*******************************************************************************/
+unsigned int spiDmaTransfer(unsigned char * ptrTx, unsigned char * ptrRx, unsigned int Len);
+#endif
+
 //Functions:
 
+#if (SPI_DMA_ENABLED)
+/*DMA channel handles,and the TD that each of them runs.*/
+static uint8 spiTxChan;
+static uint8 spiRxChan;
+static uint8 spiTxTd;
+static uint8 spiRxTd;
+
+/*Source of the dummy bytes clocked out during a read,
+  and the sink for the bytes clocked in during a write.*/
+static uint8 spiDmaDummyTx = DummyByte;
+static uint8 spiDmaDummyRx;
+
+/*Set by the SPI_RxDone ISR when the RX TD has completed.*/
+static volatile uint8 spiDmaDone;
+
+/*Set once spiInit got both channels and all the TDs it asked for.
+  If not,buffer transfers fall back to the CPU paths.*/
+static uint8 spiDmaReady;
+
+CY_ISR(spiDmaDoneIsr){
+    spiDmaDone = 1;
+}
+
+unsigned int spiDmaTransfer(unsigned char * ptrTx, unsigned char * ptrRx, unsigned int Len){
+    unsigned int done;
+    uint16 count;
+
+    /*Leftovers in the RX FIFO would be read in as the first bytes.*/
+    SPIM_ClearRxBuffer();
+
+    for (done=0;done<Len;done+=count){
+        count = Len - done;
+        if (count > SPI_DMA_MAXTDLEN){
+            count = SPI_DMA_MAXTDLEN;
+        }
+
+        /*RX,from the SPIM RX FIFO into memory.*/
+        if (ptrRx){
+            CyDmaTdSetConfiguration(spiRxTd, count, CY_DMA_DISABLE_TD, CY_DMA_TD_INC_DST_ADR | SPI_RxDMA__TD_TERMOUT_EN);
+            CyDmaTdSetAddress(spiRxTd, LO16((uint32)SPIM_RXDATA_PTR), LO16((uint32)(ptrRx + done)));
+        }else{
+            CyDmaTdSetConfiguration(spiRxTd, count, CY_DMA_DISABLE_TD, SPI_RxDMA__TD_TERMOUT_EN);
+            CyDmaTdSetAddress(spiRxTd, LO16((uint32)SPIM_RXDATA_PTR), LO16((uint32)&spiDmaDummyRx));
+        }
+
+        /*TX,from memory into the SPIM TX FIFO.*/
+        if (ptrTx){
+            CyDmaTdSetConfiguration(spiTxTd, count, CY_DMA_DISABLE_TD, CY_DMA_TD_INC_SRC_ADR);
+            CyDmaTdSetAddress(spiTxTd, LO16((uint32)(ptrTx + done)), LO16((uint32)SPIM_TXDATA_PTR));
+        }else{
+            CyDmaTdSetConfiguration(spiTxTd, count, CY_DMA_DISABLE_TD, 0);
+            CyDmaTdSetAddress(spiTxTd, LO16((uint32)&spiDmaDummyTx), LO16((uint32)SPIM_TXDATA_PTR));
+        }
+
+        spiDmaDone = 0;
+
+        /*Arm RX first,so that no incoming byte can be missed.*/
+        CyDmaChSetInitialTd(spiRxChan, spiRxTd);
+        CyDmaChEnable(spiRxChan, 1);
+        CyDmaChSetInitialTd(spiTxChan, spiTxTd);
+        CyDmaChEnable(spiTxChan, 1);
+
+        /*The TX drq is already high with the SPIM idle,so there is no edge
+          for the first byte.Ask for it here,the rest follow by themselves.*/
+        CyDmaChSetRequest(spiTxChan, CY_DMA_CPU_REQ);
+
+        /*The last byte has been clocked in when the RX TD is done.*/
+        while (!spiDmaDone);
+    }
+
+    return Len;
+}
+#endif
+
+/*Set once spiInit has run,so that each device on the bus can call it.*/
+static uint8 spiStarted;
+
 void spiInit(){//Start the SPIM Module
+	if (spiStarted){
+		return;
+	}
+	spiStarted = 1;
 	SPIM_Start();
+#if (SPI_DMA_ENABLED)
+    {
+        /*Route the FIFO status to the drq lines of the DMA channels.*/
+        SPIM_SetTxInterruptMode(SPIM_STS_TX_FIFO_EMPTY);
+        SPIM_SetRxInterruptMode(SPIM_STS_RX_FIFO_NOT_EMPTY);
+
+        /*One byte per request,SRAM and the SPIM registers both
+          sit in the lower 64k on the PSoC3.*/
+        spiTxChan = SPI_TxDMA_DmaInitialize(1, 1, HI16(CYDEV_SRAM_BASE), HI16(CYDEV_PERIPH_BASE));
+        spiRxChan = SPI_RxDMA_DmaInitialize(1, 1, HI16(CYDEV_PERIPH_BASE), HI16(CYDEV_SRAM_BASE));
+        spiDmaReady = (spiTxChan != DMA_INVALID_CHANNEL) && (spiRxChan != DMA_INVALID_CHANNEL);
+        spiTxTd = CyDmaTdAllocate();
+        spiRxTd = CyDmaTdAllocate();
+        if ((spiTxTd == DMA_INVALID_TD) || (spiRxTd == DMA_INVALID_TD)){
+            spiDmaReady = 0;
+        }
+
+        if (spiDmaReady){
+            SPI_RxDone_StartEx(spiDmaDoneIsr);
+        }
+    }
+#endif
 }
 
+#if (SPI_FIFO_ENABLED)
+unsigned int spiFifoTransfer(unsigned char * ptrTx, unsigned char * ptrRx, unsigned int Len){
+    unsigned int txCount = 0;
+    unsigned int rxCount = 0;
+    uint8 rxByte;
+
+    /*Leftovers in the RX FIFO would be read in as the first bytes.*/
+    SPIM_ClearRxBuffer();
+
+    while (rxCount < Len){
+        /*Top up the TX FIFO,but never have more bytes in flight than the
+          RX FIFO can hold,or incoming bytes would be lost to an overrun.*/
+        while ((txCount < Len) && (txCount < (rxCount + SPIM_RXBUFFERSIZE)) &&
+               (SPIM_TX_STATUS_REG & SPIM_STS_TX_FIFO_NOT_FULL)){
+            SPIM_TXDATA_REG = ptrTx ? ptrTx[txCount] : DummyByte;
+            txCount++;
+        }
+
+        /*Drain whatever has come in.*/
+        if (SPIM_RX_STATUS_REG & SPIM_STS_RX_FIFO_NOT_EMPTY){
+            rxByte = SPIM_RXDATA_REG;
+            if (ptrRx){
+                ptrRx[rxCount] = rxByte;
+            }
+            rxCount++;
+        }
+    }
+
+    /*SPI_DONE is sticky and cleared on read,so the one from the last byte
+      has to be taken now,or spiTxByte would see it and not wait for its own.*/
+    while (!(SPIM_ReadTxStatus() & SPIM_STS_SPI_DONE));
+    return Len;
+}
+#endif
+
 
 uint8 spiTxByte(uint8 bDataSend)//Send a Byte.
 {	
@@ -130,6 +346,16 @@ unsigned int spiTxBuffer(unsigned char * ptrBuffer, unsigned int Len)
 
     if (Len == 0) // no data no send
         return 0;
+#if (SPI_DMA_ENABLED)
+    if (spiDmaReady && (Len >= SPI_DMA_THRESHOLD)){
+        return spiDmaTransfer(ptrBuffer, 0, Len);
+    }
+#endif
+#if (SPI_FIFO_ENABLED)
+    if (Len > 1){
+        return spiFifoTransfer(ptrBuffer, 0, Len);
+    }
+#endif
     for (i=0;i<Len;i++){
         spiTxByte(*ptrBuffer++);
     }
@@ -141,6 +367,16 @@ unsigned int spiRxBuffer(unsigned char * ptrBuffer, unsigned int Len)
 {
     unsigned int i;
     
+#if (SPI_DMA_ENABLED)
+    if (spiDmaReady && (Len >= SPI_DMA_THRESHOLD)){
+        return spiDmaTransfer(0, ptrBuffer, Len);
+    }
+#endif
+#if (SPI_FIFO_ENABLED)
+    if (Len > 1){
+        return spiFifoTransfer(0, ptrBuffer, Len);
+    }
+#endif
     for ( i=0;i<Len;i++){
         *ptrBuffer++ = spiRxByte();
     }